@@ -0,0 +1,192 @@
+/*
+ * Compares heightmap access speed in row-major, tiled (tiledHeightmap.h) and
+ * Morton (Z-order) layouts.
+ *
+ * usage: heightmapBench [size] [queries]
+ *
+ * Every layout answers the same random queries: single samples, the four
+ * samples under a bilinear lookup, the 3 x 3 neighbourhood a normal needs and
+ * 16 x 16 brush footprints, plus a sweep of 3 x 3 neighbourhoods over every
+ * sample like the normal pass when meshing. Reported in million samples read
+ * per second, the checksums in brackets show each layout read the same values.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "tiledHeightmap.h"
+
+#define BRUSH_SIZE 16
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static uint32_t xorshift(uint32_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+/* spreads the low 16 bits of v out to the even bits */
+static inline uint32_t spreadBits(uint32_t v)
+{
+	v &= 0xffff;
+	v = (v | (v << 8)) & 0x00ff00ff;
+	v = (v | (v << 4)) & 0x0f0f0f0f;
+	v = (v | (v << 2)) & 0x33333333;
+	v = (v | (v << 1)) & 0x55555555;
+	return v;
+}
+
+static inline uint32_t rowMajorIndex(uint32_t size, uint32_t x, uint32_t z)
+{
+	return x + z * size;
+}
+
+static inline uint32_t mortonIndex(uint32_t size, uint32_t x, uint32_t z)
+{
+	(void) size;
+	return spreadBits(x) | (spreadBits(z) << 1);
+}
+
+/* one set of benchmarks per layout, so every index function is inlined into its own loops */
+#define DEFINE_LAYOUT_BENCH(name, index)                                                              \
+static void name(const char *label, const float *map, uint32_t size, const uint32_t *points,          \
+	uint32_t numQueries)                                                                              \
+{                                                                                                     \
+	double start, seconds;                                                                            \
+	float sum;                                                                                        \
+	printf("%-10s", label);                                                                           \
+                                                                                                      \
+	sum = 0.0f;                                                                                       \
+	start = now();                                                                                    \
+	for (uint32_t i = 0; i < numQueries; i++) {                                                       \
+		sum += map[index(size, points[i * 2], points[i * 2 + 1])];                                    \
+	}                                                                                                 \
+	seconds = now() - start;                                                                          \
+	printf(" %10.1f (%g)", numQueries / seconds * 1e-6, sum);                                         \
+                                                                                                      \
+	sum = 0.0f;                                                                                       \
+	start = now();                                                                                    \
+	for (uint32_t i = 0; i < numQueries; i++) {                                                       \
+		uint32_t x = points[i * 2], z = points[i * 2 + 1];                                            \
+		sum += map[index(size, x, z)] + map[index(size, x + 1, z)] + map[index(size, x, z + 1)] +     \
+			map[index(size, x + 1, z + 1)];                                                           \
+	}                                                                                                 \
+	seconds = now() - start;                                                                          \
+	printf(" %10.1f (%g)", 4.0 * numQueries / seconds * 1e-6, sum);                                   \
+                                                                                                      \
+	sum = 0.0f;                                                                                       \
+	start = now();                                                                                    \
+	for (uint32_t i = 0; i < numQueries; i++) {                                                       \
+		uint32_t x = points[i * 2] + 1, z = points[i * 2 + 1] + 1;                                    \
+		for (uint32_t dz = z - 1; dz <= z + 1; dz++) {                                                \
+			sum += map[index(size, x - 1, dz)] + map[index(size, x, dz)] + map[index(size, x + 1, dz)]; \
+		}                                                                                             \
+	}                                                                                                 \
+	seconds = now() - start;                                                                          \
+	printf(" %10.1f (%g)", 9.0 * numQueries / seconds * 1e-6, sum);                                   \
+                                                                                                      \
+	sum = 0.0f;                                                                                       \
+	start = now();                                                                                    \
+	const uint32_t numBrushes = numQueries / (BRUSH_SIZE * BRUSH_SIZE);                               \
+	for (uint32_t i = 0; i < numBrushes; i++) {                                                       \
+		uint32_t x0 = points[i * 2] % (size - BRUSH_SIZE), z0 = points[i * 2 + 1] % (size - BRUSH_SIZE); \
+		for (uint32_t z = z0; z < z0 + BRUSH_SIZE; z++) {                                             \
+			for (uint32_t x = x0; x < x0 + BRUSH_SIZE; x++) {                                         \
+				sum += map[index(size, x, z)];                                                        \
+			}                                                                                         \
+		}                                                                                             \
+	}                                                                                                 \
+	seconds = now() - start;                                                                          \
+	printf(" %10.1f (%g)", (double) numBrushes * BRUSH_SIZE * BRUSH_SIZE / seconds * 1e-6, sum);      \
+                                                                                                      \
+	sum = 0.0f;                                                                                       \
+	start = now();                                                                                    \
+	for (uint32_t z = 1; z < size - 1; z++) {                                                         \
+		for (uint32_t x = 1; x < size - 1; x++) {                                                     \
+			sum += map[index(size, x, z - 1)] + map[index(size, x - 1, z)] + map[index(size, x, z)] + \
+				map[index(size, x + 1, z)] + map[index(size, x, z + 1)];                              \
+		}                                                                                             \
+	}                                                                                                 \
+	seconds = now() - start;                                                                          \
+	printf(" %10.1f (%g)\n", 5.0 * (size - 2) * (size - 2) / seconds * 1e-6, sum);                    \
+}
+
+DEFINE_LAYOUT_BENCH(benchRowMajor, rowMajorIndex)
+DEFINE_LAYOUT_BENCH(benchTiled, getTiledHeightmapIndex)
+DEFINE_LAYOUT_BENCH(benchMorton, mortonIndex)
+
+/* the same value at (x, z) whatever the layout, small integers so the checksums stay readable */
+static float sampleValue(uint32_t x, uint32_t z)
+{
+	uint32_t h = x * 0x9e3779b1u ^ z * 0x85ebca77u;
+	h ^= h >> 15;
+	h *= 0x2c1b3c6du;
+	return (float) (h >> 29);
+}
+
+/* one layout at a time, so maps several times the size of the last level cache fit in memory */
+static float *buildMap(size_t length, uint32_t size, uint32_t (*index)(uint32_t, uint32_t, uint32_t))
+{
+	float *map = calloc(length, sizeof(float));
+	if (!map) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	for (uint32_t z = 0; z < size; z++) {
+		for (uint32_t x = 0; x < size; x++) {
+			map[index(size, x, z)] = sampleValue(x, z);
+		}
+	}
+	return map;
+}
+
+int main(int argc, char **argv)
+{
+	const uint32_t size = argc > 1 ? (uint32_t) strtoul(argv[1], NULL, 10) : 16384;
+	const uint32_t numQueries = argc > 2 ? (uint32_t) strtoul(argv[2], NULL, 10) : 1 << 24;
+	if (size < BRUSH_SIZE * 2 || size > 32768) {
+		fprintf(stderr, "size must be between %d and 32768.\n", BRUSH_SIZE * 2);
+		return EXIT_FAILURE;
+	}
+
+	uint32_t mortonSide = 1;
+	while (mortonSide < size) {
+		mortonSide *= 2;
+	}
+
+	// every query stays a sample clear of the far edges
+	uint32_t *points = malloc((size_t) numQueries * 2 * sizeof(uint32_t));
+	if (!points) {
+		fprintf(stderr, "Out of memory.\n");
+		return EXIT_FAILURE;
+	}
+	uint32_t state = 12345;
+	for (uint32_t i = 0; i < numQueries * 2; i++) {
+		points[i] = xorshift(&state) % (size - 2);
+	}
+
+	// every layout adds up the same values in the same order, so the checksums should match exactly
+	printf("%u x %u map, %u queries, million samples per second\n", size, size, numQueries);
+	printf("%-10s %21s %21s %21s %21s %21s\n", "layout", "random", "bilinear", "3x3", "16x16 brush", "sweep");
+	float *map = buildMap((size_t) size * size, size, rowMajorIndex);
+	benchRowMajor("row-major", map, size, points, numQueries);
+	free(map);
+	map = buildMap(getTiledHeightmapLength(size), size, getTiledHeightmapIndex);
+	benchTiled("tiled", map, size, points, numQueries);
+	free(map);
+	map = buildMap((size_t) mortonSide * mortonSide, size, mortonIndex);
+	benchMorton("morton", map, size, points, numQueries);
+	free(map);
+
+	free(points);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,71 @@
+#include <math.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define CULLING_SSE2 1
+#include <immintrin.h>
+#endif
+
+#include "culling.h"
+
+/*
+ * The planes aren't normalised, so sphere radii are scaled by the length of
+ * the plane normal. The vector and scalar paths do the same operations in the
+ * same order, so a bound is visible or not whichever tested it.
+ */
+
+static uint8_t boundVisible(const float *planes, const float *lengths, const struct CullBounds *b, uint32_t i)
+{
+	for (int p = 0; p < 6; p++) {
+		const float *plane = &planes[p * 4];
+		const float distance = plane[0] * b->x[i] + plane[1] * b->y[i] + plane[2] * b->z[i] + plane[3];
+		const float boxReach = fabsf(plane[0]) * b->extentX[i] + fabsf(plane[1]) * b->extentY[i] +
+			fabsf(plane[2]) * b->extentZ[i];
+		const float sphereReach = b->radius[i] * lengths[p];
+		if (distance + fminf(boxReach, sphereReach) < 0.0f) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+uint32_t cullBounds(const float *planes, const struct CullBounds *b, uint8_t *visible)
+{
+	float lengths[6];
+	for (int p = 0; p < 6; p++) {
+		const float *plane = &planes[p * 4];
+		lengths[p] = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+	}
+
+	uint32_t numVisible = 0;
+	uint32_t i = 0;
+#ifdef CULLING_SSE2
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	for (; i + 4 <= b->count; i += 4) {
+		const __m128 x = _mm_loadu_ps(&b->x[i]), y = _mm_loadu_ps(&b->y[i]), z = _mm_loadu_ps(&b->z[i]);
+		const __m128 extentX = _mm_loadu_ps(&b->extentX[i]), extentY = _mm_loadu_ps(&b->extentY[i]);
+		const __m128 extentZ = _mm_loadu_ps(&b->extentZ[i]), radius = _mm_loadu_ps(&b->radius[i]);
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++) {
+			const float *plane = &planes[p * 4];
+			const __m128 a = _mm_set1_ps(plane[0]), bb = _mm_set1_ps(plane[1]), c = _mm_set1_ps(plane[2]);
+			const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x), _mm_mul_ps(bb, y)),
+				_mm_mul_ps(c, z)), _mm_set1_ps(plane[3]));
+			const __m128 boxReach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, a), extentX),
+				_mm_mul_ps(_mm_andnot_ps(signMask, bb), extentY)), _mm_mul_ps(_mm_andnot_ps(signMask, c), extentZ));
+			const __m128 sphereReach = _mm_mul_ps(radius, _mm_set1_ps(lengths[p]));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, _mm_min_ps(boxReach, sphereReach)),
+				_mm_setzero_ps()));
+		}
+		const int mask = _mm_movemask_ps(outside);
+		for (int k = 0; k < 4; k++) {
+			visible[i + k] = !((mask >> k) & 1);
+			numVisible += visible[i + k];
+		}
+	}
+#endif
+	for (; i < b->count; i++) {
+		visible[i] = boundVisible(planes, lengths, b, i);
+		numVisible += visible[i];
+	}
+	return numVisible;
+}
@@ -0,0 +1,26 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <stdint.h>
+
+/*
+ * World space bounds of many objects as a structure of arrays, so they can be
+ * tested four at a time. Each is a box (centre and half extents) and the
+ * radius of a sphere about the same centre. Against each plane whichever of
+ * the two reaches less far is used, the box for long flat terrain chunks and
+ * the sphere for rotated meshes whose world box has grown around them.
+ */
+struct CullBounds {
+	float *x, *y, *z;
+	float *extentX, *extentY, *extentZ;
+	float *radius;
+	uint32_t count;
+};
+
+/*
+ * Sets visible[i] to 1 if bound i may be inside the 6 planes from
+ * loadFrustumPlanes, 0 if it's certainly outside one. Returns how many may be.
+ */
+uint32_t cullBounds(const float *planes, const struct CullBounds *bounds, uint8_t *visible);
+
+#endif
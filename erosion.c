@@ -0,0 +1,390 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define EROSION_SSE2 1
+#include <immintrin.h>
+#endif
+
+#include "erosion.h"
+#include "heightmap.h"
+#include "parallel.h"
+#include "terrain.h"
+
+/*
+ * Hydraulic erosion runs in rounds, each eroding every tile once in four
+ * passes, one per corner of each 2 x 2 block of tiles. A pass's tiles are far
+ * enough apart that no two of them read or write the same samples, so they are
+ * split across cores and the result doesn't depend on which core got which.
+ * Every tile seeds its own generator from the seed, round and tile, and the
+ * grid is shifted half a tile between rounds so droplets cross the tile edges
+ * of the round before.
+ *
+ * As with noise.c the vector and scalar versions perform the same float
+ * operations in the same order.
+ */
+#define EROSION_ROUNDS 4
+/* how far outside its tile a droplet may go */
+#define EROSION_MARGIN (EROSION_TILE_SIZE / 4)
+
+static const uint32_t roundOffsets[EROSION_ROUNDS][2] = {
+	{0, 0}, {EROSION_TILE_SIZE / 2, EROSION_TILE_SIZE / 2}, {EROSION_TILE_SIZE / 2, 0}, {0, EROSION_TILE_SIZE / 2}
+};
+
+struct ErosionJob {
+	float *heightmap;
+	uint32_t size;
+	const struct ErosionParams *params;
+	unsigned int seed;
+	uint32_t round, tilesPerSide, corner; /* corner of each 2 x 2 block of tiles this pass erodes */
+	const float *brush; /* weights of the area a droplet erodes, rows padded to a multiple of four */
+	uint32_t radius, brushWidth;
+};
+
+struct ThermalJob {
+	const float *source;
+	float *destination;
+	uint32_t size;
+	float talus, rate;
+};
+
+struct ErosionParams getDefaultErosionParams(void)
+{
+	struct ErosionParams params = {
+		.droplets = 0.25f, .dropletLifetime = 30, .radius = 3, .inertia = 0.05f, .capacity = 4.0f,
+		.minSlope = 0.01f, .depositSpeed = 0.3f, .erodeSpeed = 0.3f, .evaporateSpeed = 0.01f, .gravity = 4.0f,
+		.thermalIterations = 8, .talus = 0.6f, .thermalRate = 0.2f
+	};
+	return params;
+}
+
+/* splitmix32, as in noise.c */
+static uint32_t nextRandom(uint32_t *state)
+{
+	uint32_t z = (*state += 0x9e3779b9u);
+	z = (z ^ (z >> 16)) * 0x85ebca6bu;
+	z = (z ^ (z >> 13)) * 0xc2b2ae35u;
+	return z ^ (z >> 16);
+}
+
+/* in [0, 1) */
+static float nextRandomFloat(uint32_t *state)
+{
+	return (float) (nextRandom(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+/* bilinear height at (x, z), which must be inside the last row and column */
+static float getHeightAndGradient(const float *heightmap, uint32_t size, float x, float z, float *gradientX,
+	float *gradientZ)
+{
+	const uint32_t nodeX = (uint32_t) x, nodeZ = (uint32_t) z;
+	const float u = x - (float) nodeX, v = z - (float) nodeZ;
+	const float *node = &heightmap[nodeX + (size_t) nodeZ * size];
+	const float h00 = node[0], h10 = node[1], h01 = node[size], h11 = node[size + 1];
+
+	*gradientX = (h10 - h00) * (1.0f - v) + (h11 - h01) * v;
+	*gradientZ = (h01 - h00) * (1.0f - u) + (h11 - h10) * u;
+	return h00 * (1.0f - u) * (1.0f - v) + h10 * u * (1.0f - v) + h01 * (1.0f - u) * v + h11 * u * v;
+}
+
+/* adds amount spread over the four samples around (nodeX + u, nodeZ + v) */
+static void depositSediment(float *heightmap, uint32_t size, uint32_t nodeX, uint32_t nodeZ, float u, float v,
+	float amount)
+{
+	float *node = &heightmap[nodeX + (size_t) nodeZ * size];
+	node[0] += amount * (1.0f - u) * (1.0f - v);
+	node[1] += amount * u * (1.0f - v);
+	node[size] += amount * (1.0f - u) * v;
+	node[size + 1] += amount * u * v;
+}
+
+/* removes amount spread over the brush around a node, or over its four samples where the brush would leave the map */
+static void erodeSediment(const struct ErosionJob *job, uint32_t nodeX, uint32_t nodeZ, float u, float v,
+	float amount)
+{
+	const uint32_t r = job->radius;
+	if (nodeX < r || nodeZ < r || nodeX - r + job->brushWidth > job->size || nodeZ + r >= job->size) {
+		depositSediment(job->heightmap, job->size, nodeX, nodeZ, u, v, -amount);
+		return;
+	}
+
+	// padding weights are zero, so the samples under them are written back unchanged
+	float *origin = &job->heightmap[nodeX - r + (size_t) (nodeZ - r) * job->size];
+	for (uint32_t row = 0; row <= 2 * r; row++) {
+		float *samples = origin + (size_t) row * job->size;
+		const float *weights = &job->brush[row * job->brushWidth];
+		uint32_t i = 0;
+#ifdef EROSION_SSE2
+		const __m128 amount4 = _mm_set1_ps(amount);
+		for (; i < job->brushWidth; i += 4) {
+			__m128 h = _mm_loadu_ps(samples + i);
+			_mm_storeu_ps(samples + i, _mm_sub_ps(h, _mm_mul_ps(amount4, _mm_loadu_ps(weights + i))));
+		}
+#endif
+		for (; i < job->brushWidth; i++) {
+			samples[i] -= amount * weights[i];
+		}
+	}
+}
+
+/* one droplet from (x, z) until it evaporates, stops or leaves [minX, maxX) x [minZ, maxZ) */
+static void simulateDroplet(const struct ErosionJob *job, float x, float z, float minX, float minZ, float maxX,
+	float maxZ)
+{
+	const struct ErosionParams *params = job->params;
+	float directionX = 0.0f, directionZ = 0.0f, speed = 1.0f, water = 1.0f, sediment = 0.0f;
+
+	for (uint32_t life = 0; life < params->dropletLifetime; life++) {
+		const uint32_t nodeX = (uint32_t) x, nodeZ = (uint32_t) z;
+		const float u = x - (float) nodeX, v = z - (float) nodeZ;
+		float gradientX, gradientZ;
+		const float height = getHeightAndGradient(job->heightmap, job->size, x, z, &gradientX, &gradientZ);
+
+		directionX = directionX * params->inertia - gradientX * (1.0f - params->inertia);
+		directionZ = directionZ * params->inertia - gradientZ * (1.0f - params->inertia);
+		const float length = sqrtf(directionX * directionX + directionZ * directionZ);
+		if (length == 0.0f) {
+			break;
+		}
+		directionX /= length;
+		directionZ /= length;
+		const float nextX = x + directionX, nextZ = z + directionZ;
+		if (!(nextX >= minX && nextX < maxX && nextZ >= minZ && nextZ < maxZ)) {
+			break;
+		}
+		const float deltaHeight = getHeightAndGradient(job->heightmap, job->size, nextX, nextZ, &gradientX,
+			&gradientZ) - height;
+
+		const float capacity = fmaxf(-deltaHeight, params->minSlope) * speed * water * params->capacity;
+		if (sediment > capacity || deltaHeight > 0.0f) {
+			// going uphill it fills the hollow it's leaving, otherwise it drops what it can't carry
+			const float amount = deltaHeight > 0.0f ? fminf(deltaHeight, sediment) :
+				(sediment - capacity) * params->depositSpeed;
+			sediment -= amount;
+			depositSediment(job->heightmap, job->size, nodeX, nodeZ, u, v, amount);
+		} else {
+			// never deeper than the drop it's making, which would dig pits
+			const float amount = fminf((capacity - sediment) * params->erodeSpeed, -deltaHeight);
+			erodeSediment(job, nodeX, nodeZ, u, v, amount);
+			sediment += amount;
+		}
+
+		speed = sqrtf(fmaxf(speed * speed - deltaHeight * params->gravity, 0.0f));
+		water *= 1.0f - params->evaporateSpeed;
+		x = nextX;
+		z = nextZ;
+	}
+
+	// whatever is still carried settles where the droplet ends, so no material is lost
+	const uint32_t nodeX = (uint32_t) x, nodeZ = (uint32_t) z;
+	depositSediment(job->heightmap, job->size, nodeX, nodeZ, x - (float) nodeX, z - (float) nodeZ, sediment);
+}
+
+static bool erodeTiles(void *arg, uint32_t begin, uint32_t end)
+{
+	const struct ErosionJob *job = arg;
+	const uint32_t last = job->size - 1, tilesPerRow = (job->tilesPerSide - (job->corner & 1) + 1) / 2;
+	const uint32_t offsetX = roundOffsets[job->round][0], offsetZ = roundOffsets[job->round][1];
+
+	for (uint32_t i = begin; i < end; i++) {
+		const uint32_t tileX = i % tilesPerRow * 2 + (job->corner & 1);
+		const uint32_t tileZ = i / tilesPerRow * 2 + (job->corner >> 1);
+		// tiles on the first row and column are cut short by the round's offset, those on the last by the map
+		const uint32_t x0 = tileX ? tileX * EROSION_TILE_SIZE - offsetX : 0;
+		const uint32_t z0 = tileZ ? tileZ * EROSION_TILE_SIZE - offsetZ : 0;
+		const uint32_t endX = (tileX + 1) * EROSION_TILE_SIZE - offsetX, endZ = (tileZ + 1) * EROSION_TILE_SIZE - offsetZ;
+		const uint32_t x1 = endX < last ? endX : last, z1 = endZ < last ? endZ : last;
+		if (x0 >= x1 || z0 >= z1) {
+			continue;
+		}
+		const float minX = (float) (x0 > EROSION_MARGIN ? x0 - EROSION_MARGIN : 0);
+		const float minZ = (float) (z0 > EROSION_MARGIN ? z0 - EROSION_MARGIN : 0);
+		const float maxX = (float) (x1 + EROSION_MARGIN < last ? x1 + EROSION_MARGIN : last);
+		const float maxZ = (float) (z1 + EROSION_MARGIN < last ? z1 + EROSION_MARGIN : last);
+
+		uint32_t state = job->seed ^ tileX * 0x8da6b343u ^ tileZ * 0xd8163841u ^ job->round * 0xcb1ab31fu;
+		const uint32_t numDroplets = (uint32_t) (job->params->droplets * (float) ((x1 - x0) * (z1 - z0)) /
+			EROSION_ROUNDS + nextRandomFloat(&state));
+		for (uint32_t d = 0; d < numDroplets; d++) {
+			const float x = (float) x0 + nextRandomFloat(&state) * (float) (x1 - x0);
+			const float z = (float) z0 + nextRandomFloat(&state) * (float) (z1 - z0);
+			// rounding can land a start on the far edge
+			if (x < maxX && z < maxZ) {
+				simulateDroplet(job, x, z, minX, minZ, maxX, maxZ);
+			}
+		}
+	}
+	return true;
+}
+
+/* what moves from n to h: positive if n is more than talus above h, negative if more than talus below */
+static float getSlump(float h, float n, float talus)
+{
+	const float in = (n - h) - talus, out = (h - n) - talus;
+	return (in > 0.0f ? in : 0.0f) - (out > 0.0f ? out : 0.0f);
+}
+
+/* sample x of a row, up and down are the rows either side or NULL off the map */
+static float slumpSample(const struct ThermalJob *job, const float *row, const float *up, const float *down,
+	uint32_t x)
+{
+	const float h = row[x];
+	float flow = x > 0 ? getSlump(h, row[x - 1], job->talus) : 0.0f;
+	flow += x + 1 < job->size ? getSlump(h, row[x + 1], job->talus) : 0.0f;
+	flow += up ? getSlump(h, up[x], job->talus) : 0.0f;
+	flow += down ? getSlump(h, down[x], job->talus) : 0.0f;
+	return h + job->rate * flow;
+}
+
+#ifdef EROSION_SSE2
+static __m128 getSlump4(__m128 h, __m128 n, __m128 talus)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 in = _mm_sub_ps(_mm_sub_ps(n, h), talus), out = _mm_sub_ps(_mm_sub_ps(h, n), talus);
+	return _mm_sub_ps(_mm_and_ps(_mm_cmpgt_ps(in, zero), in), _mm_and_ps(_mm_cmpgt_ps(out, zero), out));
+}
+#endif
+
+/*
+ * Each sample exchanges material with its four neighbours, worked out from
+ * both their old heights, so what one gains the other loses and rows can be
+ * done in any order.
+ */
+static bool slumpRows(void *arg, uint32_t begin, uint32_t end)
+{
+	const struct ThermalJob *job = arg;
+	const uint32_t size = job->size;
+	for (uint32_t z = begin; z < end; z++) {
+		const float *row = &job->source[(size_t) z * size];
+		const float *up = z > 0 ? row - size : NULL, *down = z + 1 < size ? row + size : NULL;
+		float *destination = &job->destination[(size_t) z * size];
+
+		destination[0] = slumpSample(job, row, up, down, 0);
+		uint32_t x = 1;
+#ifdef EROSION_SSE2
+		if (up && down) {
+			const __m128 talus = _mm_set1_ps(job->talus), rate = _mm_set1_ps(job->rate);
+			for (; x + 4 < size; x += 4) {
+				const __m128 h = _mm_loadu_ps(row + x);
+				__m128 flow = getSlump4(h, _mm_loadu_ps(row + x - 1), talus);
+				flow = _mm_add_ps(flow, getSlump4(h, _mm_loadu_ps(row + x + 1), talus));
+				flow = _mm_add_ps(flow, getSlump4(h, _mm_loadu_ps(up + x), talus));
+				flow = _mm_add_ps(flow, getSlump4(h, _mm_loadu_ps(down + x), talus));
+				_mm_storeu_ps(destination + x, _mm_add_ps(h, _mm_mul_ps(rate, flow)));
+			}
+		}
+#endif
+		for (; x < size; x++) {
+			destination[x] = slumpSample(job, row, up, down, x);
+		}
+	}
+	return true;
+}
+
+static bool erodeThermal(float *heightmap, uint32_t size, const struct ErosionParams *params)
+{
+	float *scratch = malloc((size_t) size * size * sizeof(float));
+	if (!scratch) {
+		return false;
+	}
+	struct ThermalJob job = {
+		.source = heightmap, .destination = scratch, .size = size, .talus = fmaxf(params->talus, 0.0f),
+		.rate = fminf(fmaxf(params->thermalRate, 0.0f), 0.25f)
+	};
+	for (uint32_t i = 0; i < params->thermalIterations; i++) {
+		parallelFor(size, slumpRows, &job);
+		float *previous = (float *) job.source;
+		job.source = job.destination;
+		job.destination = previous;
+	}
+	if (job.source != heightmap) {
+		memcpy(heightmap, job.source, (size_t) size * size * sizeof(float));
+	}
+	free(scratch);
+	return true;
+}
+
+/* cone shaped weights summing to one, (2 * radius + 1) rows of width */
+static float *buildBrush(uint32_t radius, uint32_t width)
+{
+	float *brush = calloc((2 * radius + 1) * width, sizeof(float));
+	if (!brush) {
+		return NULL;
+	}
+	float sum = 0.0f;
+	for (uint32_t z = 0; z <= 2 * radius; z++) {
+		for (uint32_t x = 0; x <= 2 * radius; x++) {
+			const float dx = (float) x - (float) radius, dz = (float) z - (float) radius;
+			const float weight = 1.0f - sqrtf(dx * dx + dz * dz) / (float) (radius + 1);
+			brush[x + z * width] = weight > 0.0f ? weight : 0.0f;
+			sum += brush[x + z * width];
+		}
+	}
+	for (uint32_t i = 0; i < (2 * radius + 1) * width; i++) {
+		brush[i] /= sum;
+	}
+	return brush;
+}
+
+bool erodeHeightmap(float *heightmap, uint32_t size, const struct ErosionParams *params, unsigned int seed)
+{
+	struct ErosionParams defaults = getDefaultErosionParams();
+	if (!params) {
+		params = &defaults;
+	}
+	if (size < 2) {
+		return false;
+	}
+
+	if (params->droplets > 0.0f && params->dropletLifetime) {
+		struct ErosionJob job = {.heightmap = heightmap, .size = size, .params = params, .seed = seed};
+		job.radius = params->radius < EROSION_MAX_RADIUS ? params->radius : EROSION_MAX_RADIUS;
+		job.brushWidth = (2 * job.radius + 1 + 3) & ~3u;
+		float *brush = buildBrush(job.radius, job.brushWidth);
+		if (!brush) {
+			return false;
+		}
+		job.brush = brush;
+
+		// enough tiles for the largest offset, any left empty by a smaller one are skipped
+		job.tilesPerSide = (size - 1 + EROSION_TILE_SIZE / 2 + EROSION_TILE_SIZE - 1) / EROSION_TILE_SIZE;
+		for (job.round = 0; job.round < EROSION_ROUNDS; job.round++) {
+			for (job.corner = 0; job.corner < 4; job.corner++) {
+				const uint32_t columns = (job.tilesPerSide - (job.corner & 1) + 1) / 2;
+				const uint32_t rows = (job.tilesPerSide - (job.corner >> 1) + 1) / 2;
+				parallelFor(columns * rows, erodeTiles, &job);
+			}
+		}
+		free(brush);
+	}
+
+	if (params->thermalIterations && !erodeThermal(heightmap, size, params)) {
+		return false;
+	}
+	return true;
+}
+
+bool erodeTerrain(struct Terrain *t, const struct ErosionParams *params, unsigned int seed)
+{
+	if (t->stream || !t->heightmap) {
+		return false;
+	}
+	// erosion works on rows, as compactTerrainHeightmap does
+	const bool tiled = t->tiled;
+	if (tiled && !setTerrainHeightmapTiled(t, false)) {
+		return false;
+	}
+	// samples change in place, even when erosion fails part way, so a mapped file's tile bounds no longer hold
+	if (t->heightmapFile) {
+		t->heightmapFile->minMax = NULL;
+	}
+	bool eroded = erodeHeightmap(t->heightmap, t->size, params, seed);
+	if (tiled && !setTerrainHeightmapTiled(t, true)) {
+		return false;
+	}
+	if (eroded) {
+		updateTerrainRegion(t, 0, 0, t->size - 1, t->size - 1);
+	}
+	return eroded;
+}
@@ -0,0 +1,57 @@
+#ifndef EROSION_H
+#define EROSION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct Terrain;
+
+/*
+ * Droplets start in square tiles and die if they stray more than a quarter of
+ * a tile outside theirs, so tiles two apart never touch the same samples and
+ * are eroded at the same time.
+ */
+#define EROSION_TILE_SIZE 64
+#define EROSION_MAX_RADIUS 8
+
+/*
+ * Hydraulic erosion simulates water droplets running downhill, picking up
+ * sediment where they speed up and dropping it where they slow down, which
+ * carves gullies and fills valley floors. Thermal erosion then lets any slope
+ * steeper than talus slump, like loose rock settling. Heights are in the
+ * heightmap's units and distances in samples.
+ */
+struct ErosionParams {
+	float droplets; /* per heightmap sample, 0 to skip hydraulic erosion */
+	uint32_t dropletLifetime; /* in steps of one sample */
+	uint32_t radius; /* of the area a droplet erodes, up to EROSION_MAX_RADIUS */
+	float inertia; /* 0 to always follow the slope, 1 to never turn */
+	float capacity; /* sediment carried per unit of slope, speed and water */
+	float minSlope; /* so droplets on the flat still carry a little */
+	float depositSpeed, erodeSpeed; /* fraction of the excess or shortfall of sediment dropped or picked up per step */
+	float evaporateSpeed; /* fraction of water lost per step */
+	float gravity;
+	uint32_t thermalIterations; /* 0 to skip thermal erosion */
+	float talus; /* largest height difference between neighbouring samples that doesn't slump */
+	float thermalRate; /* fraction of the excess moved per iteration, up to 0.25 */
+};
+
+/* weathering for the 512 to 4096 sample maps the engine loads, about 3s of one core on a 2k map */
+struct ErosionParams getDefaultErosionParams(void);
+
+/*
+ * Erodes a row-major size * size heightmap in place, tiles split across cores
+ * and the thermal passes four samples at a time with SSE2. The result depends
+ * only on the heightmap, params and seed, never on the number of threads or
+ * the instruction set. NULL params for the defaults.
+ */
+bool erodeHeightmap(float *heightmap, uint32_t size, const struct ErosionParams *params, unsigned int seed);
+
+/*
+ * erodeHeightmap on a terrain's heightmap. Meant to run before meshing, but
+ * anything already built from the heightmap is brought up to date. Compacted
+ * heightmaps can't be eroded.
+ */
+bool erodeTerrain(struct Terrain *t, const struct ErosionParams *params, unsigned int seed);
+
+#endif
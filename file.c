@@ -1,6 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifdef _WIN32
+#include "Windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "file.h"
 
 char *loadFile(const char *name)
@@ -39,3 +48,59 @@ char *loadFile(const char *name)
 	return buf;
 }
 
+
+bool mapFile(const char *path, bool copyOnWrite, struct MappedFile *file)
+{
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	if (GetFileSizeEx(handle, &size) && size.QuadPart) {
+		mapping = CreateFileMappingA(handle, NULL, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+	}
+	if (!mapping) {
+		CloseHandle(handle);
+		return false;
+	}
+	file->base = MapViewOfFile(mapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	if (!file->base) {
+		CloseHandle(mapping);
+		CloseHandle(handle);
+		return false;
+	}
+	file->file = handle;
+	file->mapping = mapping;
+	file->length = (size_t) size.QuadPart;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+	file->base = mmap(NULL, st.st_size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (file->base == MAP_FAILED) {
+		return false;
+	}
+	file->length = st.st_size;
+#endif
+	return true;
+}
+
+void unmapFile(struct MappedFile *file)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(file->base);
+	CloseHandle(file->mapping);
+	CloseHandle(file->file);
+#else
+	munmap(file->base, file->length);
+#endif
+}
@@ -1,7 +1,28 @@
 #ifndef FILE_H
 #define FILE_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
+/* a whole file mapped into memory */
+struct MappedFile {
+	void *base;
+	size_t length;
+#ifdef _WIN32
+	void *file, *mapping;
+#endif
+};
+
 char *loadFile(const char *file);
 
+/*
+ * Read-only, or with copyOnWrite the mapping can be written to and changes
+ * stay private to the process, never reaching the file. false if the file
+ * can't be opened or is empty.
+ */
+bool mapFile(const char *path, bool copyOnWrite, struct MappedFile *file);
+
+void unmapFile(struct MappedFile *file);
+
 #endif
 
@@ -0,0 +1,116 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file.h"
+#include "heightmap.h"
+
+bool isHeightmapFile(const char *path)
+{
+	size_t len = strlen(path);
+	return len > 5 && strcmp(path + len - 5, ".hmap") == 0;
+}
+
+/* tiles include their far edge, so samples - 1 quads, at least one tile even for a single sample */
+static uint32_t getTileCount(uint32_t samples, uint32_t tileSize)
+{
+	const uint32_t tiles = (uint32_t) (((uint64_t) samples - 1 + tileSize - 1) / tileSize);
+	return tiles ? tiles : 1;
+}
+
+/* written so offsets near the top of the range can't wrap round and pass */
+static bool validRange(uint64_t offset, uint64_t size, size_t length)
+{
+	return offset <= length && size <= length - offset;
+}
+
+static bool validHeader(const struct HeightmapHeader *h, size_t length)
+{
+	if (length < sizeof(struct HeightmapHeader) || memcmp(h->magic, HEIGHTMAP_MAGIC, 4) != 0 ||
+		h->version != HEIGHTMAP_VERSION || !h->width || !h->height || !h->tileSize ||
+		h->tilesX != getTileCount(h->width, h->tileSize) || h->tilesZ != getTileCount(h->height, h->tileSize)) {
+		return false;
+	}
+	uint64_t minMaxSize = (uint64_t) h->tilesX * h->tilesZ * 2 * sizeof(float);
+	uint64_t samplesSize = (uint64_t) h->width * h->height * sizeof(float);
+	return h->minMaxOffset % sizeof(float) == 0 && h->samplesOffset % sizeof(float) == 0 &&
+		validRange(h->minMaxOffset, minMaxSize, length) && validRange(h->samplesOffset, samplesSize, length);
+}
+
+struct HeightmapFile *openHeightmapFile(const char *path)
+{
+	struct HeightmapFile *file = calloc(1, sizeof(struct HeightmapFile));
+	if (!file) {
+		return NULL;
+	}
+	// copy on write so the terrain can be edited in memory without touching the file
+	if (!mapFile(path, true, &file->mapping)) {
+		free(file);
+		return NULL;
+	}
+
+	file->header = file->mapping.base;
+	if (!validHeader(file->header, file->mapping.length)) {
+		fprintf(stderr, "%s is not a valid heightmap file.\n", path);
+		closeHeightmapFile(file);
+		return NULL;
+	}
+	file->samples = (float *) ((char *) file->mapping.base + file->header->samplesOffset);
+	file->minMax = (const float *) ((char *) file->mapping.base + file->header->minMaxOffset);
+	return file;
+}
+
+void closeHeightmapFile(struct HeightmapFile *file)
+{
+	unmapFile(&file->mapping);
+	free(file);
+}
+
+bool writeHeightmapFile(const char *path, const float *samples, uint32_t width, uint32_t height, float scale)
+{
+	struct HeightmapHeader header = {
+		.magic = HEIGHTMAP_MAGIC, .version = HEIGHTMAP_VERSION, .width = width, .height = height,
+		.scale = scale, .tileSize = HEIGHTMAP_TILE_SIZE
+	};
+	header.tilesX = getTileCount(width, HEIGHTMAP_TILE_SIZE);
+	header.tilesZ = getTileCount(height, HEIGHTMAP_TILE_SIZE);
+	header.minMaxOffset = sizeof(struct HeightmapHeader);
+	uint64_t minMaxSize = (uint64_t) header.tilesX * header.tilesZ * 2 * sizeof(float);
+	header.samplesOffset = (header.minMaxOffset + minMaxSize + HEIGHTMAP_ALIGNMENT - 1) /
+		HEIGHTMAP_ALIGNMENT * HEIGHTMAP_ALIGNMENT;
+
+	float *minMax = malloc(minMaxSize);
+	if (!minMax) {
+		return false;
+	}
+	for (uint32_t tz = 0; tz < header.tilesZ; tz++) {
+		for (uint32_t tx = 0; tx < header.tilesX; tx++) {
+			uint32_t x0 = tx * HEIGHTMAP_TILE_SIZE, z0 = tz * HEIGHTMAP_TILE_SIZE;
+			uint32_t x1 = x0 + HEIGHTMAP_TILE_SIZE < width - 1 ? x0 + HEIGHTMAP_TILE_SIZE : width - 1;
+			uint32_t z1 = z0 + HEIGHTMAP_TILE_SIZE < height - 1 ? z0 + HEIGHTMAP_TILE_SIZE : height - 1;
+			float lo = INFINITY, hi = -INFINITY;
+			for (uint32_t z = z0; z <= z1; z++) {
+				for (uint32_t x = x0; x <= x1; x++) {
+					lo = fminf(lo, samples[x + z * width]);
+					hi = fmaxf(hi, samples[x + z * width]);
+				}
+			}
+			minMax[(tx + tz * header.tilesX) * 2] = lo;
+			minMax[(tx + tz * header.tilesX) * 2 + 1] = hi;
+		}
+	}
+
+	FILE *f = fopen(path, "wb");
+	if (!f) {
+		free(minMax);
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(minMax, minMaxSize, 1, f) == 1;
+	free(minMax);
+	for (uint64_t i = header.minMaxOffset + minMaxSize; ok && i < header.samplesOffset; i++) {
+		ok = fputc(0, f) != EOF;
+	}
+	ok = ok && fwrite(samples, sizeof(float), (size_t) width * height, f) == (size_t) width * height;
+	return fclose(f) == 0 && ok;
+}
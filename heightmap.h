@@ -0,0 +1,58 @@
+#ifndef HEIGHTMAP_H
+#define HEIGHTMAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "file.h"
+
+/*
+ * Engine-native heightmap file. Samples are stored as the floats the terrain
+ * uses, at a page aligned offset, so a file can be mapped straight into
+ * Terrain::heightmap without decoding or copying and pages that are never
+ * touched are never read. Fields and samples are in the byte order of the
+ * machine that wrote the file, since the samples are used in place; a file
+ * from a machine of the other byte order fails the version check.
+ *
+ *	header (64 bytes)
+ *	tilesX * tilesZ (min, max) float pairs, row-major
+ *	padding up to samplesOffset
+ *	width * height float samples, row-major
+ */
+#define HEIGHTMAP_MAGIC "HMAP"
+#define HEIGHTMAP_VERSION 1
+/* quads along each side of a min/max tile, matching TERRAIN_LOD_PATCH_SIZE */
+#define HEIGHTMAP_TILE_SIZE 32
+#define HEIGHTMAP_ALIGNMENT 4096
+
+struct HeightmapHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t width, height; /* samples */
+	float scale; /* world units between samples the map was authored for */
+	uint32_t tileSize; /* tiles include their far edge, so neighbouring tiles share a row or column */
+	uint32_t tilesX, tilesZ;
+	uint64_t minMaxOffset;
+	uint64_t samplesOffset;
+	uint8_t reserved[16];
+};
+
+struct HeightmapFile {
+	struct MappedFile mapping;
+	const struct HeightmapHeader *header;
+	float *samples; /* copy on write, changes are never written back to the file */
+	const float *minMax; /* NULL once the samples have been changed and no longer match it */
+};
+
+/* maps a heightmap file into memory, returns NULL if it can't be opened or isn't valid */
+struct HeightmapFile *openHeightmapFile(const char *path);
+
+void closeHeightmapFile(struct HeightmapFile *file);
+
+bool writeHeightmapFile(const char *path, const float *samples, uint32_t width, uint32_t height, float scale);
+
+/* true if path names a native heightmap, by extension */
+bool isHeightmapFile(const char *path);
+
+#endif
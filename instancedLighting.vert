@@ -0,0 +1,70 @@
+#version 140
+
+// per frame, struct FrameUniforms
+layout(std140, row_major) uniform Frame {
+	mat4 projection;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	vec4 lightColour;
+	float lightIntensity;
+};
+
+in vec3 position;
+in vec3 normal;
+in vec2 vertexUV;
+in vec3 instancePosition; // per instance, the mesh x, y, z
+in vec2 instanceRotation; // per instance, the mesh rx, ry in degrees
+
+out vec2 UV;
+out vec4 colour;
+
+float angleBetween(vec4 a, vec4 b)
+{
+	float n = dot(a, b);
+	float d = length(a) * length(b);
+	return degrees(acos(n / d));
+}
+
+// the same rotations as loadXRotation and loadYRotation, columns given one after another
+mat3 xRotation(float angle)
+{
+	float c = cos(radians(angle)), s = sin(radians(angle));
+	return mat3(1.0f, 0.0f, 0.0f, 0.0f, c, -s, 0.0f, s, c);
+}
+
+mat3 yRotation(float angle)
+{
+	float c = cos(radians(angle)), s = sin(radians(angle));
+	return mat3(c, 0.0f, s, 0.0f, 1.0f, 0.0f, -s, 0.0f, c);
+}
+
+void main()
+{
+	// the model matrix drawMesh would upload, translation * y rotation * x rotation
+	mat3 rotation = yRotation(instanceRotation.y) * xRotation(instanceRotation.x);
+	mat4 modelMatrix = mat4(vec4(rotation[0], 0.0f), vec4(rotation[1], 0.0f), vec4(rotation[2], 0.0f),
+		vec4(instancePosition, 1.0f));
+
+	// from here on as vertexLighting.vert
+	vec4 worldPosition = modelMatrix * vec4(position, 1.0f);
+	vec4 worldNormal = vec4(rotation * normal, 0.0f);
+
+	vec4 lightToVertexRay = worldPosition - lightPosition;
+
+	// default brightness is ambient term
+	float energy = 0.5f;
+
+	// compute diffuse
+	if (dot(lightToVertexRay, worldNormal) <= 0) {
+		float brightness = angleBetween(lightToVertexRay, worldNormal) / 90.0f;
+
+		// compute attenuation (linear)
+		float attenuation = 1.0f / min((0.1f * distance(worldPosition, lightPosition)), 1.0f);
+
+		energy = max(attenuation * lightIntensity * brightness, 1.0f);
+	}
+
+	colour = energy * lightColour;
+	UV = vertexUV;
+	gl_Position = projection * viewMatrix * worldPosition;
+}
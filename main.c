@@ -1,19 +1,38 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
 #include "camera.h"
+#include "erosion.h"
 #include "file.h"
 #include "light.h"
 #include "maths.h"
 #include "mesh.h"
+#include "meshFile.h"
+#include "meshInstances.h"
+#include "meshLoad.h"
+#include "objImport.h"
+#include "renderQueue.h"
 #include "shader.h"
+#include "skybox.h"
+#include "staticBatch.h"
 #include "terrain.h"
+#include "terrainCache.h"
+#include "terrainEdit.h"
+#include "terrainGPU.h"
+#include "terrainLOD.h"
+#include "terrainRay.h"
+#include "terrainStream.h"
+#include "uniformRing.h"
 #include "myTime.h"
 
+/* furthest away the crater key picks a point on the terrain */
+#define CRATER_PICK_DISTANCE 200.0f
+
 /* Globals needed by processEvents */
 bool running = true;
 struct Camera camera = {.x = 0.0f, .y = 0.0f, .z = 0.0f, .rx = 0.0f, .ry = 0.0f, .height = 1.5f,
@@ -22,7 +41,7 @@ double timeSincePrevFrameSeconds; /* time since last frame */
 bool cameraMoved = true;
 struct Terrain *g_terrain;
 struct Mesh **g_meshes;
-struct Mesh **g_skyboxMeshes;
+struct StaticBatch *g_staticBatch; /* NULL unless run with --multi-draw */
 
 void processEvents(GLFWwindow *window)
 {
@@ -72,12 +91,34 @@ void processEvents(GLFWwindow *window)
 	if (cameraMoved) {
 		camera.x += xMove; camera.y += yMove; camera.z += zMove;
 		camera.y = terrainGetHeightAt(g_terrain, camera.x, camera.z) + camera.height;
-		// move skybox with camera
-		for (int i = 0; i < 6; i++) {
-			g_skyboxMeshes[i]->x += xMove;
-			g_skyboxMeshes[i]->y += yMove;
-			g_skyboxMeshes[i]->z += zMove;
+	}
+
+	// blast a crater where the camera looks at the ground, once per key press
+	static bool craterKeyDown = false;
+	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
+		if (!craterKeyDown) {
+			const float eye[] = {camera.x, camera.y, camera.z};
+			float look[] = {0.0f, 0.0f, -1.0f, 1.0f};
+			vectorXRotate(camera.rx, look);
+			vectorYRotate(camera.ry, look);
+			float distance;
+			if (terrainRaycast(g_terrain, eye, look, CRATER_PICK_DISTANCE, &distance)) {
+				craterTerrain(g_terrain, eye[0] + look[0] * distance, eye[2] + look[2] * distance, 3.0f, 1.5f);
+			} else {
+				// looking at the sky, a few metres in front instead
+				float ahead[] = {0.0f, 0.0f, -8.0f, 1.0f};
+				vectorYRotate(camera.ry, ahead);
+				craterTerrain(g_terrain, camera.x + ahead[0], camera.z + ahead[2], 3.0f, 1.5f);
+			}
+			if (g_staticBatch) {
+				refreshStaticBatch(g_staticBatch);
+			}
+			camera.y = terrainGetHeightAt(g_terrain, camera.x, camera.z) + camera.height;
+			cameraMoved = true;
 		}
+		craterKeyDown = true;
+	} else {
+		craterKeyDown = false;
 	}
 
 	/* Camera rotation */
@@ -99,8 +140,49 @@ void processEvents(GLFWwindow *window)
 	}
 }
 
+/* loadTerrain, eroded first if asked so everything built afterwards sees the weathered heights */
+static struct Terrain *loadDemoTerrain(uint32_t size, unsigned int seed, const char *map, bool erode)
+{
+	struct Terrain *t = loadTerrain(size, "textures/slate128.png", seed, map, 1);
+	if (t && erode && !erodeTerrain(t, NULL, seed)) {
+		fprintf(stderr, "Could not erode terrain.\n");
+	}
+	return t;
+}
+
 int main(int argc, char **argv)
 {
+	bool terrainLOD = false, terrainGPU = false, terrainErode = false, multiDraw = false;
+	const char *terrainStreamDirectory = NULL;
+	const char *modelPath = NULL;
+	const char *terrainMap = "heightmaps/pit.heightmap512.png";
+	unsigned int terrainSeed = 123;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--terrain-lod") == 0) {
+			terrainLOD = true;
+		} else if (strcmp(argv[i], "--terrain-gpu") == 0) {
+			terrainGPU = true;
+		} else if (strcmp(argv[i], "--terrain-erode") == 0) {
+			terrainErode = true;
+		} else if (strcmp(argv[i], "--multi-draw") == 0) {
+			multiDraw = true;
+		} else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) {
+			// an .obj or .mesh file, shown next to the origin marker
+			modelPath = argv[++i];
+		} else if (strcmp(argv[i], "--terrain-stream") == 0 && i + 1 < argc) {
+			terrainStreamDirectory = argv[++i];
+		} else if (strcmp(argv[i], "--terrain-map") == 0 && i + 1 < argc) {
+			// a 512x512 grayscale image or .hmap file
+			terrainMap = argv[++i];
+		} else if (strcmp(argv[i], "--terrain-seed") == 0 && i + 1 < argc) {
+			// procedural terrain instead of the heightmap image
+			terrainMap = NULL;
+			terrainSeed = (unsigned int) strtoul(argv[++i], NULL, 10);
+		} else {
+			fprintf(stderr, "Unknown option %s.\n", argv[i]);
+		}
+	}
+
 	// init opengl context
 	int windowWidth = 900, windowHeight = 900;
 	if (!glfwInit()) {
@@ -123,49 +205,112 @@ int main(int argc, char **argv)
 	}
 
 	// init shaders
-	GLuint basicProgram = getProgram("basic.frag", "basic.vert");
-	if (!basicProgram) {
-		fprintf(stderr, "Error creating basicProgram. Exiting.\n");
+	GLuint skyboxProgram = getProgram("skybox.frag", "skybox.vert");
+	if (!skyboxProgram) {
+		fprintf(stderr, "Error creating skyboxProgram. Exiting.\n");
 		glfwTerminate();
 		return EXIT_FAILURE;
 	}
 	GLuint vertexLightingProgram = getProgram("basic.frag", "vertexLighting.vert");
 	if (!vertexLightingProgram) {
 		fprintf(stderr, "Error creating vertexLightingProgram. Exiting.\n");
-		glDeleteProgram(basicProgram); glfwTerminate();
+		glDeleteProgram(skyboxProgram); glfwTerminate();
+		return EXIT_FAILURE;
+	}
+	GLuint instancedProgram = getProgram("basic.frag", "instancedLighting.vert");
+	if (!instancedProgram) {
+		fprintf(stderr, "Error creating instancedProgram. Exiting.\n");
+		glDeleteProgram(skyboxProgram); glDeleteProgram(vertexLightingProgram); glfwTerminate();
 		return EXIT_FAILURE;
 	}
 
+	GLuint terrainLODProgram = 0;
+	if (terrainLOD) {
+		terrainLODProgram = getProgram("basic.frag", "terrainLOD.vert");
+		if (!terrainLODProgram) {
+			fprintf(stderr, "Error creating terrainLODProgram. Exiting.\n");
+			glDeleteProgram(skyboxProgram); glDeleteProgram(vertexLightingProgram); glDeleteProgram(instancedProgram);
+			glfwTerminate();
+			return EXIT_FAILURE;
+		}
+	}
+	GLuint terrainGPUProgram = 0;
+	if (terrainGPU) {
+		terrainGPUProgram = getProgram("basic.frag", "terrainDisplacement.vert");
+		if (!terrainGPUProgram) {
+			fprintf(stderr, "Error creating terrainGPUProgram. Exiting.\n");
+			glDeleteProgram(skyboxProgram); glDeleteProgram(vertexLightingProgram); glDeleteProgram(instancedProgram);
+			glDeleteProgram(terrainLODProgram); glfwTerminate();
+			return EXIT_FAILURE;
+		}
+	}
+
 	float viewMatrix[16];
 	float projection[16] = {0};
 	loadPerspective(projection, 0.1f, 1000.0f, 45, (float) windowWidth / windowHeight);
+	float frustumPlanes[24];
+
+	/* Load uniforms, every program reads them from the uniform ring's Frame and Object blocks */
+	bindUniformBlocks(skyboxProgram);
+	bindUniformBlocks(vertexLightingProgram);
+	bindUniformBlocks(instancedProgram);
+	if (terrainLODProgram) {
+		bindUniformBlocks(terrainLODProgram);
+	}
+	if (terrainGPUProgram) {
+		bindUniformBlocks(terrainGPUProgram);
+	}
 
 	glUseProgram(vertexLightingProgram);
 	/* Load attribs */
 	GLint positionAttribLocation = glGetAttribLocation(vertexLightingProgram, "position");
 	GLint normalAttribLocation = glGetAttribLocation(vertexLightingProgram, "normal");
 	GLint vertexUVAttribLocation = glGetAttribLocation(vertexLightingProgram, "vertexUV");
-	/* Load uniforms */
-	GLint projectionUniformLocation = glGetUniformLocation(vertexLightingProgram, "projection");
-	GLint viewMatrixUniformLocation = glGetUniformLocation(vertexLightingProgram, "viewMatrix");
-	GLint modelMatrixUniformLocation = glGetUniformLocation(vertexLightingProgram, "modelMatrix");
-	GLint modelXRotationMatrixUniformLocation = glGetUniformLocation(vertexLightingProgram, "modelXRotationMatrix");
-	GLint modelYRotationMatrixUniformLocation = glGetUniformLocation(vertexLightingProgram, "modelYRotationMatrix");
-	GLint lightPositionUniformLocation = glGetUniformLocation(vertexLightingProgram, "lightPosition");
-	GLint lightColourUniformLocation = glGetUniformLocation(vertexLightingProgram, "lightColour");
-	GLint lightIntensityUniformLocation = glGetUniformLocation(vertexLightingProgram, "lightIntensity");
-	glUniformMatrix4fv(projectionUniformLocation, 1, GL_FALSE, projection);
 
 	const uint32_t terrainSize = 512;
-	g_terrain = generateTerrain(terrainSize, positionAttribLocation, vertexUVAttribLocation,
-		normalAttribLocation, "textures/slate128.png", 123, "heightmaps/pit.heightmap512.png", 1);
+	if (terrainLOD) {
+		g_terrain = loadDemoTerrain(terrainSize, terrainSeed, terrainMap, terrainErode);
+		if (g_terrain && !buildTerrainLOD(g_terrain, terrainLODProgram, 64.0f)) {
+			cleanupTerrain(g_terrain);
+			g_terrain = NULL;
+		}
+	} else if (terrainGPU) {
+		// no meshes, the heightmap texture is all the GPU needs
+		g_terrain = loadDemoTerrain(terrainSize, terrainSeed, terrainMap, terrainErode);
+		if (g_terrain && !buildTerrainGPU(g_terrain, terrainGPUProgram)) {
+			cleanupTerrain(g_terrain);
+			g_terrain = NULL;
+		}
+	} else if (terrainStreamDirectory) {
+		// 256 quad tiles, loaded within 400m
+		g_terrain = streamTerrain(terrainStreamDirectory, 256, 1, 400.0f, "textures/slate128.png",
+			positionAttribLocation, vertexUVAttribLocation, normalAttribLocation);
+	} else {
+		// the meshed chunks are cached, so later launches with the same heightmap only upload them
+		g_terrain = loadDemoTerrain(terrainSize, terrainSeed, terrainMap, terrainErode);
+		char cachePath[256];
+		bool built = g_terrain && (getTerrainCachePath(cachePath, sizeof(cachePath), "cache", terrainMap,
+			terrainSeed, terrainSize) ? buildTerrainChunksCached(g_terrain, cachePath, positionAttribLocation,
+			vertexUVAttribLocation, normalAttribLocation) : buildTerrainChunks(g_terrain, positionAttribLocation,
+			vertexUVAttribLocation, normalAttribLocation));
+		if (g_terrain && !built) {
+			cleanupTerrain(g_terrain);
+			g_terrain = NULL;
+		}
+	}
 	if (!g_terrain) {
 		fprintf(stderr, "Error creating terrain. Exiting.\n");
-		glDeleteProgram(basicProgram); glDeleteProgram(vertexLightingProgram); glfwTerminate();
+		glDeleteProgram(skyboxProgram); glDeleteProgram(vertexLightingProgram); glDeleteProgram(instancedProgram);
+		glDeleteProgram(terrainLODProgram); glDeleteProgram(terrainGPUProgram); glfwTerminate();
 		return EXIT_FAILURE;
 	}
-	g_terrain->mesh->x = (g_terrain->scale * (float) terrainSize) / -2.0f;
-	g_terrain->mesh->z = (g_terrain->scale * (float) terrainSize) / -2.0f;
+	if (g_terrain->stream) {
+		// everything around the starting point has to be there to place objects on
+		updateTerrainStream(g_terrain, camera.x, camera.z, true);
+	} else {
+		g_terrain->x = (g_terrain->scale * (float) terrainSize) / -2.0f;
+		g_terrain->z = (g_terrain->scale * (float) terrainSize) / -2.0f;
+	}
 
 	camera.y = terrainGetHeightAt(g_terrain, camera.x, camera.z) + camera.height;
 
@@ -174,9 +319,13 @@ int main(int argc, char **argv)
 		.x = 0.0f, .y = 5.0f/*terrainGetHeightAt(g_terrain, 0.0f, 0.0f) + 10.0f*/, .z = 0.0f, .w = 1.0f,
 		.r = 1.0f, .g = 1.0f, .b = 1.0f, .a = 1.0f, .intensity = 1.0f
 	};
-	glUniform4f(lightPositionUniformLocation, light.x, light.y, light.z, light.w);
-	glUniform4f(lightColourUniformLocation, light.r, light.g, light.b, light.a);
-	glUniform1f(lightIntensityUniformLocation, light.intensity);
+	struct FrameUniforms frameUniforms = {
+		.lightPosition = {light.x, light.y, light.z, light.w},
+		.lightColour = {light.r, light.g, light.b, light.a},
+		.lightIntensity = light.intensity
+	};
+	// projection is stored column-major for GL, the blocks are row-major like the rest of the maths
+	transpose(projection, frameUniforms.projection);
 
 	struct Mesh *meshes[] = {
 		// ground
@@ -186,19 +335,6 @@ int main(int argc, char **argv)
 		pyramid(0.0f, terrainGetHeightAt(g_terrain, 0.0f, 0.0f), 0.0f, 1.0f, positionAttribLocation,
 			vertexUVAttribLocation, normalAttribLocation, "textures/walnut512.png"),
 
-		// objects
-		cube(0.0f, 0.5f + terrainGetHeightAt(g_terrain, 0.0f, -7.0f), -7.0f, 1.0f, positionAttribLocation,
-			vertexUVAttribLocation, normalAttribLocation, "textures/brick512.png"),
-		cube(-5.0f, 0.5f + terrainGetHeightAt(g_terrain, -5.0f, -3.0f), -3.0f, 1.0f, positionAttribLocation,
-			vertexUVAttribLocation, normalAttribLocation, "textures/brick512.png"),
-		cube(-4.0f, 0.5f + terrainGetHeightAt(g_terrain, -4.0f, -5.0f), -5.0f, 1.0f, positionAttribLocation,
-			vertexUVAttribLocation, normalAttribLocation, "textures/brick512.png"),
-		pyramid(-2.0f, terrainGetHeightAt(g_terrain, -2.0f, 3.0f), 3.0f, 1.0f, positionAttribLocation,
-			vertexUVAttribLocation, normalAttribLocation, "textures/stone512.png"),
-		pyramid(-3.0f, terrainGetHeightAt(g_terrain, -3.0f, 3.0f), 3.0f, 1.0f, positionAttribLocation,
-			vertexUVAttribLocation, normalAttribLocation, "textures/stone512.png"),
-		pyramid(-4.0f, terrainGetHeightAt(g_terrain, -4.0f, 3.0f), 3.0f, 1.0f, positionAttribLocation,
-			vertexUVAttribLocation, normalAttribLocation, "textures/stone512.png"),
 		// light
 //		cube(light.x, light.y, light.z, 1.0f, positionAttribLocation,
 //			vertexUVAttribLocation, normalAttribLocation, "textures/lightning128.png")
@@ -206,50 +342,81 @@ int main(int argc, char **argv)
 	// rotate ground so it's flat
 	meshes[0]->rx = 90.0f;
 
-	glUseProgram(basicProgram);
-	// load attribs
-	GLint basicPositionAttribLocation = glGetAttribLocation(basicProgram, "position");
-	GLint basicNormalAttribLocation = glGetAttribLocation(basicProgram, "normal");
-	GLint basicVertexUVAttribLocation = glGetAttribLocation(basicProgram, "vertexUV");
-	// load uniforms
-	GLint basicProjectionUniformLocation = glGetUniformLocation(basicProgram, "projection");
-	GLint basicViewMatrixUniformLocation = glGetUniformLocation(basicProgram, "viewMatrix");
-	GLint basicModelMatrixUniformLocation = glGetUniformLocation(basicProgram, "modelMatrix");
-	GLint basicModelXRotationMatrixUniformLocation = glGetUniformLocation(basicProgram, "modelXRotationMatrix");
-	GLint basicModelYRotationMatrixUniformLocation = glGetUniformLocation(basicProgram, "modelYRotationMatrix");
-	glUniformMatrix4fv(basicProjectionUniformLocation, 1, GL_FALSE, projection);
-
-	struct Mesh *skyboxMeshes[] = {
-		// skybox
-		// front 1
-		square(0.0f, 0.0f, -500.0f, 1000.0f, basicPositionAttribLocation, basicVertexUVAttribLocation, basicNormalAttribLocation,
-			"skyboxes/bluecloud/bluecloud_bk.jpg"),
-		// back 2
-		square(0.0f, 0.0f, 500.0f, 1000.0f, basicPositionAttribLocation, basicVertexUVAttribLocation, basicNormalAttribLocation,
-			"skyboxes/bluecloud/bluecloud_ft.jpg"),
-		// left 3
-		square(-500.0f, 0.0f, 0.0f, 1000.0f, basicPositionAttribLocation, basicVertexUVAttribLocation, basicNormalAttribLocation,
-			"skyboxes/bluecloud/bluecloud_lf.jpg"),
-		// right 4
-		square(500.0f, 0.0f, 0.0f, 1000.0f, basicPositionAttribLocation, basicVertexUVAttribLocation, basicNormalAttribLocation,
-			"skyboxes/bluecloud/bluecloud_rt.jpg"),
-		// top 5
-		square(0.0f, 500.0f, 0.0f, 1000.0f, basicPositionAttribLocation, basicVertexUVAttribLocation, basicNormalAttribLocation,
-			"skyboxes/bluecloud/bluecloud_up.jpg"),
-		//bottom 6
-		square(0.0f, -500.0f, 0.0f, 1000.0f, basicPositionAttribLocation, basicVertexUVAttribLocation, basicNormalAttribLocation,
-			"skyboxes/bluecloud/bluecloud_dn.jpg")
+	struct Mesh *model = NULL;
+	if (modelPath) {
+		const float y = terrainGetHeightAt(g_terrain, 3.0f, 0.0f);
+		if (isMeshFile(modelPath)) {
+			model = loadMeshFile(modelPath, 3.0f, y, 0.0f, positionAttribLocation, vertexUVAttribLocation,
+				normalAttribLocation, "textures/walnut512.png");
+		} else if (isObjFile(modelPath)) {
+			model = loadObjMesh(modelPath, 3.0f, y, 0.0f, positionAttribLocation, vertexUVAttribLocation,
+				normalAttribLocation, "textures/walnut512.png");
+		} else {
+			fprintf(stderr, "Unknown model format %s.\n", modelPath);
+		}
+	}
+
+	// objects, each kind drawn with one instanced call however many there are
+	struct Mesh *crate = cube(0.0f, 0.0f, 0.0f, 1.0f, glGetAttribLocation(instancedProgram, "position"),
+		glGetAttribLocation(instancedProgram, "vertexUV"), glGetAttribLocation(instancedProgram, "normal"),
+		"textures/brick512.png");
+	struct Mesh *rock = pyramid(0.0f, 0.0f, 0.0f, 1.0f, glGetAttribLocation(instancedProgram, "position"),
+		glGetAttribLocation(instancedProgram, "vertexUV"), glGetAttribLocation(instancedProgram, "normal"),
+		"textures/stone512.png");
+	struct MeshInstances *crates = crate ? createMeshInstances(crate, instancedProgram) : NULL;
+	struct MeshInstances *rocks = rock ? createMeshInstances(rock, instancedProgram) : NULL;
+	if (crates) {
+		addMeshInstance(crates, 0.0f, 0.5f + terrainGetHeightAt(g_terrain, 0.0f, -7.0f), -7.0f, 0.0f, 0.0f);
+		addMeshInstance(crates, -5.0f, 0.5f + terrainGetHeightAt(g_terrain, -5.0f, -3.0f), -3.0f, 0.0f, 0.0f);
+		addMeshInstance(crates, -4.0f, 0.5f + terrainGetHeightAt(g_terrain, -4.0f, -5.0f), -5.0f, 0.0f, 0.0f);
+	}
+	if (rocks) {
+		addMeshInstance(rocks, -2.0f, terrainGetHeightAt(g_terrain, -2.0f, 3.0f), 3.0f, 0.0f, 0.0f);
+		addMeshInstance(rocks, -3.0f, terrainGetHeightAt(g_terrain, -3.0f, 3.0f), 3.0f, 0.0f, 0.0f);
+		addMeshInstance(rocks, -4.0f, terrainGetHeightAt(g_terrain, -4.0f, 3.0f), 3.0f, 0.0f, 0.0f);
+	}
+
+	const char *skyboxFaces[] = {
+		"skyboxes/bluecloud/bluecloud_rt.jpg", "skyboxes/bluecloud/bluecloud_lf.jpg",
+		"skyboxes/bluecloud/bluecloud_up.jpg", "skyboxes/bluecloud/bluecloud_dn.jpg",
+		"skyboxes/bluecloud/bluecloud_ft.jpg", "skyboxes/bluecloud/bluecloud_bk.jpg"
 	};
-	// rotate skybox meshes so they face inwards
-	skyboxMeshes[1]->ry = 180.0f;
-	skyboxMeshes[2]->ry = 270.0f;
-	skyboxMeshes[3]->ry = 90.0f;
-	skyboxMeshes[4]->rx = -90.0f; skyboxMeshes[4]->ry = 90.0f;
-	skyboxMeshes[5]->rx = 90.0f; skyboxMeshes[5]->ry = 90.0f;
-
-	g_skyboxMeshes = skyboxMeshes;
+	struct Skybox *skybox = createSkybox(skyboxFaces, glGetAttribLocation(skyboxProgram, "position"));
+
 	g_meshes = meshes;
 
+	// the terrain chunks and meshes never move, so can all be drawn from one batch
+	if (multiDraw && !staticBatchSupported()) {
+		fprintf(stderr, "Multi-draw indirect isn't supported, drawing through the render queue.\n");
+	} else if (multiDraw) {
+		const uint32_t numMeshes = sizeof(meshes) / sizeof(struct Mesh *);
+		const uint32_t numChunks = terrainLOD || terrainGPU || g_terrain->stream ? 0 :
+			g_terrain->numChunks * g_terrain->numChunks;
+		struct Mesh **staticMeshes = malloc((numChunks + numMeshes) * sizeof(struct Mesh *));
+		if (staticMeshes) {
+			getTerrainChunkMeshes(g_terrain, 0, numChunks, staticMeshes);
+			memcpy(staticMeshes + numChunks, meshes, sizeof(meshes));
+			g_staticBatch = createStaticBatch(staticMeshes, numChunks + numMeshes, instancedProgram);
+			free(staticMeshes);
+		}
+		if (!g_staticBatch) {
+			fprintf(stderr, "Error creating static batch, drawing through the render queue.\n");
+		}
+	}
+
+	// everything but LOD and GPU terrain is drawn through the queue, sorted to change state as little as possible
+	struct RenderQueue *renderQueue = createRenderQueue();
+	// room for a few hundred objects a frame to begin with
+	struct UniformRing *uniformRing = createUniformRing(64 * 1024);
+	if (!renderQueue || !uniformRing) {
+		fprintf(stderr, "Error creating render queue or uniform ring. Exiting.\n");
+		running = false;
+	}
+	uint32_t lightingQueueProgram = 0, instancedQueueProgram = 0;
+	if (renderQueue) {
+		lightingQueueProgram = addRenderProgram(renderQueue, vertexLightingProgram, true);
+		instancedQueueProgram = addRenderProgram(renderQueue, instancedProgram, false);
+	}
 
 	glClearColor(0.0f, 0.6f, 0.8f, 1.0f);
 	glEnable(GL_DEPTH_TEST);
@@ -257,8 +424,9 @@ int main(int argc, char **argv)
 	uint32_t frame = 0;
 	float totalTime = 0;
 	const uint32_t frameRateUpdateInterval = 100;
-	const char *titleFormat = "OpenGL - FPS = %.2f";
-	uint32_t titleFormatLength = 1 + snprintf(NULL, 0, titleFormat, 111.11f);
+	const char *titleFormat = "OpenGL - FPS = %.2f, %u drawn, %u culled";
+	uint32_t titleFormatLength = 1 + snprintf(NULL, 0, titleFormat, 111.11f, UINT32_MAX, UINT32_MAX);
+	uint32_t numDrawn = 0, numCulled = 0; // by the last frame's static batch and render queue
 
 	while (running && !glfwWindowShouldClose(window)) {
 		/* Setup */
@@ -272,7 +440,7 @@ int main(int argc, char **argv)
 		if (frame == frameRateUpdateInterval) {
 			float FPS = frameRateUpdateInterval / totalTime;
 			char title[titleFormatLength];
-			snprintf(title, titleFormatLength, titleFormat, FPS);
+			snprintf(title, titleFormatLength, titleFormat, FPS, numDrawn, numCulled);
 			glfwSetWindowTitle(window, title);
 			totalTime = 0;
 			frame = 0;
@@ -285,31 +453,66 @@ int main(int argc, char **argv)
 			MatrixMatrixMul(viewMatrix, temp);
 			loadTranslation(-camera.x, -camera.y, -camera.z, temp);
 			MatrixMatrixMul(viewMatrix, temp);
+			memcpy(frameUniforms.viewMatrix, viewMatrix, sizeof(frameUniforms.viewMatrix));
+
+			// projection is stored column-major for GL, the rest of the maths is row-major
+			float viewProjection[16];
+			transpose(projection, viewProjection);
+			MatrixMatrixMul(viewProjection, viewMatrix);
+			loadFrustumPlanes(viewProjection, frustumPlanes);
 			cameraMoved = false;
 		}
 
+		if (g_terrain->stream) {
+			updateTerrainStream(g_terrain, camera.x, camera.z, false);
+		}
+
 		/* Render */
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		beginUniformFrame(uniformRing, &frameUniforms);
+
+		const float cameraPosition[] = {camera.x, camera.y, camera.z};
+		if (terrainLOD) {
+			glUseProgram(terrainLODProgram);
+			drawTerrainLOD(g_terrain, frustumPlanes, cameraPosition);
+		} else if (terrainGPU) {
+			glUseProgram(terrainGPUProgram);
+			drawTerrainGPU(g_terrain, frustumPlanes);
+		}
 
-		glUseProgram(vertexLightingProgram);
-		glUniformMatrix4fv(viewMatrixUniformLocation, 1, GL_TRUE, viewMatrix);
-
-		drawMesh(g_terrain->mesh, modelMatrixUniformLocation, modelXRotationMatrixUniformLocation,
-			modelYRotationMatrixUniformLocation);
-
+		beginRenderQueue(renderQueue, cameraPosition, frustumPlanes);
+		if (!terrainLOD && !terrainGPU && (!g_staticBatch || g_terrain->stream)) {
+			queueTerrain(g_terrain, renderQueue, lightingQueueProgram);
+		}
+		for (int i = 0; !g_staticBatch && i < sizeof(meshes) / sizeof(struct Mesh *); i++) {
+			queueMesh(renderQueue, RENDER_PASS_OPAQUE, lightingQueueProgram, meshes[i]);
+		}
+		if (model) {
+			queueMesh(renderQueue, RENDER_PASS_OPAQUE, lightingQueueProgram, model);
+		}
+		if (crates) {
+			queueMeshInstances(renderQueue, RENDER_PASS_OPAQUE, instancedQueueProgram, crates);
+		}
+		if (rocks) {
+			queueMeshInstances(renderQueue, RENDER_PASS_OPAQUE, instancedQueueProgram, rocks);
+		}
 //		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		for (int i = 0; i < sizeof(meshes) / sizeof(struct Mesh *); i++) {
-			drawMesh(meshes[i], modelMatrixUniformLocation, modelXRotationMatrixUniformLocation,
-				modelYRotationMatrixUniformLocation);
+		numDrawn = 0; numCulled = 0;
+		if (g_staticBatch) {
+			glUseProgram(instancedProgram);
+			numDrawn = drawStaticBatch(g_staticBatch, frustumPlanes);
+			numCulled = g_staticBatch->numCulled;
 		}
+		numDrawn += drawRenderQueue(renderQueue, uniformRing);
+		numCulled += renderQueue->numCulled;
 //		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-		glUseProgram(basicProgram);
-		glUniformMatrix4fv(basicViewMatrixUniformLocation, 1, GL_TRUE, viewMatrix);
-		for (int i = 0; i < sizeof(skyboxMeshes) / sizeof(struct Mesh *); i++) {
-			drawMesh(skyboxMeshes[i], basicModelMatrixUniformLocation, basicModelXRotationMatrixUniformLocation,
-				basicModelYRotationMatrixUniformLocation);
+		// last, so it's only drawn where nothing else was
+		if (skybox) {
+			glUseProgram(skyboxProgram);
+			drawSkybox(skybox);
 		}
+		endUniformFrame(uniformRing);
 
 		glfwSwapBuffers(window);
 
@@ -324,14 +527,41 @@ int main(int argc, char **argv)
 	for (int i = 0; i < sizeof(meshes) / sizeof(struct Mesh *); i++) {
 		CleanupMesh(meshes[i]);
 	}
-	for (int i = 0; i < sizeof(skyboxMeshes) / sizeof(struct Mesh *); i++) {
-		CleanupMesh(skyboxMeshes[i]);
+	if (skybox) {
+		cleanupSkybox(skybox);
+	}
+	if (g_staticBatch) {
+		cleanupStaticBatch(g_staticBatch);
+	}
+	if (renderQueue) {
+		cleanupRenderQueue(renderQueue);
+	}
+	if (uniformRing) {
+		cleanupUniformRing(uniformRing);
+	}
+	if (crates) {
+		cleanupMeshInstances(crates);
+	}
+	if (rocks) {
+		cleanupMeshInstances(rocks);
+	}
+	if (crate) {
+		CleanupMesh(crate);
+	}
+	if (model) {
+		CleanupMesh(model);
+	}
+	if (rock) {
+		CleanupMesh(rock);
 	}
 	cleanupTerrain(g_terrain);
 
 	// shaders
-	glDeleteProgram(basicProgram);
+	glDeleteProgram(skyboxProgram);
 	glDeleteProgram(vertexLightingProgram);
+	glDeleteProgram(instancedProgram);
+	glDeleteProgram(terrainLODProgram);
+	glDeleteProgram(terrainGPUProgram);
 
 	glfwTerminate();
 	return EXIT_SUCCESS;
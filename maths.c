@@ -53,45 +53,6 @@ float barycentric(float ax, float ay, float az, float bx, float by, float bz, fl
 */
 }
 
-float l(float a, float b, float x)
-{
-	return a * (1.0f - x) + b * x;
-}
-
-float lerpx(float x, float y)
-{
-//	printf("lerpx(%f, %f)\n", x, y);
-	float x0, y0, x1, y1, fx, fy;
-	x0 = floorf(x); x1 = ceilf(x);
-	y0 = floorf(y); y1 = ceilf(y);
-	fx = x - x0; fy = y - y0;
-
-//	float i0 = lerp(x0, y0, x1, y0, x);
-	float i0 = l(x0, x1, fx);
-	printf("i0 %f\n", i0);
-	float i1 = lerp(x0, y1, x1, y1, x);
-	float r = lerp(i0, y0, i1, y1, y);
-//	printf("r %f\n", r);
-}
-
-float noise2D(float x, float z)
-{
-//	printf("noise2D(%f, %f)\n", x, z);
-	float y = 0;
-
-	const int n = 1;
-
-	float freq, amp;
-
-	for (int i = 0; i < n; i++) {
-		freq = 1.0f;//powf(2, i);
-		amp = 1.0f;// / (powf(freq, 2));
-		y += lerpx(x * freq, z * freq) * amp;
-	}
-
-	return y;
-}
-
 float smallRand()
 {
 	return (((float) rand() / RAND_MAX) * 2.0f) - 1.0f;
@@ -326,6 +287,15 @@ void identity(float *mat)
 	mat[15] = 1.0f;
 }
 
+void transpose(const float *mat, float *out)
+{
+	for (int row = 0; row < 4; row++) {
+		for (int col = 0; col < 4; col++) {
+			out[col * 4 + row] = mat[row * 4 + col];
+		}
+	}
+}
+
 void vectorMatrixMul(float *vec, float *mat)
 {
 	float result[4] = {0};
@@ -362,6 +332,34 @@ void vectorZRotate(float zRotation, float *vec)
 	vectorMatrixMul(vec, mat);
 }
 
+void loadFrustumPlanes(const float *m, float *planes)
+{
+	// Gribb & Hartmann: each plane is the w row plus or minus one of the x, y, z rows
+	for (int i = 0; i < 6; i++) {
+		const float *row = &m[(i / 2) * 4];
+		const float sign = (i % 2) ? -1.0f : 1.0f; // left, right, bottom, top, near, far
+		float *plane = &planes[i * 4];
+		for (int j = 0; j < 4; j++) {
+			plane[j] = m[12 + j] + sign * row[j];
+		}
+	}
+}
+
+bool aabbInFrustum(const float *planes, const float *min, const float *max)
+{
+	for (int i = 0; i < 6; i++) {
+		const float *p = &planes[i * 4];
+		// the corner furthest along the plane normal
+		float x = p[0] >= 0.0f ? max[0] : min[0];
+		float y = p[1] >= 0.0f ? max[1] : min[1];
+		float z = p[2] >= 0.0f ? max[2] : min[2];
+		if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0.0f) {
+			return false;
+		}
+	}
+	return true;
+}
+
 void loadPerspective(float *mat, float near, float far, float FOV, float aspectRatio)
 {
 //	float depth = far - near;
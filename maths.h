@@ -21,8 +21,6 @@ float distance3D(float ax, float ay, float az, float bx, float by, float bz);
 float barycentric(float ax, float ay, float az, float bx, float by, float bz, float cx, float cy, float cz,
 	float ix, float iz);
 
-float noise2D(float x, float z);
-
 // return a random number [-1, 1]. Seed before calling
 float smallRand();
 
@@ -52,6 +50,8 @@ void identity(float *mat);
 
 void MatrixMatrixMul(float *a, float *b);
 
+void transpose(const float *mat, float *out);
+
 void vectorMatrixMul(float *vec, float *mat);
 
 void vectorXRotate(float xRotation, float *vec);
@@ -60,5 +60,12 @@ void vectorYRotate(float yRotation, float *vec);
 
 void vectorZRotate(float yRotation, float *vec);
 
+// fills planes with the 6 frustum planes (a, b, c, d) of a row-major view-projection matrix,
+// normals point inwards
+void loadFrustumPlanes(const float *viewProjection, float *planes);
+
+// false only if the box is entirely outside one of the planes
+bool aabbInFrustum(const float *planes, const float *min, const float *max);
+
 #endif
 
@@ -1,57 +1,129 @@
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include <string.h>
 
 #include "file.h"
 #include "maths.h"
 #include "mesh.h"
+#include "resources.h"
+#include "uniformRing.h"
 #include "utils.h"
+#include "vertexFormat.h"
 
 void CleanupMesh(struct Mesh *mesh)
 {
-	glDeleteVertexArrays(1, &mesh->VAO);
-	glDeleteBuffers(1, &mesh->positionsBuffer);
-	glDeleteBuffers(1, &mesh->normals);
-	glDeleteBuffers(1, &mesh->textureCoordinatesBuffer);
-	glDeleteTextures(1, &mesh->texture);
+	if (mesh->geometry) {
+		releaseGeometry(mesh->geometry);
+	} else {
+		glDeleteVertexArrays(1, &mesh->VAO);
+		glDeleteBuffers(1, &mesh->vertexBuffer);
+		glDeleteBuffers(1, &mesh->indexBuffer);
+	}
+	if (mesh->textureResource) {
+		releaseTexture(mesh->textureResource);
+	} else {
+		glDeleteTextures(1, &mesh->texture);
+	}
 	free(mesh);
 }
 
-void drawMesh(struct Mesh *mesh, GLint modelMatrixUniformLocation, GLint modelXRotationMatrixUniformLocation, GLint modelYRotationMatrixUniformLocation)
+void loadMeshObjectUniforms(const struct Mesh *mesh, struct ObjectUniforms *uniforms)
 {
-	float xRotation[16];
-	loadXRotation(mesh->rx, xRotation);
-	glUniformMatrix4fv(modelXRotationMatrixUniformLocation, 1, GL_TRUE, xRotation);
+	loadXRotation(mesh->rx, uniforms->modelXRotationMatrix);
+	loadYRotation(mesh->ry, uniforms->modelYRotationMatrix);
+
+	float rotation[16];
+	memcpy(rotation, uniforms->modelYRotationMatrix, sizeof(rotation));
+	MatrixMatrixMul(rotation, uniforms->modelXRotationMatrix);
+	loadTranslation(mesh->x, mesh->y, mesh->z, uniforms->modelMatrix);
+	MatrixMatrixMul(uniforms->modelMatrix, rotation);
+}
 
-	float yRotation[16];
-	loadYRotation(mesh->ry, yRotation);
-	glUniformMatrix4fv(modelYRotationMatrixUniformLocation, 1, GL_TRUE, yRotation);
+GLuint getMeshVertexBuffer(const struct Mesh *mesh)
+{
+	return mesh->geometry ? mesh->geometry->vertexBuffer : mesh->vertexBuffer;
+}
 
-	float translation[16]; // model
-	loadTranslation(mesh->x, mesh->y, mesh->z, translation);
-	MatrixMatrixMul(yRotation, xRotation);
-	MatrixMatrixMul(translation, yRotation);
+void setMeshTexture(struct Mesh *mesh, const char *texture)
+{
+	// meshes whose texture can't be loaded are still drawn, untextured
+	mesh->textureResource = acquireTexture(texture);
+	if (mesh->textureResource) {
+		mesh->texture = mesh->textureResource->name;
+	}
+}
 
-	glUniformMatrix4fv(modelMatrixUniformLocation, 1, GL_TRUE, translation);
+void setMeshBounds(struct Mesh *mesh, const float *min, const float *max)
+{
+	memcpy(mesh->min, min, sizeof(mesh->min));
+	memcpy(mesh->max, max, sizeof(mesh->max));
+	mesh->radius = magnitude(max[0] - min[0], max[1] - min[1], max[2] - min[2]) / 2.0f;
+}
 
-	glBindVertexArray(mesh->VAO);
-	glBindTexture(GL_TEXTURE_2D, mesh->texture);
-	glDrawArrays(GL_TRIANGLES, 0, mesh->numVertices);
+void getMeshWorldBounds(const struct Mesh *mesh, float *centre, float *extents, float *radius)
+{
+	const float position[] = {mesh->x, mesh->y, mesh->z};
+	float localCentre[3], halfExtents[3];
+	for (int i = 0; i < 3; i++) {
+		localCentre[i] = (mesh->min[i] + mesh->max[i]) / 2.0f;
+		halfExtents[i] = (mesh->max[i] - mesh->min[i]) / 2.0f;
+	}
+	*radius = mesh->radius;
+
+	// terrain chunks and most objects aren't rotated
+	if (mesh->rx == 0.0f && mesh->ry == 0.0f) {
+		for (int i = 0; i < 3; i++) {
+			centre[i] = localCentre[i] + position[i];
+			extents[i] = halfExtents[i];
+		}
+		return;
+	}
 
-	glBindVertexArray(0);
+	// as the model matrix, y rotation * x rotation
+	float rotation[16], xRotation[16];
+	loadYRotation(mesh->ry, rotation);
+	loadXRotation(mesh->rx, xRotation);
+	MatrixMatrixMul(rotation, xRotation);
+	for (int i = 0; i < 3; i++) {
+		const float *row = &rotation[i * 4];
+		centre[i] = row[0] * localCentre[0] + row[1] * localCentre[1] + row[2] * localCentre[2] + position[i];
+		extents[i] = fabsf(row[0]) * halfExtents[0] + fabsf(row[1]) * halfExtents[1] + fabsf(row[2]) * halfExtents[2];
+	}
 }
 
-struct Mesh *square(float x, float y, float z, float size, GLint positionAttribLocation,
-	GLint vertexUVAttribLocation, GLint normalAttribLocation, const char *texture)
+/* per-vertex positions, normals and texture coordinates packed into the geometry's VAO */
+static bool uploadGeometry(struct Geometry *geometry, const float *positions, const float *normals,
+	const float *textureCoordinates, uint32_t numVertices)
 {
-	struct Mesh *mesh = calloc(1, sizeof(struct Mesh));
-	if (!mesh) {
-		return NULL;
+	struct PackedVertex *vertices = malloc(numVertices * sizeof(struct PackedVertex));
+	if (!vertices) {
+		return false;
 	}
+	for (uint32_t i = 0; i < numVertices; i++) {
+		packVertex(&vertices[i], &positions[i * 3], &normals[i * 3], textureCoordinates[i * 2],
+			textureCoordinates[i * 2 + 1]);
+	}
+	geometry->numVertices = numVertices;
+	getPackedVertexBounds(vertices, numVertices, geometry->min, geometry->max, &geometry->radius);
+
+	glGenVertexArrays(1, &geometry->VAO);
+	glBindVertexArray(geometry->VAO);
+
+	glGenBuffers(1, &geometry->vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(struct PackedVertex), vertices, GL_STATIC_DRAW);
+	free(vertices);
+	setPackedVertexAttribs(geometry->positionAttribLocation, geometry->vertexUVAttribLocation,
+		geometry->normalAttribLocation);
 
-	const float a = size / 2.0f;
+	glBindVertexArray(0);
+	return true;
+}
+
+static bool buildSquare(struct Geometry *geometry)
+{
+	const float a = geometry->size / 2.0f;
 	const float positions[] = {
 		 a,  a, 0.0f,
 		-a,  a, 0.0f,
@@ -79,60 +151,12 @@ struct Mesh *square(float x, float y, float z, float size, GLint positionAttribL
 		1.0f, 1.0f
 	};
 
-	mesh->numVertices = sizeof(positions) / (3 * sizeof(float));
-	mesh->x = x; mesh->y = y; mesh->z = z;
-
-	glGenVertexArrays(1, &mesh->VAO);
-	glBindVertexArray(mesh->VAO);
-
-	glGenBuffers(1, &mesh->positionsBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->positionsBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(positions), positions, GL_STATIC_DRAW);
-	glVertexAttribPointer(positionAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(positionAttribLocation);
-
-	glGenBuffers(1, &mesh->normals);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->normals);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(normals), normals, GL_STATIC_DRAW);
-	glVertexAttribPointer(normalAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(normalAttribLocation);
-
-	glGenBuffers(1, &mesh->textureCoordinatesBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->textureCoordinatesBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(textureCoordinates), textureCoordinates, GL_STATIC_DRAW);
-	glVertexAttribPointer(vertexUVAttribLocation, 2, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(vertexUVAttribLocation);
-
-	// load a texture
-	int width, height, n;
-	unsigned char *imageData = stbi_load(texture, &width, &height, &n, 0);
-	if (!imageData) {
-		fprintf(stderr, "Error loading texture %s.\n", texture);
-		glBindVertexArray(0);
-		return mesh;
-	}
-
-	glGenTextures(1, &mesh->texture);
-	glBindTexture(GL_TEXTURE_2D, mesh->texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
-	glGenerateMipmap(GL_TEXTURE_2D);
-	free(imageData);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-	glBindVertexArray(0);
-	return mesh;
+	return uploadGeometry(geometry, positions, normals, textureCoordinates, sizeof(positions) / (3 * sizeof(float)));
 }
 
-struct Mesh *pyramid(float x, float y, float z, float size, GLint positionAttribLocation,
-	GLint vertexUVAttribLocation, GLint normalAttribLocation, const char *texture)
+static bool buildPyramid(struct Geometry *geometry)
 {
-	struct Mesh *mesh = calloc(1, sizeof(struct Mesh));
-	if (!mesh) {
-		return NULL;
-	}
-
-	const float a = size / 2.0f;
+	const float a = geometry->size / 2.0f;
 	const float positions[] = {
 		// base
 		 a, 0.0f,  a, 
@@ -142,19 +166,19 @@ struct Mesh *pyramid(float x, float y, float z, float size, GLint positionAttrib
 		-a, 0.0f, -a, 
 		 a, 0.0f, -a, 
 		// front
-		0.0f, size, 0.0f, 
+		0.0f, geometry->size, 0.0f, 
 		-a, 0.0f, a, 
 		 a, 0.0f, a, 
 		// right
-		0.0f, size, 0.0f, 
+		0.0f, geometry->size, 0.0f, 
 		a, 0.0f, a, 
 		a, 0.0f, -a, 
 		// back
-		0.0f, size, 0.0f, 
+		0.0f, geometry->size, 0.0f, 
 		 a, 0.0f, -a, 
 		-a, 0.0f, -a, 
 		// left
-		0.0f, size, 0.0f, 
+		0.0f, geometry->size, 0.0f, 
 		-a, 0.0f, -a, 
 		-a, 0.0f,  a
 	};
@@ -184,9 +208,6 @@ struct Mesh *pyramid(float x, float y, float z, float size, GLint positionAttrib
 		-0.707107f, 0.707107f, 0.0f
 	};
 
-	mesh->numVertices = sizeof(positions) / (3 * sizeof(float));
-	mesh->x = x; mesh->y = y; mesh->z = z;
-
 	const float textureCoordinates[] = {
 		1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
 		1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
@@ -197,57 +218,14 @@ struct Mesh *pyramid(float x, float y, float z, float size, GLint positionAttrib
 		0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f
 	};
 
-	glGenVertexArrays(1, &mesh->VAO);
-	glBindVertexArray(mesh->VAO);
-
-	glGenBuffers(1, &mesh->positionsBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->positionsBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(positions), positions, GL_STATIC_DRAW);
-	glVertexAttribPointer(positionAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(positionAttribLocation);
-
-	glGenBuffers(1, &mesh->normals);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->normals);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(normals), normals, GL_STATIC_DRAW);
-	glVertexAttribPointer(normalAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(normalAttribLocation);
-
-	glGenBuffers(1, &mesh->textureCoordinatesBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->textureCoordinatesBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(textureCoordinates), textureCoordinates, GL_STATIC_DRAW);
-	glVertexAttribPointer(vertexUVAttribLocation, 2, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(vertexUVAttribLocation);
-
-	// load a texture
-	int width, height, n;
-	unsigned char *imageData = stbi_load(texture, &width, &height, &n, 0);
-	if (!imageData) {
-		fprintf(stderr, "Error loading texture.\n");
-		glBindVertexArray(0);
-		return mesh;
-	}
-
-	glGenTextures(1, &mesh->texture);
-	glBindTexture(GL_TEXTURE_2D, mesh->texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-	free(imageData);
-	glBindVertexArray(0);
-	return mesh;
+	return uploadGeometry(geometry, positions, normals, textureCoordinates, sizeof(positions) / (3 * sizeof(float)));
 }
 
-struct Mesh *cube(float x, float y, float z, float size, GLint positionAttribLocation,
-	GLint vertexUVAttribLocation, GLint normalAttribLocation, const char *texture)
+static bool buildCube(struct Geometry *geometry)
 {
-	struct Mesh *mesh = calloc(1, sizeof(struct Mesh));
-	if (!mesh) {
-		return NULL;
-	}
 	// 6 faces per cube, 2 tris per face
 	// 3 vertices per tri, 4 floats per vertex
-	const float a = size / 2.0f;
+	const float a = geometry->size / 2.0f;
 	const float BB = -a; // called it BB so it's more readable below
 	const float positions[] = {
 		// right face
@@ -333,9 +311,6 @@ struct Mesh *cube(float x, float y, float z, float size, GLint positionAttribLoc
 		0.0f, 0.0f, -1.0f
 	};
 
-	mesh->numVertices = sizeof(positions) / (3 * sizeof(float));
-	mesh->x = x; mesh->y = y; mesh->z = z;
-
 	const float textureCoordinates[] = {
 		1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
 		1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
@@ -347,44 +322,86 @@ struct Mesh *cube(float x, float y, float z, float size, GLint positionAttribLoc
 		1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
 	};
 
+	return uploadGeometry(geometry, positions, normals, textureCoordinates, sizeof(positions) / (3 * sizeof(float)));
+}
+
+/* a mesh holding shared geometry and texture, see resources.h */
+static struct Mesh *primitive(enum GeometryShape shape, GeometryBuilder build, float x, float y, float z, float size,
+	GLint positionAttribLocation, GLint vertexUVAttribLocation, GLint normalAttribLocation, const char *texture)
+{
+	struct Mesh *mesh = calloc(1, sizeof(struct Mesh));
+	if (!mesh) {
+		return NULL;
+	}
+	mesh->geometry = acquireGeometry(shape, size, positionAttribLocation, vertexUVAttribLocation,
+		normalAttribLocation, build);
+	if (!mesh->geometry) {
+		free(mesh);
+		return NULL;
+	}
+	mesh->VAO = mesh->geometry->VAO;
+	mesh->numVertices = mesh->geometry->numVertices;
+	memcpy(mesh->min, mesh->geometry->min, sizeof(mesh->min));
+	memcpy(mesh->max, mesh->geometry->max, sizeof(mesh->max));
+	mesh->radius = mesh->geometry->radius;
+	mesh->x = x; mesh->y = y; mesh->z = z;
+
+	setMeshTexture(mesh, texture);
+	return mesh;
+}
+
+struct Mesh *createMesh(float x, float y, float z, const struct PackedVertex *vertices, uint32_t numVertices,
+	const void *indices, uint32_t numIndices, GLenum indexType, GLint positionAttribLocation,
+	GLint vertexUVAttribLocation, GLint normalAttribLocation, const char *texture)
+{
+	struct Mesh *mesh = calloc(1, sizeof(struct Mesh));
+	if (!mesh) {
+		return NULL;
+	}
+	mesh->numVertices = numVertices;
+	mesh->numIndices = numIndices;
+	mesh->indexType = numIndices ? indexType : 0;
+	getPackedVertexBounds(vertices, numVertices, mesh->min, mesh->max, &mesh->radius);
+	mesh->x = x; mesh->y = y; mesh->z = z;
+
 	glGenVertexArrays(1, &mesh->VAO);
 	glBindVertexArray(mesh->VAO);
 
-	glGenBuffers(1, &mesh->positionsBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->positionsBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(positions), positions, GL_STATIC_DRAW);
-	glVertexAttribPointer(positionAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(positionAttribLocation);
-
-	glGenBuffers(1, &mesh->normals);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->normals);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(normals), normals, GL_STATIC_DRAW);
-	glVertexAttribPointer(normalAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(normalAttribLocation);
-
-	glGenBuffers(1, &mesh->textureCoordinatesBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->textureCoordinatesBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(textureCoordinates), textureCoordinates, GL_STATIC_DRAW);
-	glVertexAttribPointer(vertexUVAttribLocation, 2, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(vertexUVAttribLocation);
-
-	// load a texture
-	int width, height, n;
-	unsigned char *imageData = stbi_load(texture, &width, &height, &n, 0);
-	if (!imageData) {
-		fprintf(stderr, "Error loading texture.\n");
-		glBindVertexArray(0);
-		return mesh;
-	}
+	glGenBuffers(1, &mesh->vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(struct PackedVertex), vertices, GL_STATIC_DRAW);
+	setPackedVertexAttribs(positionAttribLocation, vertexUVAttribLocation, normalAttribLocation);
 
-	glGenTextures(1, &mesh->texture);
-	glBindTexture(GL_TEXTURE_2D, mesh->texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	if (numIndices) {
+		glGenBuffers(1, &mesh->indexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * (indexType == GL_UNSIGNED_SHORT ? 2 : 4), indices,
+			GL_STATIC_DRAW);
+	}
 
-	free(imageData);
 	glBindVertexArray(0);
+
+	setMeshTexture(mesh, texture);
 	return mesh;
 }
 
+struct Mesh *square(float x, float y, float z, float size, GLint positionAttribLocation,
+	GLint vertexUVAttribLocation, GLint normalAttribLocation, const char *texture)
+{
+	return primitive(GEOMETRY_SQUARE, buildSquare, x, y, z, size, positionAttribLocation, vertexUVAttribLocation,
+		normalAttribLocation, texture);
+}
+
+struct Mesh *pyramid(float x, float y, float z, float size, GLint positionAttribLocation,
+	GLint vertexUVAttribLocation, GLint normalAttribLocation, const char *texture)
+{
+	return primitive(GEOMETRY_PYRAMID, buildPyramid, x, y, z, size, positionAttribLocation, vertexUVAttribLocation,
+		normalAttribLocation, texture);
+}
+
+struct Mesh *cube(float x, float y, float z, float size, GLint positionAttribLocation,
+	GLint vertexUVAttribLocation, GLint normalAttribLocation, const char *texture)
+{
+	return primitive(GEOMETRY_CUBE, buildCube, x, y, z, size, positionAttribLocation, vertexUVAttribLocation,
+		normalAttribLocation, texture);
+}
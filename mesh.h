@@ -3,15 +3,44 @@
 
 #include <GL/glew.h>
 
+struct Geometry;
+struct ObjectUniforms;
+struct PackedVertex;
+struct Texture;
+
 struct Mesh {
-	GLuint VAO, normals, texture, positionsBuffer, textureCoordinatesBuffer;
-	uint32_t numVertices;
+	GLuint VAO, texture;
+	GLuint vertexBuffer; /* interleaved, struct PackedVertex unless the mesh has its own format */
+	GLuint indexBuffer; /* optional, 0 for non-indexed meshes */
+	uint32_t numVertices, numIndices;
+	GLenum indexType;
+	struct Geometry *geometry; /* shared VAO and buffer of cube, pyramid and square meshes, NULL if the mesh owns its own */
+	struct Texture *textureResource; /* shared texture, NULL if the mesh owns texture */
 	float x, y, z;
 	float rx, ry;
+	float min[3], max[3]; /* bounds of the vertices */
+	float radius; /* of a sphere containing the vertices, centred between min and max */
 };
 
-void drawMesh(struct Mesh *mesh, GLint modelMatrixUniformLocation, GLint modelXRotationMatrixUniformLocation, GLint modelYRotationMatrixUniformLocation);
+/* the buffer holding the mesh's vertices, primitives keep theirs in the shared geometry */
+GLuint getMeshVertexBuffer(const struct Mesh *mesh);
+
+/* shares the texture loaded from path, leaving the mesh untextured if it can't be loaded */
+void setMeshTexture(struct Mesh *mesh, const char *texture);
+
+/* min and max of the vertices, with the radius of the sphere around the box */
+void setMeshBounds(struct Mesh *mesh, const float *min, const float *max);
 
+/* the box (centre and half extents) and sphere radius around the mesh where it is now, rotated and translated */
+void getMeshWorldBounds(const struct Mesh *mesh, float *centre, float *extents, float *radius);
+
+/* the model, x rotation and y rotation matrices for the mesh's position and rotation */
+void loadMeshObjectUniforms(const struct Mesh *mesh, struct ObjectUniforms *uniforms);
+
+/*
+ * The primitives share geometry with every other primitive of the same shape,
+ * size and attribute locations, and textures by path (see resources.h).
+ */
 struct Mesh *cube(float x, float y, float z, float size, GLint positionsAttribLocation,
 	GLint textureCoordinatesAttribLocation, GLint normalAttribLocation, const char *texture);
 
@@ -21,6 +50,15 @@ struct Mesh *pyramid(float x, float y, float z, float size, GLint positionsAttri
 struct Mesh *square(float x, float y, float z, float size, GLint positionsAttribLocation,
 	GLint textureCoordinatesAttribLocation, GLint normalAttribLocation, const char *texture);
 
+/*
+ * A mesh owning its own buffers, uploaded from vertices and, unless numIndices
+ * is 0, indices of indexType, with the texture shared by path. NULL if there's
+ * no memory.
+ */
+struct Mesh *createMesh(float x, float y, float z, const struct PackedVertex *vertices, uint32_t numVertices,
+	const void *indices, uint32_t numIndices, GLenum indexType, GLint positionAttribLocation,
+	GLint vertexUVAttribLocation, GLint normalAttribLocation, const char *texture);
+
 void CleanupMesh(struct Mesh *mesh);
 
 #endif
@@ -0,0 +1,114 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "meshFile.h"
+
+bool isMeshFile(const char *path)
+{
+	size_t len = strlen(path);
+	return len > 5 && strcmp(path + len - 5, ".mesh") == 0;
+}
+
+uint32_t getMeshFileIndexSize(uint32_t indexType)
+{
+	return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : indexType == GL_UNSIGNED_INT ? sizeof(uint32_t) : 0;
+}
+
+static uint64_t alignOffset(uint64_t offset)
+{
+	return (offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+}
+
+/* bytes of an attribute's components, 0 if glVertexAttribPointer wouldn't take them */
+static uint32_t attributeSize(const struct MeshFileAttribute *attribute)
+{
+	if (attribute->size < 1 || attribute->size > 4) {
+		return 0;
+	}
+	switch (attribute->type) {
+	case GL_BYTE: case GL_UNSIGNED_BYTE:
+		return attribute->size;
+	case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT:
+		return attribute->size * 2;
+	case GL_INT: case GL_UNSIGNED_INT: case GL_FLOAT:
+		return attribute->size * 4;
+	case GL_INT_2_10_10_10_REV: case GL_UNSIGNED_INT_2_10_10_10_REV:
+		return attribute->size == 4 ? 4 : 0;
+	default:
+		return 0;
+	}
+}
+
+/* written so offsets near the top of the range can't wrap round and pass */
+static bool validRange(uint64_t offset, uint64_t size, size_t length)
+{
+	return offset <= length && size <= length - offset;
+}
+
+bool validMeshFileHeader(const struct MeshFileHeader *h, size_t length)
+{
+	if (length < sizeof(struct MeshFileHeader) || memcmp(h->magic, MESH_FILE_MAGIC, 4) != 0 ||
+		h->version != MESH_FILE_VERSION || h->length != length || !h->numVertices || !h->vertexStride ||
+		h->numAttributes > MESH_FILE_MAX_ATTRIBUTES || (h->numIndices && !getMeshFileIndexSize(h->indexType))) {
+		return false;
+	}
+	for (uint32_t i = 0; i < h->numAttributes; i++) {
+		const struct MeshFileAttribute *attribute = &h->attributes[i];
+		const uint32_t size = attributeSize(attribute);
+		if (attribute->semantic > MESH_FILE_TEXTURE_COORDINATES || !size ||
+			attribute->offset + size > h->vertexStride) {
+			return false;
+		}
+	}
+	const uint64_t vertexBytes = (uint64_t) h->numVertices * h->vertexStride;
+	const uint64_t indexBytes = (uint64_t) h->numIndices * getMeshFileIndexSize(h->indexType);
+	return h->vertexOffset % MESH_FILE_ALIGNMENT == 0 && h->indexOffset % MESH_FILE_ALIGNMENT == 0 &&
+		validRange(h->vertexOffset, vertexBytes, length) && validRange(h->indexOffset, indexBytes, length);
+}
+
+static bool writePadding(FILE *f, uint64_t from, uint64_t to)
+{
+	bool ok = true;
+	for (uint64_t i = from; ok && i < to; i++) {
+		ok = fputc(0, f) != EOF;
+	}
+	return ok;
+}
+
+bool writeMeshFile(const char *path, const struct PackedVertex *vertices, uint32_t numVertices, const void *indices,
+	uint32_t numIndices, GLenum indexType)
+{
+	if (!numVertices || (numIndices && !getMeshFileIndexSize(indexType))) {
+		return false;
+	}
+	struct MeshFileHeader header = {
+		.magic = MESH_FILE_MAGIC, .version = MESH_FILE_VERSION, .numVertices = numVertices,
+		.numIndices = numIndices, .vertexStride = sizeof(struct PackedVertex), .indexType = numIndices ? indexType : 0,
+		.numAttributes = 3,
+		.attributes = {
+			{MESH_FILE_POSITION, GL_FLOAT, 3, GL_FALSE, offsetof(struct PackedVertex, position)},
+			{MESH_FILE_NORMAL, GL_INT_2_10_10_10_REV, 4, GL_TRUE, offsetof(struct PackedVertex, normal)},
+			{MESH_FILE_TEXTURE_COORDINATES, GL_HALF_FLOAT, 2, GL_FALSE,
+				offsetof(struct PackedVertex, textureCoordinates)}
+		}
+	};
+	getPackedVertexBounds(vertices, numVertices, header.min, header.max, &header.radius);
+	const uint64_t vertexBytes = (uint64_t) numVertices * sizeof(struct PackedVertex);
+	const uint64_t indexBytes = (uint64_t) numIndices * getMeshFileIndexSize(indexType);
+	header.vertexOffset = alignOffset(sizeof(header));
+	header.indexOffset = numIndices ? alignOffset(header.vertexOffset + vertexBytes) : 0;
+	header.length = numIndices ? header.indexOffset + indexBytes : header.vertexOffset + vertexBytes;
+
+	FILE *f = fopen(path, "wb");
+	if (!f) {
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && writePadding(f, sizeof(header), header.vertexOffset) &&
+		fwrite(vertices, vertexBytes, 1, f) == 1;
+	if (numIndices) {
+		ok = ok && writePadding(f, header.vertexOffset + vertexBytes, header.indexOffset) &&
+			fwrite(indices, indexBytes, 1, f) == 1;
+	}
+	return fclose(f) == 0 && ok;
+}
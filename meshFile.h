@@ -0,0 +1,74 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+#include "vertexFormat.h"
+
+/*
+ * Engine-native mesh file. The vertices and indices are stored exactly as they
+ * are uploaded, at aligned offsets, and the bounds are worked out when the file
+ * is written, so loading maps the file and hands the blobs straight to
+ * glBufferData without parsing or copying them. The layout describes the
+ * vertices, so files needn't use struct PackedVertex, though writeMeshFile
+ * does. Fields are in the byte order of the machine that wrote the file, so
+ * a file from a machine of the other byte order fails the version check.
+ *
+ *	header
+ *	padding up to vertexOffset
+ *	numVertices * vertexStride bytes of vertices
+ *	padding up to indexOffset
+ *	numIndices indices of indexType, if there are any
+ */
+#define MESH_FILE_MAGIC "MESH"
+#define MESH_FILE_VERSION 1
+#define MESH_FILE_ALIGNMENT 64 /* of the vertices and indices */
+#define MESH_FILE_MAX_ATTRIBUTES 8
+
+enum MeshFileSemantic {
+	MESH_FILE_POSITION,
+	MESH_FILE_NORMAL,
+	MESH_FILE_TEXTURE_COORDINATES
+};
+
+/* the arguments to glVertexAttribPointer for one attribute */
+struct MeshFileAttribute {
+	uint32_t semantic; /* enum MeshFileSemantic */
+	uint32_t type; /* GL_FLOAT, GL_HALF_FLOAT, GL_INT_2_10_10_10_REV, ... */
+	uint8_t size; /* components */
+	uint8_t normalized;
+	uint16_t offset; /* in the vertex */
+};
+
+struct MeshFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t numVertices, numIndices; /* numIndices is 0 for non-indexed meshes */
+	uint32_t vertexStride;
+	uint32_t indexType; /* GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, 0 without indices */
+	float min[3], max[3];
+	float radius; /* of a sphere containing the vertices, centred between min and max */
+	uint32_t numAttributes;
+	struct MeshFileAttribute attributes[MESH_FILE_MAX_ATTRIBUTES];
+	uint64_t vertexOffset, indexOffset;
+	uint64_t length; /* of the whole file, so truncated files are caught */
+};
+
+/* true if a file of length bytes starting with h is a mesh file whose blobs all lie inside it */
+bool validMeshFileHeader(const struct MeshFileHeader *h, size_t length);
+
+/* bytes per index of indexType, 0 unless it's GL_UNSIGNED_SHORT or GL_UNSIGNED_INT */
+uint32_t getMeshFileIndexSize(uint32_t indexType);
+
+/* writes vertices and, unless numIndices is 0, indices of indexType as a mesh file */
+bool writeMeshFile(const char *path, const struct PackedVertex *vertices, uint32_t numVertices, const void *indices,
+	uint32_t numIndices, GLenum indexType);
+
+/* true if path names a native mesh file, by extension */
+bool isMeshFile(const char *path);
+
+#endif
@@ -0,0 +1,112 @@
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "meshInstances.h"
+#include "vertexFormat.h"
+
+struct MeshInstances *createMeshInstances(struct Mesh *mesh, GLuint program)
+{
+	struct MeshInstances *instances = calloc(1, sizeof(struct MeshInstances));
+	if (!instances) {
+		return NULL;
+	}
+	instances->mesh = mesh;
+
+	glGenVertexArrays(1, &instances->VAO);
+	glBindVertexArray(instances->VAO);
+
+	glBindBuffer(GL_ARRAY_BUFFER, getMeshVertexBuffer(mesh));
+	setPackedVertexAttribs(glGetAttribLocation(program, "position"), glGetAttribLocation(program, "vertexUV"),
+		glGetAttribLocation(program, "normal"));
+	if (mesh->indexBuffer) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
+	}
+
+	glGenBuffers(1, &instances->instanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, instances->instanceBuffer);
+	setMeshInstanceAttribs(program);
+
+	glBindVertexArray(0);
+	return instances;
+}
+
+void setMeshInstanceAttribs(GLuint program)
+{
+	const GLint instancePositionAttribLocation = glGetAttribLocation(program, "instancePosition");
+	const GLint instanceRotationAttribLocation = glGetAttribLocation(program, "instanceRotation");
+	glVertexAttribPointer(instancePositionAttribLocation, 3, GL_FLOAT, GL_FALSE, sizeof(struct MeshInstance),
+		(void *) offsetof(struct MeshInstance, x));
+	glEnableVertexAttribArray(instancePositionAttribLocation);
+	glVertexAttribDivisor(instancePositionAttribLocation, 1);
+	glVertexAttribPointer(instanceRotationAttribLocation, 2, GL_FLOAT, GL_FALSE, sizeof(struct MeshInstance),
+		(void *) offsetof(struct MeshInstance, rx));
+	glEnableVertexAttribArray(instanceRotationAttribLocation);
+	glVertexAttribDivisor(instanceRotationAttribLocation, 1);
+}
+
+uint32_t addMeshInstance(struct MeshInstances *instances, float x, float y, float z, float rx, float ry)
+{
+	if (instances->numInstances == instances->capacity) {
+		const uint32_t capacity = instances->capacity ? instances->capacity * 2 : 16;
+		struct MeshInstance *grown = realloc(instances->instances, capacity * sizeof(struct MeshInstance));
+		if (!grown) {
+			return UINT32_MAX;
+		}
+		instances->instances = grown;
+		instances->capacity = capacity;
+	}
+	const struct MeshInstance instance = {.x = x, .y = y, .z = z, .rx = rx, .ry = ry};
+	instances->instances[instances->numInstances] = instance;
+	instances->dirty = true;
+	return instances->numInstances++;
+}
+
+struct MeshInstance *getMeshInstance(struct MeshInstances *instances, uint32_t index)
+{
+	// assume the caller is about to change it
+	instances->dirty = true;
+	return &instances->instances[index];
+}
+
+void removeMeshInstance(struct MeshInstances *instances, uint32_t index)
+{
+	// the last instance takes its place
+	instances->instances[index] = instances->instances[--instances->numInstances];
+	instances->dirty = true;
+}
+
+void updateMeshInstances(struct MeshInstances *instances)
+{
+	if (instances->dirty && instances->numInstances) {
+		glBindBuffer(GL_ARRAY_BUFFER, instances->instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, instances->numInstances * sizeof(struct MeshInstance), instances->instances,
+			GL_DYNAMIC_DRAW);
+		instances->dirty = false;
+	}
+}
+
+void drawMeshInstances(struct MeshInstances *instances)
+{
+	if (!instances->numInstances) {
+		return;
+	}
+	updateMeshInstances(instances);
+
+	const struct Mesh *mesh = instances->mesh;
+	glBindVertexArray(instances->VAO);
+	glBindTexture(GL_TEXTURE_2D, mesh->texture);
+	if (mesh->indexBuffer) {
+		glDrawElementsInstanced(GL_TRIANGLES, mesh->numIndices, mesh->indexType, NULL, instances->numInstances);
+	} else {
+		glDrawArraysInstanced(GL_TRIANGLES, 0, mesh->numVertices, instances->numInstances);
+	}
+	glBindVertexArray(0);
+}
+
+void cleanupMeshInstances(struct MeshInstances *instances)
+{
+	glDeleteVertexArrays(1, &instances->VAO);
+	glDeleteBuffers(1, &instances->instanceBuffer);
+	free(instances->instances);
+	free(instances);
+}
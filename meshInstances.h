@@ -0,0 +1,57 @@
+#ifndef MESH_INSTANCES_H
+#define MESH_INSTANCES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+#include "mesh.h"
+
+/* where one copy of the mesh is drawn, as struct Mesh's x, y, z, rx and ry */
+struct MeshInstance {
+	float x, y, z;
+	float rx, ry;
+};
+
+/*
+ * Many copies of one mesh drawn with a single instanced call. The transforms
+ * live in a buffer and instancedLighting.vert builds each model matrix from
+ * them, rather than drawMesh working out and uploading three matrices per
+ * object. The mesh must use struct PackedVertex vertices, as the primitives
+ * and terrain chunks do, and outlive its instances.
+ */
+struct MeshInstances {
+	struct Mesh *mesh;
+	GLuint VAO; /* the mesh's vertices and indices plus the instance buffer */
+	GLuint instanceBuffer;
+	struct MeshInstance *instances;
+	uint32_t numInstances, capacity;
+	bool dirty; /* instances changed since they were last uploaded */
+};
+
+/* instances of mesh to be drawn with program (built from instancedLighting.vert), none to begin with */
+struct MeshInstances *createMeshInstances(struct Mesh *mesh, GLuint program);
+
+/* points the VAO being built at the bound GL_ARRAY_BUFFER of struct MeshInstance, one per instance */
+void setMeshInstanceAttribs(GLuint program);
+
+/* returns the new instance's index, or UINT32_MAX if there's no memory for it */
+uint32_t addMeshInstance(struct MeshInstances *instances, float x, float y, float z, float rx, float ry);
+
+/* pointer to an instance to move it, valid until the next add */
+struct MeshInstance *getMeshInstance(struct MeshInstances *instances, uint32_t index);
+
+/* the last instance takes the removed one's index */
+void removeMeshInstance(struct MeshInstances *instances, uint32_t index);
+
+/* uploads the instances if they changed since the last upload */
+void updateMeshInstances(struct MeshInstances *instances);
+
+/* uploads the instances if they changed and draws them all in one call, program must be in use */
+void drawMeshInstances(struct MeshInstances *instances);
+
+/* the mesh itself isn't freed */
+void cleanupMeshInstances(struct MeshInstances *instances);
+
+#endif
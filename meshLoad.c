@@ -0,0 +1,100 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file.h"
+#include "meshFile.h"
+#include "meshLoad.h"
+#include "objImport.h"
+
+static void setAttribs(const struct MeshFileHeader *header, const GLint *locations)
+{
+	for (uint32_t i = 0; i < header->numAttributes; i++) {
+		const struct MeshFileAttribute *attribute = &header->attributes[i];
+		if (locations[attribute->semantic] < 0) {
+			continue;
+		}
+		glVertexAttribPointer(locations[attribute->semantic], attribute->size, attribute->type, attribute->normalized,
+			header->vertexStride, (void *) (uintptr_t) attribute->offset);
+		glEnableVertexAttribArray(locations[attribute->semantic]);
+	}
+}
+
+struct Mesh *loadMeshFile(const char *path, float x, float y, float z, GLint positionAttribLocation,
+	GLint vertexUVAttribLocation, GLint normalAttribLocation, const char *texture)
+{
+	struct MappedFile file;
+	if (!mapFile(path, false, &file)) {
+		fprintf(stderr, "Error opening mesh file %s.\n", path);
+		return NULL;
+	}
+	const struct MeshFileHeader *header = file.base;
+	if (!validMeshFileHeader(header, file.length)) {
+		fprintf(stderr, "%s is not a valid mesh file.\n", path);
+		unmapFile(&file);
+		return NULL;
+	}
+
+	struct Mesh *mesh = calloc(1, sizeof(struct Mesh));
+	if (!mesh) {
+		unmapFile(&file);
+		return NULL;
+	}
+	mesh->numVertices = header->numVertices;
+	mesh->numIndices = header->numIndices;
+	mesh->indexType = header->indexType;
+	memcpy(mesh->min, header->min, sizeof(mesh->min));
+	memcpy(mesh->max, header->max, sizeof(mesh->max));
+	mesh->radius = header->radius;
+	mesh->x = x; mesh->y = y; mesh->z = z;
+
+	glGenVertexArrays(1, &mesh->VAO);
+	glBindVertexArray(mesh->VAO);
+
+	// from the page cache to the driver, nothing here reads or copies the blobs
+	glGenBuffers(1, &mesh->vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) header->numVertices * header->vertexStride,
+		(const char *) file.base + header->vertexOffset, GL_STATIC_DRAW);
+	const GLint locations[] = {
+		[MESH_FILE_POSITION] = positionAttribLocation,
+		[MESH_FILE_NORMAL] = normalAttribLocation,
+		[MESH_FILE_TEXTURE_COORDINATES] = vertexUVAttribLocation
+	};
+	setAttribs(header, locations);
+
+	if (header->numIndices) {
+		glGenBuffers(1, &mesh->indexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
+		const GLsizeiptr indexBytes = (GLsizeiptr) header->numIndices * getMeshFileIndexSize(header->indexType);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, (const char *) file.base + header->indexOffset,
+			GL_STATIC_DRAW);
+	}
+
+	glBindVertexArray(0);
+	unmapFile(&file);
+
+	setMeshTexture(mesh, texture);
+	return mesh;
+}
+
+struct Mesh *loadObjMesh(const char *path, float x, float y, float z, GLint positionAttribLocation,
+	GLint vertexUVAttribLocation, GLint normalAttribLocation, const char *texture)
+{
+	struct ObjModel model;
+	if (!importObj(path, &model)) {
+		return NULL;
+	}
+	if (!model.numIndices) {
+		fprintf(stderr, "%s has no triangles.\n", path);
+		freeObjModel(&model);
+		return NULL;
+	}
+	const void *indices;
+	const GLenum indexType = narrowObjIndices(&model, &indices);
+	struct Mesh *mesh = createMesh(x, y, z, model.vertices, model.numVertices, indices, model.numIndices,
+		indexType, positionAttribLocation, vertexUVAttribLocation, normalAttribLocation, texture);
+	freeObjModel(&model);
+	return mesh;
+}
@@ -0,0 +1,25 @@
+#ifndef MESH_LOAD_H
+#define MESH_LOAD_H
+
+#include <GL/glew.h>
+
+#include "mesh.h"
+
+/*
+ * Model files uploaded as meshes. Kept apart from meshFile.c and objImport.c,
+ * which make no GL calls, so the tools can build without GL.
+ */
+
+/*
+ * A mesh at (x, y, z) uploaded from the mesh file at path, which is mapped
+ * only while it's uploaded. Attributes the program doesn't have (location -1)
+ * are left out. NULL if the file can't be opened or isn't valid.
+ */
+struct Mesh *loadMeshFile(const char *path, float x, float y, float z, GLint positionAttribLocation,
+	GLint vertexUVAttribLocation, GLint normalAttribLocation, const char *texture);
+
+/* importObj uploaded as a mesh at (x, y, z), with 16 bit indices if they fit. NULL on failure */
+struct Mesh *loadObjMesh(const char *path, float x, float y, float z, GLint positionAttribLocation,
+	GLint vertexUVAttribLocation, GLint normalAttribLocation, const char *texture);
+
+#endif
@@ -0,0 +1,209 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "meshOptimize.h"
+
+/* Forsyth's scoring, the constants from his article */
+#define CACHE_DECAY_POWER 1.5f
+#define LAST_TRIANGLE_SCORE 0.75f
+#define VALENCE_BOOST_SCALE 2.0f
+#define VALENCE_BOOST_POWER 0.5f
+
+static float vertexScore(int32_t cachePosition, uint32_t activeTriangles)
+{
+	if (!activeTriangles) {
+		return -1.0f;
+	}
+	float score = 0.0f;
+	if (cachePosition >= 0 && cachePosition < 3) {
+		// the last triangle's vertices, scored lower so the next triangle isn't just its neighbour every time
+		score = LAST_TRIANGLE_SCORE;
+	} else if (cachePosition >= 3) {
+		score = powf(1.0f - (float) (cachePosition - 3) / (VERTEX_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+	}
+	// vertices with few triangles left are finished off before they're evicted
+	return score + VALENCE_BOOST_SCALE * powf((float) activeTriangles, -VALENCE_BOOST_POWER);
+}
+
+struct CacheOptimizer {
+	uint32_t *activeCounts; /* triangles not yet drawn using each vertex */
+	uint32_t *offsets; /* of each vertex's triangles in adjacency, the drawn ones moved past activeCounts */
+	uint32_t *adjacency;
+	int32_t *cachePositions; /* -1 if not in the cache */
+	float *vertexScores, *triangleScores;
+	uint8_t *drawn;
+};
+
+static void freeCacheOptimizer(struct CacheOptimizer *o)
+{
+	free(o->activeCounts); free(o->offsets); free(o->adjacency); free(o->cachePositions);
+	free(o->vertexScores); free(o->triangleScores); free(o->drawn);
+}
+
+static bool buildAdjacency(struct CacheOptimizer *o, const uint32_t *indices, uint32_t numIndices,
+	uint32_t numVertices)
+{
+	o->activeCounts = calloc(numVertices, sizeof(uint32_t));
+	o->offsets = malloc(numVertices * sizeof(uint32_t));
+	o->adjacency = malloc(numIndices * sizeof(uint32_t));
+	o->cachePositions = malloc(numVertices * sizeof(int32_t));
+	o->vertexScores = malloc(numVertices * sizeof(float));
+	o->triangleScores = malloc(numIndices / 3 * sizeof(float));
+	o->drawn = calloc(numIndices / 3, 1);
+	if (!o->activeCounts || !o->offsets || !o->adjacency || !o->cachePositions || !o->vertexScores ||
+		!o->triangleScores || !o->drawn) {
+		freeCacheOptimizer(o);
+		return false;
+	}
+
+	for (uint32_t i = 0; i < numIndices; i++) {
+		o->activeCounts[indices[i]]++;
+	}
+	uint32_t offset = 0;
+	for (uint32_t v = 0; v < numVertices; v++) {
+		o->offsets[v] = offset;
+		offset += o->activeCounts[v];
+		o->activeCounts[v] = 0;
+	}
+	// counted again as the triangles are filled in
+	for (uint32_t i = 0; i < numIndices; i++) {
+		const uint32_t v = indices[i];
+		o->adjacency[o->offsets[v] + o->activeCounts[v]++] = i / 3;
+	}
+
+	for (uint32_t v = 0; v < numVertices; v++) {
+		o->cachePositions[v] = -1;
+		o->vertexScores[v] = vertexScore(-1, o->activeCounts[v]);
+	}
+	for (uint32_t t = 0; t < numIndices / 3; t++) {
+		const uint32_t *triangle = &indices[t * 3];
+		o->triangleScores[t] = o->vertexScores[triangle[0]] + o->vertexScores[triangle[1]] +
+			o->vertexScores[triangle[2]];
+	}
+	return true;
+}
+
+/* takes triangle off the vertex's list of triangles still to draw */
+static void removeActiveTriangle(struct CacheOptimizer *o, uint32_t vertex, uint32_t triangle)
+{
+	uint32_t *triangles = &o->adjacency[o->offsets[vertex]];
+	uint32_t last = --o->activeCounts[vertex];
+	for (uint32_t i = 0; i <= last; i++) {
+		if (triangles[i] == triangle) {
+			triangles[i] = triangles[last];
+			triangles[last] = triangle;
+			return;
+		}
+	}
+}
+
+bool optimizeVertexCache(uint32_t *indices, uint32_t numIndices, uint32_t numVertices)
+{
+	const uint32_t numTriangles = numIndices / 3;
+	if (!numTriangles) {
+		return true;
+	}
+	struct CacheOptimizer o;
+	uint32_t *output = malloc(numIndices * sizeof(uint32_t));
+	if (!output || !buildAdjacency(&o, indices, numIndices, numVertices)) {
+		free(output);
+		return false;
+	}
+
+	// most recently used first, with room for a triangle's vertices pushing others out
+	uint32_t cache[VERTEX_CACHE_SIZE + 3], numCached = 0;
+	uint32_t best = 0, nextUndrawn = 0;
+	for (uint32_t t = 1; t < numTriangles; t++) {
+		if (o.triangleScores[t] > o.triangleScores[best]) {
+			best = t;
+		}
+	}
+
+	for (uint32_t n = 0; n < numTriangles; n++) {
+		if (best == UINT32_MAX) {
+			// nothing left touches the cache, so start again at the first triangle not yet drawn
+			while (o.drawn[nextUndrawn]) {
+				nextUndrawn++;
+			}
+			best = nextUndrawn;
+		}
+		const uint32_t *triangle = &indices[best * 3];
+		memcpy(&output[n * 3], triangle, 3 * sizeof(uint32_t));
+		o.drawn[best] = 1;
+
+		uint32_t newCache[VERTEX_CACHE_SIZE + 3], numNew = 0;
+		for (int i = 0; i < 3; i++) {
+			removeActiveTriangle(&o, triangle[i], best);
+			// degenerate triangles repeat a vertex
+			if (!i || (triangle[i] != triangle[0] && triangle[i] != triangle[i - 1])) {
+				newCache[numNew++] = triangle[i];
+			}
+		}
+		for (uint32_t i = 0; i < numCached; i++) {
+			const uint32_t v = cache[i];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+				newCache[numNew++] = v;
+			}
+		}
+
+		// anything pushed past the end has left the cache, but its score still changes
+		for (uint32_t i = 0; i < numNew; i++) {
+			const uint32_t v = newCache[i];
+			o.cachePositions[v] = i < VERTEX_CACHE_SIZE ? (int32_t) i : -1;
+			o.vertexScores[v] = vertexScore(o.cachePositions[v], o.activeCounts[v]);
+		}
+		best = UINT32_MAX;
+		float bestScore = -1.0f;
+		for (uint32_t i = 0; i < numNew; i++) {
+			const uint32_t v = newCache[i];
+			for (uint32_t j = 0; j < o.activeCounts[v]; j++) {
+				const uint32_t t = o.adjacency[o.offsets[v] + j];
+				const uint32_t *vertices = &indices[t * 3];
+				o.triangleScores[t] = o.vertexScores[vertices[0]] + o.vertexScores[vertices[1]] +
+					o.vertexScores[vertices[2]];
+				if (o.triangleScores[t] > bestScore) {
+					bestScore = o.triangleScores[t];
+					best = t;
+				}
+			}
+		}
+
+		numCached = numNew < VERTEX_CACHE_SIZE ? numNew : VERTEX_CACHE_SIZE;
+		memcpy(cache, newCache, numCached * sizeof(uint32_t));
+	}
+
+	memcpy(indices, output, numTriangles * 3 * sizeof(uint32_t));
+	free(output);
+	freeCacheOptimizer(&o);
+	return true;
+}
+
+bool optimizeVertexFetch(void *vertices, size_t vertexSize, uint32_t *numVertices, uint32_t *indices,
+	uint32_t numIndices)
+{
+	uint32_t *remap = malloc(*numVertices * sizeof(uint32_t));
+	uint8_t *reordered = malloc(*numVertices * vertexSize);
+	if (!remap || !reordered) {
+		free(remap);
+		free(reordered);
+		return false;
+	}
+	memset(remap, 0xff, *numVertices * sizeof(uint32_t));
+
+	uint32_t numUsed = 0;
+	for (uint32_t i = 0; i < numIndices; i++) {
+		uint32_t *newIndex = &remap[indices[i]];
+		if (*newIndex == UINT32_MAX) {
+			*newIndex = numUsed++;
+			memcpy(reordered + (size_t) *newIndex * vertexSize, (uint8_t *) vertices + (size_t) indices[i] * vertexSize,
+				vertexSize);
+		}
+		indices[i] = *newIndex;
+	}
+	memcpy(vertices, reordered, (size_t) numUsed * vertexSize);
+	*numVertices = numUsed;
+	free(remap);
+	free(reordered);
+	return true;
+}
@@ -0,0 +1,29 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* entries in the post-transform vertex cache optimizeVertexCache orders triangles for */
+#define VERTEX_CACHE_SIZE 32
+
+/*
+ * Reorders the triangles so vertices are reused while they're still in the
+ * GPU's post-transform cache, with Tom Forsyth's linear-speed vertex cache
+ * optimisation: each step draws the best scoring triangle using recently used
+ * vertices, favouring vertices with few triangles left so none are stranded.
+ * false if there's no memory, leaving indices as they were.
+ */
+bool optimizeVertexCache(uint32_t *indices, uint32_t numIndices, uint32_t numVertices);
+
+/*
+ * Renumbers the vertices in the order the indices first use them, so vertex
+ * fetch reads forwards through memory, dropping any that aren't used.
+ * vertices are vertexSize bytes each. false if there's no memory, leaving
+ * both as they were.
+ */
+bool optimizeVertexFetch(void *vertices, size_t vertexSize, uint32_t *numVertices, uint32_t *indices,
+	uint32_t numIndices);
+
+#endif
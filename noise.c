@@ -0,0 +1,463 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define NOISE_SSE2 1
+#include <immintrin.h>
+#endif
+
+#include "noise.h"
+#include "parallel.h"
+
+/*
+ * The vector and scalar versions perform the same float operations in the same
+ * order so they give the same bits, which keeps worlds identical whichever
+ * path generated them, as long as multiplies and adds aren't fused (see
+ * CFLAGS in the Makefile).
+ */
+
+/* octave gradients, unit length so gradient noise stays within [-sqrt(1/2), sqrt(1/2)] */
+static const float gradients[8][2] = {
+	{1.0f, 0.0f}, {-1.0f, 0.0f}, {0.0f, 1.0f}, {0.0f, -1.0f},
+	{0.70710678f, 0.70710678f}, {-0.70710678f, 0.70710678f}, {0.70710678f, -0.70710678f}, {-0.70710678f, -0.70710678f}
+};
+#define GRADIENT_NOISE_SCALE 1.41421356f
+
+/* small self-contained generator (splitmix32) so the seed means the same thing everywhere */
+static uint32_t nextRandom(uint32_t *state)
+{
+	uint32_t z = (*state += 0x9e3779b9u);
+	z = (z ^ (z >> 16)) * 0x85ebca6bu;
+	z = (z ^ (z >> 13)) * 0xc2b2ae35u;
+	return z ^ (z >> 16);
+}
+
+void initNoise(struct Noise *noise, unsigned int seed)
+{
+	uint32_t state = seed;
+	for (uint32_t i = 0; i < 256; i++) {
+		noise->permutation[i] = (uint8_t) i;
+	}
+	for (uint32_t i = 255; i > 0; i--) {
+		uint32_t j = nextRandom(&state) % (i + 1);
+		uint8_t tmp = noise->permutation[i];
+		noise->permutation[i] = noise->permutation[j];
+		noise->permutation[j] = tmp;
+	}
+	for (uint32_t i = 0; i < 256; i++) {
+		noise->permutation[i + 256] = noise->permutation[i];
+	}
+	memset(&noise->permutation[512], 0, sizeof(noise->permutation) - 512);
+	// octaves are shifted apart so they don't all line up at the origin
+	for (uint32_t i = 0; i < NOISE_MAX_OCTAVES + 2; i++) {
+		noise->offsets[i][0] = (float) (nextRandom(&state) & 0xffff) / 256.0f;
+		noise->offsets[i][1] = (float) (nextRandom(&state) & 0xffff) / 256.0f;
+	}
+}
+
+struct NoiseParams getDefaultNoiseParams(void)
+{
+	return (struct NoiseParams) {
+		.basis = NOISE_GRADIENT, .fractal = NOISE_FBM, .octaves = 7, .frequency = 1.0f / 128.0f,
+		.lacunarity = 2.0f, .gain = 0.5f, .warp = 0.4f, .height = 16.0f
+	};
+}
+
+static uint32_t clampOctaves(uint32_t octaves)
+{
+	return octaves < NOISE_MAX_OCTAVES ? octaves : NOISE_MAX_OCTAVES;
+}
+
+static uint32_t hashLattice(const struct Noise *noise, int32_t x, int32_t z)
+{
+	return noise->permutation[noise->permutation[x & 255] + (z & 255)];
+}
+
+/* floor by truncation, written out so it matches the vector version for every input */
+static int32_t floorToInt(float x)
+{
+	int32_t i = (int32_t) x;
+	return (float) i > x ? i - 1 : i;
+}
+
+static float fade(float t)
+{
+	return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+float noise2D(const struct Noise *noise, enum NoiseBasis basis, float x, float z)
+{
+	const int32_t ix = floorToInt(x), iz = floorToInt(z);
+	const float fx = x - (float) ix, fz = z - (float) iz;
+	const uint32_t h00 = hashLattice(noise, ix, iz), h10 = hashLattice(noise, ix + 1, iz);
+	const uint32_t h01 = hashLattice(noise, ix, iz + 1), h11 = hashLattice(noise, ix + 1, iz + 1);
+
+	float v00, v10, v01, v11;
+	if (basis == NOISE_VALUE) {
+		v00 = (float) h00 * (2.0f / 255.0f) - 1.0f;
+		v10 = (float) h10 * (2.0f / 255.0f) - 1.0f;
+		v01 = (float) h01 * (2.0f / 255.0f) - 1.0f;
+		v11 = (float) h11 * (2.0f / 255.0f) - 1.0f;
+	} else {
+		const float fx1 = fx - 1.0f, fz1 = fz - 1.0f;
+		v00 = gradients[h00 & 7][0] * fx + gradients[h00 & 7][1] * fz;
+		v10 = gradients[h10 & 7][0] * fx1 + gradients[h10 & 7][1] * fz;
+		v01 = gradients[h01 & 7][0] * fx + gradients[h01 & 7][1] * fz1;
+		v11 = gradients[h11 & 7][0] * fx1 + gradients[h11 & 7][1] * fz1;
+	}
+
+	const float u = fade(fx), w = fade(fz);
+	const float a = v00 + (v10 - v00) * u, b = v01 + (v11 - v01) * u;
+	const float r = a + (b - a) * w;
+	return basis == NOISE_VALUE ? r : r * GRADIENT_NOISE_SCALE;
+}
+
+/* sum of octaves normalised back to [-1, 1], x and z in first-octave lattice cells */
+static float fbm(const struct Noise *noise, const struct NoiseParams *params, uint32_t octaves, float x, float z)
+{
+	float sum = 0.0f, amplitude = 1.0f, total = 0.0f;
+	for (uint32_t i = 0; i < clampOctaves(octaves); i++) {
+		sum += noise2D(noise, params->basis, x + noise->offsets[i][0], z + noise->offsets[i][1]) * amplitude;
+		total += amplitude;
+		amplitude *= params->gain;
+		x *= params->lacunarity;
+		z *= params->lacunarity;
+	}
+	return sum / total;
+}
+
+/* each octave is folded into a ridge and weighted by the one before, so detail gathers on the crests */
+static float ridged(const struct Noise *noise, const struct NoiseParams *params, float x, float z)
+{
+	float sum = 0.0f, amplitude = 1.0f, total = 0.0f, weight = 1.0f;
+	for (uint32_t i = 0; i < clampOctaves(params->octaves); i++) {
+		float n = 1.0f - fabsf(noise2D(noise, params->basis, x + noise->offsets[i][0], z + noise->offsets[i][1]));
+		n = n * n * weight;
+		weight = fminf(n * 2.0f, 1.0f);
+		sum += n * amplitude;
+		total += amplitude;
+		amplitude *= params->gain;
+		x *= params->lacunarity;
+		z *= params->lacunarity;
+	}
+	return sum / total * 2.0f - 1.0f;
+}
+
+float fractalNoise2D(const struct Noise *noise, const struct NoiseParams *params, float x, float z)
+{
+	x = x * params->frequency;
+	z = z * params->frequency;
+	if (params->warp != 0.0f) {
+		const float (*offsets)[2] = &noise->offsets[NOISE_MAX_OCTAVES];
+		float wx = fbm(noise, params, NOISE_WARP_OCTAVES, x + offsets[0][0], z + offsets[0][1]);
+		float wz = fbm(noise, params, NOISE_WARP_OCTAVES, x + offsets[1][0], z + offsets[1][1]);
+		x = x + wx * params->warp;
+		z = z + wz * params->warp;
+	}
+	float n = params->fractal == NOISE_RIDGED ? ridged(noise, params, x, z) :
+		fbm(noise, params, params->octaves, x, z);
+	return n * params->height;
+}
+
+#ifdef NOISE_SSE2
+static __m128 fade4(__m128 t)
+{
+	const __m128 t3 = _mm_mul_ps(_mm_mul_ps(t, t), t);
+	const __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))),
+		_mm_set1_ps(10.0f));
+	return _mm_mul_ps(t3, inner);
+}
+
+static __m128 noise2D4(const struct Noise *noise, enum NoiseBasis basis, __m128 x, __m128 z)
+{
+	__m128i ix = _mm_cvttps_epi32(x), iz = _mm_cvttps_epi32(z);
+	ix = _mm_add_epi32(ix, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(ix), x)));
+	iz = _mm_add_epi32(iz, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(iz), z)));
+	const __m128 fx = _mm_sub_ps(x, _mm_cvtepi32_ps(ix)), fz = _mm_sub_ps(z, _mm_cvtepi32_ps(iz));
+
+	// no gathers in SSE2, the lattice hashes are looked up a lane at a time
+	int32_t lx[4], lz[4];
+	_mm_storeu_si128((__m128i *) lx, ix);
+	_mm_storeu_si128((__m128i *) lz, iz);
+	uint32_t h[4][4];
+	for (int j = 0; j < 4; j++) {
+		h[0][j] = hashLattice(noise, lx[j], lz[j]);
+		h[1][j] = hashLattice(noise, lx[j] + 1, lz[j]);
+		h[2][j] = hashLattice(noise, lx[j], lz[j] + 1);
+		h[3][j] = hashLattice(noise, lx[j] + 1, lz[j] + 1);
+	}
+
+	__m128 v00, v10, v01, v11;
+	if (basis == NOISE_VALUE) {
+		const __m128 valueScale = _mm_set1_ps(2.0f / 255.0f), one = _mm_set1_ps(1.0f);
+		__m128 v[4];
+		for (int c = 0; c < 4; c++) {
+			__m128i hc = _mm_setr_epi32((int32_t) h[c][0], (int32_t) h[c][1], (int32_t) h[c][2], (int32_t) h[c][3]);
+			v[c] = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(hc), valueScale), one);
+		}
+		v00 = v[0]; v10 = v[1]; v01 = v[2]; v11 = v[3];
+	} else {
+		float gx[4][4], gz[4][4];
+		for (int c = 0; c < 4; c++) {
+			for (int j = 0; j < 4; j++) {
+				gx[c][j] = gradients[h[c][j] & 7][0];
+				gz[c][j] = gradients[h[c][j] & 7][1];
+			}
+		}
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 fx1 = _mm_sub_ps(fx, one), fz1 = _mm_sub_ps(fz, one);
+		v00 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(gx[0]), fx), _mm_mul_ps(_mm_loadu_ps(gz[0]), fz));
+		v10 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(gx[1]), fx1), _mm_mul_ps(_mm_loadu_ps(gz[1]), fz));
+		v01 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(gx[2]), fx), _mm_mul_ps(_mm_loadu_ps(gz[2]), fz1));
+		v11 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(gx[3]), fx1), _mm_mul_ps(_mm_loadu_ps(gz[3]), fz1));
+	}
+
+	const __m128 u = fade4(fx), w = fade4(fz);
+	const __m128 a = _mm_add_ps(v00, _mm_mul_ps(_mm_sub_ps(v10, v00), u));
+	const __m128 b = _mm_add_ps(v01, _mm_mul_ps(_mm_sub_ps(v11, v01), u));
+	const __m128 r = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), w));
+	return basis == NOISE_VALUE ? r : _mm_mul_ps(r, _mm_set1_ps(GRADIENT_NOISE_SCALE));
+}
+
+static __m128 fbm4(const struct Noise *noise, const struct NoiseParams *params, uint32_t octaves, __m128 x, __m128 z)
+{
+	const __m128 lacunarity = _mm_set1_ps(params->lacunarity);
+	__m128 sum = _mm_setzero_ps();
+	float amplitude = 1.0f, total = 0.0f;
+	for (uint32_t i = 0; i < clampOctaves(octaves); i++) {
+		__m128 n = noise2D4(noise, params->basis, _mm_add_ps(x, _mm_set1_ps(noise->offsets[i][0])),
+			_mm_add_ps(z, _mm_set1_ps(noise->offsets[i][1])));
+		sum = _mm_add_ps(sum, _mm_mul_ps(n, _mm_set1_ps(amplitude)));
+		total += amplitude;
+		amplitude *= params->gain;
+		x = _mm_mul_ps(x, lacunarity);
+		z = _mm_mul_ps(z, lacunarity);
+	}
+	return _mm_div_ps(sum, _mm_set1_ps(total));
+}
+
+static __m128 ridged4(const struct Noise *noise, const struct NoiseParams *params, __m128 x, __m128 z)
+{
+	const __m128 lacunarity = _mm_set1_ps(params->lacunarity), one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 sum = _mm_setzero_ps(), weight = one;
+	float amplitude = 1.0f, total = 0.0f;
+	for (uint32_t i = 0; i < clampOctaves(params->octaves); i++) {
+		__m128 n = noise2D4(noise, params->basis, _mm_add_ps(x, _mm_set1_ps(noise->offsets[i][0])),
+			_mm_add_ps(z, _mm_set1_ps(noise->offsets[i][1])));
+		n = _mm_sub_ps(one, _mm_and_ps(n, absMask));
+		n = _mm_mul_ps(_mm_mul_ps(n, n), weight);
+		weight = _mm_min_ps(_mm_mul_ps(n, two), one);
+		sum = _mm_add_ps(sum, _mm_mul_ps(n, _mm_set1_ps(amplitude)));
+		total += amplitude;
+		amplitude *= params->gain;
+		x = _mm_mul_ps(x, lacunarity);
+		z = _mm_mul_ps(z, lacunarity);
+	}
+	return _mm_sub_ps(_mm_mul_ps(_mm_div_ps(sum, _mm_set1_ps(total)), two), one);
+}
+
+static __m128 fractalNoise2D4(const struct Noise *noise, const struct NoiseParams *params, __m128 x, __m128 z)
+{
+	const __m128 frequency = _mm_set1_ps(params->frequency);
+	x = _mm_mul_ps(x, frequency);
+	z = _mm_mul_ps(z, frequency);
+	if (params->warp != 0.0f) {
+		const float (*offsets)[2] = &noise->offsets[NOISE_MAX_OCTAVES];
+		const __m128 warp = _mm_set1_ps(params->warp);
+		__m128 wx = fbm4(noise, params, NOISE_WARP_OCTAVES, _mm_add_ps(x, _mm_set1_ps(offsets[0][0])),
+			_mm_add_ps(z, _mm_set1_ps(offsets[0][1])));
+		__m128 wz = fbm4(noise, params, NOISE_WARP_OCTAVES, _mm_add_ps(x, _mm_set1_ps(offsets[1][0])),
+			_mm_add_ps(z, _mm_set1_ps(offsets[1][1])));
+		x = _mm_add_ps(x, _mm_mul_ps(wx, warp));
+		z = _mm_add_ps(z, _mm_mul_ps(wz, warp));
+	}
+	__m128 n = params->fractal == NOISE_RIDGED ? ridged4(noise, params, x, z) :
+		fbm4(noise, params, params->octaves, x, z);
+	return _mm_mul_ps(n, _mm_set1_ps(params->height));
+}
+/* as above, eight wide and with the lattice hashes and gradients gathered */
+__attribute__((target("avx2")))
+static __m256 fade8(__m256 t)
+{
+	const __m256 t3 = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+	const __m256 inner = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)),
+		_mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+	return _mm256_mul_ps(t3, inner);
+}
+
+__attribute__((target("avx2")))
+static __m256i hashLattice8(const struct Noise *noise, __m256i x, __m256i z)
+{
+	// the table is padded so reading 4 bytes at the last entry stays inside it
+	const __m256i byte = _mm256_set1_epi32(255);
+	const int *table = (const int *) noise->permutation;
+	__m256i px = _mm256_and_si256(_mm256_i32gather_epi32(table, _mm256_and_si256(x, byte), 1), byte);
+	__m256i index = _mm256_add_epi32(px, _mm256_and_si256(z, byte));
+	return _mm256_and_si256(_mm256_i32gather_epi32(table, index, 1), byte);
+}
+
+__attribute__((target("avx2")))
+static __m256 gradientDot8(__m256i h, __m256 fx, __m256 fz)
+{
+	const __m256i index = _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(7)), 1);
+	const __m256 gx = _mm256_i32gather_ps(&gradients[0][0], index, 4);
+	const __m256 gz = _mm256_i32gather_ps(&gradients[0][1], index, 4);
+	return _mm256_add_ps(_mm256_mul_ps(gx, fx), _mm256_mul_ps(gz, fz));
+}
+
+__attribute__((target("avx2")))
+static __m256 noise2D8(const struct Noise *noise, enum NoiseBasis basis, __m256 x, __m256 z)
+{
+	__m256i ix = _mm256_cvttps_epi32(x), iz = _mm256_cvttps_epi32(z);
+	ix = _mm256_add_epi32(ix, _mm256_castps_si256(_mm256_cmp_ps(_mm256_cvtepi32_ps(ix), x, _CMP_GT_OQ)));
+	iz = _mm256_add_epi32(iz, _mm256_castps_si256(_mm256_cmp_ps(_mm256_cvtepi32_ps(iz), z, _CMP_GT_OQ)));
+	const __m256 fx = _mm256_sub_ps(x, _mm256_cvtepi32_ps(ix)), fz = _mm256_sub_ps(z, _mm256_cvtepi32_ps(iz));
+
+	const __m256i oneI = _mm256_set1_epi32(1);
+	const __m256i ix1 = _mm256_add_epi32(ix, oneI), iz1 = _mm256_add_epi32(iz, oneI);
+	const __m256i h00 = hashLattice8(noise, ix, iz), h10 = hashLattice8(noise, ix1, iz);
+	const __m256i h01 = hashLattice8(noise, ix, iz1), h11 = hashLattice8(noise, ix1, iz1);
+
+	const __m256 one = _mm256_set1_ps(1.0f);
+	__m256 v00, v10, v01, v11;
+	if (basis == NOISE_VALUE) {
+		const __m256 valueScale = _mm256_set1_ps(2.0f / 255.0f);
+		v00 = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(h00), valueScale), one);
+		v10 = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(h10), valueScale), one);
+		v01 = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(h01), valueScale), one);
+		v11 = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(h11), valueScale), one);
+	} else {
+		const __m256 fx1 = _mm256_sub_ps(fx, one), fz1 = _mm256_sub_ps(fz, one);
+		v00 = gradientDot8(h00, fx, fz);
+		v10 = gradientDot8(h10, fx1, fz);
+		v01 = gradientDot8(h01, fx, fz1);
+		v11 = gradientDot8(h11, fx1, fz1);
+	}
+
+	const __m256 u = fade8(fx), w = fade8(fz);
+	const __m256 a = _mm256_add_ps(v00, _mm256_mul_ps(_mm256_sub_ps(v10, v00), u));
+	const __m256 b = _mm256_add_ps(v01, _mm256_mul_ps(_mm256_sub_ps(v11, v01), u));
+	const __m256 r = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), w));
+	return basis == NOISE_VALUE ? r : _mm256_mul_ps(r, _mm256_set1_ps(GRADIENT_NOISE_SCALE));
+}
+
+__attribute__((target("avx2")))
+static __m256 fbm8(const struct Noise *noise, const struct NoiseParams *params, uint32_t octaves, __m256 x, __m256 z)
+{
+	const __m256 lacunarity = _mm256_set1_ps(params->lacunarity);
+	__m256 sum = _mm256_setzero_ps();
+	float amplitude = 1.0f, total = 0.0f;
+	for (uint32_t i = 0; i < clampOctaves(octaves); i++) {
+		__m256 n = noise2D8(noise, params->basis, _mm256_add_ps(x, _mm256_set1_ps(noise->offsets[i][0])),
+			_mm256_add_ps(z, _mm256_set1_ps(noise->offsets[i][1])));
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(n, _mm256_set1_ps(amplitude)));
+		total += amplitude;
+		amplitude *= params->gain;
+		x = _mm256_mul_ps(x, lacunarity);
+		z = _mm256_mul_ps(z, lacunarity);
+	}
+	return _mm256_div_ps(sum, _mm256_set1_ps(total));
+}
+
+__attribute__((target("avx2")))
+static __m256 ridged8(const struct Noise *noise, const struct NoiseParams *params, __m256 x, __m256 z)
+{
+	const __m256 lacunarity = _mm256_set1_ps(params->lacunarity), one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f), absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	__m256 sum = _mm256_setzero_ps(), weight = one;
+	float amplitude = 1.0f, total = 0.0f;
+	for (uint32_t i = 0; i < clampOctaves(params->octaves); i++) {
+		__m256 n = noise2D8(noise, params->basis, _mm256_add_ps(x, _mm256_set1_ps(noise->offsets[i][0])),
+			_mm256_add_ps(z, _mm256_set1_ps(noise->offsets[i][1])));
+		n = _mm256_sub_ps(one, _mm256_and_ps(n, absMask));
+		n = _mm256_mul_ps(_mm256_mul_ps(n, n), weight);
+		weight = _mm256_min_ps(_mm256_mul_ps(n, two), one);
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(n, _mm256_set1_ps(amplitude)));
+		total += amplitude;
+		amplitude *= params->gain;
+		x = _mm256_mul_ps(x, lacunarity);
+		z = _mm256_mul_ps(z, lacunarity);
+	}
+	return _mm256_sub_ps(_mm256_mul_ps(_mm256_div_ps(sum, _mm256_set1_ps(total)), two), one);
+}
+
+__attribute__((target("avx2")))
+static __m256 fractalNoise2D8(const struct Noise *noise, const struct NoiseParams *params, __m256 x, __m256 z)
+{
+	const __m256 frequency = _mm256_set1_ps(params->frequency);
+	x = _mm256_mul_ps(x, frequency);
+	z = _mm256_mul_ps(z, frequency);
+	if (params->warp != 0.0f) {
+		const float (*offsets)[2] = &noise->offsets[NOISE_MAX_OCTAVES];
+		const __m256 warp = _mm256_set1_ps(params->warp);
+		__m256 wx = fbm8(noise, params, NOISE_WARP_OCTAVES, _mm256_add_ps(x, _mm256_set1_ps(offsets[0][0])),
+			_mm256_add_ps(z, _mm256_set1_ps(offsets[0][1])));
+		__m256 wz = fbm8(noise, params, NOISE_WARP_OCTAVES, _mm256_add_ps(x, _mm256_set1_ps(offsets[1][0])),
+			_mm256_add_ps(z, _mm256_set1_ps(offsets[1][1])));
+		x = _mm256_add_ps(x, _mm256_mul_ps(wx, warp));
+		z = _mm256_add_ps(z, _mm256_mul_ps(wz, warp));
+	}
+	__m256 n = params->fractal == NOISE_RIDGED ? ridged8(noise, params, x, z) :
+		fbm8(noise, params, params->octaves, x, z);
+	return _mm256_mul_ps(n, _mm256_set1_ps(params->height));
+}
+
+__attribute__((target("avx2")))
+static uint32_t fillNoiseRowAVX2(const struct Noise *noise, const struct NoiseParams *params, float *row,
+	uint32_t width, uint32_t z)
+{
+	const __m256 rowZ = _mm256_set1_ps((float) z);
+	const __m256 step = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	uint32_t x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m256 columns = _mm256_add_ps(_mm256_set1_ps((float) x), step);
+		_mm256_storeu_ps(row + x, fractalNoise2D8(noise, params, columns, rowZ));
+	}
+	return x;
+}
+#endif
+
+struct NoiseJob {
+	float *heightmap;
+	uint32_t width;
+	const struct NoiseParams *params;
+	struct Noise noise;
+	bool avx2;
+};
+
+static bool fillNoiseRows(void *arg, uint32_t begin, uint32_t end)
+{
+	const struct NoiseJob *job = arg;
+	for (uint32_t z = begin; z < end; z++) {
+		float *row = &job->heightmap[(size_t) z * job->width];
+		uint32_t x = 0;
+#ifdef NOISE_SSE2
+		if (job->avx2) {
+			x = fillNoiseRowAVX2(&job->noise, job->params, row, job->width, z);
+		}
+		const __m128 rowZ = _mm_set1_ps((float) z), step = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+		for (; x + 4 <= job->width; x += 4) {
+			__m128 columns = _mm_add_ps(_mm_set1_ps((float) x), step);
+			_mm_storeu_ps(row + x, fractalNoise2D4(&job->noise, job->params, columns, rowZ));
+		}
+#endif
+		for (; x < job->width; x++) {
+			row[x] = fractalNoise2D(&job->noise, job->params, (float) x, (float) z);
+		}
+	}
+	return true;
+}
+
+void fillNoiseHeightmap(float *heightmap, uint32_t width, uint32_t depth, const struct NoiseParams *params,
+	unsigned int seed)
+{
+	struct NoiseJob job = {.heightmap = heightmap, .width = width, .params = params};
+	initNoise(&job.noise, seed);
+#ifdef NOISE_SSE2
+	job.avx2 = __builtin_cpu_supports("avx2");
+#endif
+	parallelFor(depth, fillNoiseRows, &job);
+}
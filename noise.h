@@ -0,0 +1,59 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <stdint.h>
+
+#define NOISE_MAX_OCTAVES 16
+/* octaves of the fBm that displaces the input when domain warping */
+#define NOISE_WARP_OCTAVES 3
+
+enum NoiseBasis {
+	NOISE_VALUE, /* random values at lattice points, blocky */
+	NOISE_GRADIENT /* Perlin style random gradients at lattice points */
+};
+
+enum NoiseFractal {
+	NOISE_FBM, /* sum of octaves, rolling hills */
+	NOISE_RIDGED /* ridged multifractal, sharp crests and smooth valleys */
+};
+
+/*
+ * Seeded noise. The same seed gives the same values on every platform, thread
+ * count and instruction set, it doesn't depend on rand().
+ */
+struct Noise {
+	uint8_t permutation[512 + 4]; /* 256 entries repeated so lookups don't need wrapping, plus padding for gathers */
+	float offsets[NOISE_MAX_OCTAVES + 2][2]; /* per-octave shifts, plus two for the warp */
+};
+
+struct NoiseParams {
+	enum NoiseBasis basis;
+	enum NoiseFractal fractal;
+	uint32_t octaves;
+	float frequency; /* of the first octave, per heightmap sample */
+	float lacunarity; /* frequency multiplier between octaves */
+	float gain; /* amplitude multiplier between octaves */
+	float warp; /* how far the input is displaced by another noise, in first-octave lattice cells, 0 for none */
+	float height; /* output is in [-height, height] */
+};
+
+void initNoise(struct Noise *noise, unsigned int seed);
+
+/* rolling hills, good for a 512 to 4096 sample terrain */
+struct NoiseParams getDefaultNoiseParams(void);
+
+/* a single octave of the basis, roughly in [-1, 1] */
+float noise2D(const struct Noise *noise, enum NoiseBasis basis, float x, float z);
+
+/* params applied to one point, x and z in heightmap samples */
+float fractalNoise2D(const struct Noise *noise, const struct NoiseParams *params, float x, float z);
+
+/*
+ * Fills a width * depth heightmap with fractalNoise2D, rows split across cores
+ * and eight or four samples at a time with AVX2 or SSE2. The results are the same
+ * as calling fractalNoise2D for every sample.
+ */
+void fillNoiseHeightmap(float *heightmap, uint32_t width, uint32_t depth, const struct NoiseParams *params,
+	unsigned int seed);
+
+#endif
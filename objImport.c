@@ -0,0 +1,366 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file.h"
+#include "maths.h"
+#include "meshOptimize.h"
+#include "objImport.h"
+
+/* a face corner's position, texture coordinates and normal, 0 based, -1 if it has none */
+struct ObjCorner {
+	int32_t position, textureCoordinates, normal;
+};
+
+struct ObjData {
+	float *positions, *textureCoordinates, *normals; /* 3, 2 and 3 floats each */
+	uint32_t numPositions, numTextureCoordinates, numNormals;
+	uint32_t positionCapacity, textureCoordinateCapacity, normalCapacity;
+	struct ObjCorner *corners; /* 3 per triangle */
+	uint32_t numCorners, cornerCapacity;
+};
+
+static void freeObjData(struct ObjData *data)
+{
+	free(data->positions);
+	free(data->textureCoordinates);
+	free(data->normals);
+	free(data->corners);
+}
+
+bool isObjFile(const char *path)
+{
+	size_t len = strlen(path);
+	return len > 4 && strcmp(path + len - 4, ".obj") == 0;
+}
+
+/* line starts with keyword and white space */
+static bool hasKeyword(const char *line, const char *keyword)
+{
+	const size_t length = strlen(keyword);
+	return strncmp(line, keyword, length) == 0 && isspace((unsigned char) line[length]);
+}
+
+/* array with room for twice as many elements of size bytes, capacity is only updated if it grows */
+static void *grow(void *array, uint32_t *capacity, size_t size)
+{
+	const uint32_t newCapacity = *capacity ? *capacity * 2 : 1024;
+	void *grown = realloc(array, newCapacity * size);
+	if (grown) {
+		*capacity = newCapacity;
+	}
+	return grown;
+}
+
+/* reads count floats from line into the next element of *array, any after the first required ones default to 0 */
+static bool readFloats(const char *line, uint32_t count, uint32_t required, float **array, uint32_t *numElements,
+	uint32_t *capacity)
+{
+	if (*numElements == *capacity) {
+		float *grown = grow(*array, capacity, count * sizeof(float));
+		if (!grown) {
+			return false;
+		}
+		*array = grown;
+	}
+	float *element = &(*array)[*numElements * count];
+	for (uint32_t i = 0; i < count; i++) {
+		char *end;
+		element[i] = strtof(line, &end);
+		if (end == line) {
+			if (i < required) {
+				return false;
+			}
+			element[i] = 0.0f;
+		}
+		line = end;
+	}
+	(*numElements)++;
+	return true;
+}
+
+/* OBJ indices count from 1, or back from the last element read if negative. -1 if the index is left out */
+static bool readIndex(const char **token, uint32_t count, int32_t *index)
+{
+	char *end;
+	const long value = strtol(*token, &end, 10);
+	if (end == *token) {
+		*index = -1;
+		return true;
+	}
+	*token = end;
+	*index = value > 0 ? (int32_t) (value - 1) : (int32_t) (count + value);
+	return value != 0 && *index >= 0;
+}
+
+static bool readCorner(const char **token, const struct ObjData *data, struct ObjCorner *corner)
+{
+	if (!readIndex(token, data->numPositions, &corner->position) || corner->position < 0) {
+		return false;
+	}
+	corner->textureCoordinates = -1;
+	corner->normal = -1;
+	if (**token == '/') {
+		(*token)++;
+		if (!readIndex(token, data->numTextureCoordinates, &corner->textureCoordinates)) {
+			return false;
+		}
+		if (**token == '/') {
+			(*token)++;
+			if (!readIndex(token, data->numNormals, &corner->normal)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/* a polygon's corners as a fan of triangles */
+static bool readFace(const char *line, struct ObjData *data)
+{
+	struct ObjCorner first, previous, corner;
+	uint32_t numCorners = 0;
+	for (;;) {
+		while (isspace((unsigned char) *line)) {
+			line++;
+		}
+		if (!*line) {
+			break;
+		}
+		if (!readCorner(&line, data, &corner)) {
+			return false;
+		}
+		if (numCorners >= 2) {
+			if (data->numCorners + 3 > data->cornerCapacity) {
+				struct ObjCorner *grown = grow(data->corners, &data->cornerCapacity, sizeof(struct ObjCorner));
+				if (!grown) {
+					return false;
+				}
+				data->corners = grown;
+			}
+			data->corners[data->numCorners++] = first;
+			data->corners[data->numCorners++] = previous;
+			data->corners[data->numCorners++] = corner;
+		}
+		if (!numCorners) {
+			first = corner;
+		}
+		previous = corner;
+		numCorners++;
+	}
+	return numCorners >= 3;
+}
+
+static bool parseObj(const char *path, char *text, struct ObjData *data)
+{
+	uint32_t lineNumber = 0;
+	for (char *line = text; line; ) {
+		char *next = strchr(line, '\n');
+		if (next) {
+			*next++ = '\0';
+		}
+		lineNumber++;
+		while (isspace((unsigned char) *line)) {
+			line++;
+		}
+
+		bool valid = true;
+		if (hasKeyword(line, "v")) {
+			valid = readFloats(line + 2, 3, 3, &data->positions, &data->numPositions, &data->positionCapacity);
+		} else if (hasKeyword(line, "vt")) {
+			// v is optional, for 1D textures
+			valid = readFloats(line + 3, 2, 1, &data->textureCoordinates, &data->numTextureCoordinates,
+				&data->textureCoordinateCapacity);
+		} else if (hasKeyword(line, "vn")) {
+			valid = readFloats(line + 3, 3, 3, &data->normals, &data->numNormals, &data->normalCapacity);
+		} else if (hasKeyword(line, "f")) {
+			valid = readFace(line + 2, data);
+		}
+		if (!valid) {
+			fprintf(stderr, "%s:%u: can't read \"%s\".\n", path, lineNumber, line);
+			return false;
+		}
+		line = next;
+	}
+
+	for (uint32_t i = 0; i < data->numCorners; i++) {
+		const struct ObjCorner *corner = &data->corners[i];
+		if ((uint32_t) corner->position >= data->numPositions ||
+			(corner->textureCoordinates >= 0 && (uint32_t) corner->textureCoordinates >= data->numTextureCoordinates) ||
+			(corner->normal >= 0 && (uint32_t) corner->normal >= data->numNormals)) {
+			fprintf(stderr, "%s: face refers to a missing vertex.\n", path);
+			return false;
+		}
+	}
+	if (!data->numCorners) {
+		fprintf(stderr, "%s has no faces.\n", path);
+		return false;
+	}
+	return true;
+}
+
+/* the sum of the faces' (area weighted) normals around each position, for corners without one */
+static float *getPositionNormals(const struct ObjData *data)
+{
+	float *normals = calloc(data->numPositions * 3, sizeof(float));
+	if (!normals) {
+		return NULL;
+	}
+	for (uint32_t i = 0; i < data->numCorners; i += 3) {
+		const float *a = &data->positions[data->corners[i].position * 3];
+		const float *b = &data->positions[data->corners[i + 1].position * 3];
+		const float *c = &data->positions[data->corners[i + 2].position * 3];
+		float n[3];
+		crossProduct(b[0] - a[0], b[1] - a[1], b[2] - a[2], c[0] - a[0], c[1] - a[1], c[2] - a[2], &n[0], &n[1],
+			&n[2]);
+		for (int j = 0; j < 3; j++) {
+			float *normal = &normals[data->corners[i + j].position * 3];
+			normal[0] += n[0]; normal[1] += n[1]; normal[2] += n[2];
+		}
+	}
+	return normals;
+}
+
+static void packCorner(struct PackedVertex *vertex, const struct ObjData *data, const struct ObjCorner *corner,
+	const float *positionNormals)
+{
+	const float *n = corner->normal >= 0 ? &data->normals[corner->normal * 3] :
+		&positionNormals[corner->position * 3];
+	const float length = magnitude(n[0], n[1], n[2]);
+	float normal[] = {0.0f, 1.0f, 0.0f};
+	if (length > 0.0f) {
+		normal[0] = n[0] / length; normal[1] = n[1] / length; normal[2] = n[2] / length;
+	}
+	float u = 0.0f, v = 0.0f;
+	if (corner->textureCoordinates >= 0) {
+		// OBJ puts v = 0 at the bottom of the image, textures are loaded top row first
+		u = data->textureCoordinates[corner->textureCoordinates * 2];
+		v = 1.0f - data->textureCoordinates[corner->textureCoordinates * 2 + 1];
+	}
+	packVertex(vertex, &data->positions[corner->position * 3], normal, u, v);
+}
+
+static uint32_t hashCorner(const struct ObjCorner *corner)
+{
+	uint32_t h = (uint32_t) corner->position * 0x9e3779b1u;
+	h = (h ^ (uint32_t) corner->textureCoordinates) * 0x85ebca6bu;
+	h = (h ^ (uint32_t) corner->normal) * 0xc2b2ae35u;
+	return h ^ h >> 16;
+}
+
+static bool sameCorner(const struct ObjCorner *a, const struct ObjCorner *b)
+{
+	return a->position == b->position && a->textureCoordinates == b->textureCoordinates && a->normal == b->normal;
+}
+
+/* one vertex for each distinct corner, with degenerate triangles left out */
+static bool weldCorners(const struct ObjData *data, const float *positionNormals, struct ObjModel *model)
+{
+	uint32_t tableSize = 1;
+	while (tableSize < data->numCorners * 2) {
+		tableSize *= 2;
+	}
+	uint32_t *table = malloc(tableSize * sizeof(uint32_t));
+	uint32_t *vertexCorners = malloc(data->numCorners * sizeof(uint32_t)); /* a corner each vertex was made from */
+	model->vertices = malloc(data->numCorners * sizeof(struct PackedVertex));
+	model->indices = malloc(data->numCorners * sizeof(uint32_t));
+	if (!table || !vertexCorners || !model->vertices || !model->indices) {
+		free(table);
+		free(vertexCorners);
+		freeObjModel(model);
+		return false;
+	}
+	memset(table, 0xff, tableSize * sizeof(uint32_t));
+
+	for (uint32_t i = 0; i < data->numCorners; i++) {
+		const struct ObjCorner *corner = &data->corners[i];
+		uint32_t slot = hashCorner(corner) & (tableSize - 1);
+		while (table[slot] != UINT32_MAX && !sameCorner(&data->corners[vertexCorners[table[slot]]], corner)) {
+			slot = (slot + 1) & (tableSize - 1);
+		}
+		if (table[slot] == UINT32_MAX) {
+			table[slot] = model->numVertices;
+			vertexCorners[model->numVertices] = i;
+			packCorner(&model->vertices[model->numVertices++], data, corner, positionNormals);
+		}
+		model->indices[model->numIndices++] = table[slot];
+
+		if (i % 3 == 2) {
+			const uint32_t *triangle = &model->indices[model->numIndices - 3];
+			if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2]) {
+				model->numIndices -= 3;
+			}
+		}
+	}
+	free(table);
+	free(vertexCorners);
+	return true;
+}
+
+bool importObj(const char *path, struct ObjModel *model)
+{
+	memset(model, 0, sizeof(struct ObjModel));
+	char *text = loadFile(path);
+	if (!text) {
+		fprintf(stderr, "Error loading %s.\n", path);
+		return false;
+	}
+	struct ObjData data = {0};
+	const bool parsed = parseObj(path, text, &data);
+	free(text);
+	if (!parsed) {
+		freeObjData(&data);
+		return false;
+	}
+
+	float *positionNormals = getPositionNormals(&data);
+	const bool welded = positionNormals && weldCorners(&data, positionNormals, model);
+	free(positionNormals);
+	freeObjData(&data);
+	if (!welded) {
+		return false;
+	}
+
+	if (!optimizeVertexCache(model->indices, model->numIndices, model->numVertices) ||
+		!optimizeVertexFetch(model->vertices, sizeof(struct PackedVertex), &model->numVertices, model->indices,
+		model->numIndices)) {
+		freeObjModel(model);
+		return false;
+	}
+	return true;
+}
+
+void freeObjModel(struct ObjModel *model)
+{
+	free(model->vertices);
+	free(model->indices);
+	free(model->shortIndices);
+	model->vertices = NULL;
+	model->indices = NULL;
+	model->shortIndices = NULL;
+	model->numVertices = 0;
+	model->numIndices = 0;
+}
+
+GLenum narrowObjIndices(struct ObjModel *model, const void **indices)
+{
+	uint16_t *shortIndices = NULL;
+	if (model->numVertices <= UINT16_MAX + 1) {
+		shortIndices = malloc(model->numIndices * sizeof(uint16_t));
+	}
+	if (!shortIndices) {
+		*indices = model->indices;
+		return GL_UNSIGNED_INT;
+	}
+	for (uint32_t i = 0; i < model->numIndices; i++) {
+		shortIndices[i] = (uint16_t) model->indices[i];
+	}
+	free(model->indices);
+	model->indices = NULL;
+	model->shortIndices = shortIndices;
+	*indices = shortIndices;
+	return GL_UNSIGNED_SHORT;
+}
+
@@ -0,0 +1,43 @@
+#ifndef OBJ_IMPORT_H
+#define OBJ_IMPORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+#include "vertexFormat.h"
+
+/* a Wavefront OBJ model as indexed triangles, ready to upload */
+struct ObjModel {
+	struct PackedVertex *vertices;
+	uint32_t numVertices;
+	uint32_t *indices; /* NULL once narrowObjIndices has made shortIndices */
+	uint16_t *shortIndices;
+	uint32_t numIndices;
+};
+
+/*
+ * Reads the v, vt, vn and f lines of an OBJ file, ignoring materials and
+ * groups. Polygons are split into fans of triangles and face corners with the
+ * same position, texture coordinates and normal are welded into one vertex.
+ * Corners without a normal get the average of the faces around their
+ * position. The triangles are then put in vertex cache order and the vertices
+ * in the order they're first used (see meshOptimize.h). false if the file
+ * can't be read, is malformed or there's no memory.
+ */
+bool importObj(const char *path, struct ObjModel *model);
+
+void freeObjModel(struct ObjModel *model);
+
+/*
+ * Replaces indices with 16 bit shortIndices if every vertex can be reached with
+ * them, and there's memory for them. Points *indices at the ones to upload and
+ * returns their type, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+ */
+GLenum narrowObjIndices(struct ObjModel *model, const void **indices);
+
+/* true if path names an OBJ file, by extension */
+bool isObjFile(const char *path);
+
+#endif
@@ -0,0 +1,79 @@
+#include <pthread.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include "Windows.h"
+#else
+#include <unistd.h>
+#endif
+
+#include "parallel.h"
+
+#define MAX_WORKER_THREADS 64
+
+struct ParallelBand {
+	ParallelFunction function;
+	void *arg;
+	uint32_t begin, end;
+	bool result;
+};
+
+uint32_t getNumWorkerThreads(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	long n = (long) info.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (n < 1) {
+		return 1;
+	}
+	return n > MAX_WORKER_THREADS ? MAX_WORKER_THREADS : (uint32_t) n;
+}
+
+static void *runBand(void *arg)
+{
+	struct ParallelBand *band = arg;
+	band->result = band->function(band->arg, band->begin, band->end);
+	return NULL;
+}
+
+bool parallelFor(uint32_t count, ParallelFunction function, void *arg)
+{
+	uint32_t numBands = getNumWorkerThreads();
+	if (numBands > count) {
+		numBands = count;
+	}
+	if (numBands <= 1) {
+		return count == 0 || function(arg, 0, count);
+	}
+
+	struct ParallelBand bands[MAX_WORKER_THREADS];
+	pthread_t threads[MAX_WORKER_THREADS];
+	bool started[MAX_WORKER_THREADS] = {false};
+	for (uint32_t i = 0; i < numBands; i++) {
+		bands[i].function = function;
+		bands[i].arg = arg;
+		bands[i].begin = (uint32_t) ((uint64_t) count * i / numBands);
+		bands[i].end = (uint32_t) ((uint64_t) count * (i + 1) / numBands);
+		bands[i].result = false;
+	}
+
+	// if a thread can't be started its band is run here instead
+	for (uint32_t i = 1; i < numBands; i++) {
+		started[i] = pthread_create(&threads[i], NULL, runBand, &bands[i]) == 0;
+	}
+	runBand(&bands[0]);
+	bool result = bands[0].result;
+	for (uint32_t i = 1; i < numBands; i++) {
+		if (started[i]) {
+			pthread_join(threads[i], NULL);
+		} else {
+			runBand(&bands[i]);
+		}
+		result = result && bands[i].result;
+	}
+	return result;
+}
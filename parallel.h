@@ -0,0 +1,21 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* work on items [begin, end), returns false on failure */
+typedef bool (*ParallelFunction)(void *arg, uint32_t begin, uint32_t end);
+
+/* number of threads parallelFor splits work across, one per online core */
+uint32_t getNumWorkerThreads(void);
+
+/*
+ * Splits [0, count) into contiguous bands, one per worker thread, and calls
+ * function on each band at the same time. The caller's thread takes the first
+ * band. Bands are the same for a given count and core count, but function must
+ * not depend on them for its results. Returns true if every band succeeded.
+ */
+bool parallelFor(uint32_t count, ParallelFunction function, void *arg);
+
+#endif
@@ -0,0 +1,271 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "quantizedHeightmap.h"
+
+/* quotients this large are written as the escape followed by the raw value */
+#define RICE_ESCAPE 24
+/* zigzagged residuals of 16 bit samples fit in 17 bits */
+#define RICE_RAW_BITS 17
+
+/* least significant bit first */
+struct BitStream {
+	uint8_t *data;
+	size_t position;
+	uint64_t buffer;
+	uint32_t count;
+};
+
+static void putBits(struct BitStream *s, uint32_t value, uint32_t n)
+{
+	s->buffer |= (uint64_t) value << s->count;
+	s->count += n;
+	while (s->count >= 8) {
+		s->data[s->position++] = (uint8_t) s->buffer;
+		s->buffer >>= 8;
+		s->count -= 8;
+	}
+}
+
+static uint32_t getBits(struct BitStream *s, uint32_t n)
+{
+	while (s->count < n) {
+		s->buffer |= (uint64_t) s->data[s->position++] << s->count;
+		s->count += 8;
+	}
+	uint32_t value = (uint32_t) (s->buffer & ((1ull << n) - 1));
+	s->buffer >>= n;
+	s->count -= n;
+	return value;
+}
+
+static void getTileExtent(const struct QuantizedHeightmap *q, uint32_t tx, uint32_t tz, uint32_t *width,
+	uint32_t *depth)
+{
+	*width = q->size - tx * QUANTIZED_TILE_SIZE < QUANTIZED_TILE_SIZE ? q->size - tx * QUANTIZED_TILE_SIZE :
+		QUANTIZED_TILE_SIZE;
+	*depth = q->size - tz * QUANTIZED_TILE_SIZE < QUANTIZED_TILE_SIZE ? q->size - tz * QUANTIZED_TILE_SIZE :
+		QUANTIZED_TILE_SIZE;
+}
+
+/* median edge detector from LOCO-I, picks up horizontal and vertical edges */
+static int32_t predictSample(const uint16_t *samples, uint32_t width, uint32_t x, uint32_t z)
+{
+	if (x == 0 && z == 0) {
+		return 0;
+	} else if (z == 0) {
+		return samples[x - 1];
+	} else if (x == 0) {
+		return samples[(z - 1) * width];
+	}
+	int32_t a = samples[x - 1 + z * width], b = samples[x + (z - 1) * width], c = samples[x - 1 + (z - 1) * width];
+	int32_t lo = a < b ? a : b, hi = a < b ? b : a;
+	return c >= hi ? lo : (c <= lo ? hi : a + b - c);
+}
+
+/* packed tiles start with the Rice parameter, followed by one code per sample in row-major order */
+static uint8_t *packTile(const uint16_t *samples, uint32_t width, uint32_t depth, uint32_t *packedSize)
+{
+	const uint32_t count = width * depth;
+	uint32_t *residuals = malloc(count * sizeof(uint32_t));
+	if (!residuals) {
+		return NULL;
+	}
+	for (uint32_t z = 0; z < depth; z++) {
+		for (uint32_t x = 0; x < width; x++) {
+			int32_t r = (int32_t) samples[x + z * width] - predictSample(samples, width, x, z);
+			residuals[x + z * width] = ((uint32_t) r << 1) ^ (uint32_t) (r >> 31);
+		}
+	}
+
+	// the parameter that gives the fewest bits for this tile
+	uint32_t k = 0;
+	uint64_t bestBits = UINT64_MAX;
+	for (uint32_t candidate = 0; candidate < RICE_RAW_BITS; candidate++) {
+		uint64_t bits = 0;
+		for (uint32_t i = 0; i < count; i++) {
+			uint32_t quotient = residuals[i] >> candidate;
+			bits += quotient < RICE_ESCAPE ? quotient + 1 + candidate : RICE_ESCAPE + RICE_RAW_BITS;
+		}
+		if (bits < bestBits) {
+			bestBits = bits;
+			k = candidate;
+		}
+	}
+
+	struct BitStream s = {.data = malloc(1 + (bestBits + 7) / 8)};
+	if (!s.data) {
+		free(residuals);
+		return NULL;
+	}
+	s.data[s.position++] = (uint8_t) k;
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t quotient = residuals[i] >> k;
+		if (quotient < RICE_ESCAPE) {
+			putBits(&s, (1u << quotient) - 1, quotient + 1);
+			putBits(&s, residuals[i] & ((1u << k) - 1), k);
+		} else {
+			putBits(&s, (1u << RICE_ESCAPE) - 1, RICE_ESCAPE);
+			putBits(&s, residuals[i], RICE_RAW_BITS);
+		}
+	}
+	if (s.count) {
+		s.data[s.position++] = (uint8_t) s.buffer;
+	}
+	free(residuals);
+	*packedSize = (uint32_t) s.position;
+	return s.data;
+}
+
+/* decodes the first count samples of a packed tile */
+static void unpackTile(const uint8_t *packed, uint32_t width, uint32_t count, uint16_t *samples)
+{
+	struct BitStream s = {.data = (uint8_t *) packed, .position = 1};
+	const uint32_t k = packed[0];
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t quotient = 0;
+		while (quotient < RICE_ESCAPE && getBits(&s, 1)) {
+			quotient++;
+		}
+		uint32_t u = quotient < RICE_ESCAPE ? (quotient << k) | getBits(&s, k) : getBits(&s, RICE_RAW_BITS);
+		int32_t r = (int32_t) (u >> 1) ^ -(int32_t) (u & 1);
+		samples[i] = (uint16_t) (predictSample(samples, width, i % width, i / width) + r);
+	}
+}
+
+struct QuantizedHeightmap *quantizeHeightmap(const float *heightmap, uint32_t size, float precision)
+{
+	struct QuantizedHeightmap *q = calloc(1, sizeof(struct QuantizedHeightmap));
+	if (!q) {
+		return NULL;
+	}
+	q->size = size;
+	q->tilesPerSide = (size + QUANTIZED_TILE_SIZE - 1) / QUANTIZED_TILE_SIZE;
+	q->tiles = calloc(q->tilesPerSide * q->tilesPerSide, sizeof(struct QuantizedTile));
+	if (!q->tiles) {
+		free(q);
+		return NULL;
+	}
+
+	for (uint32_t tz = 0; tz < q->tilesPerSide; tz++) {
+		for (uint32_t tx = 0; tx < q->tilesPerSide; tx++) {
+			struct QuantizedTile *tile = &q->tiles[tx + tz * q->tilesPerSide];
+			uint32_t width, depth;
+			getTileExtent(q, tx, tz, &width, &depth);
+			const float *source = &heightmap[tx * QUANTIZED_TILE_SIZE + tz * QUANTIZED_TILE_SIZE * size];
+
+			float lo = INFINITY, hi = -INFINITY;
+			for (uint32_t z = 0; z < depth; z++) {
+				for (uint32_t x = 0; x < width; x++) {
+					lo = fminf(lo, source[x + z * size]);
+					hi = fmaxf(hi, source[x + z * size]);
+				}
+			}
+			tile->offset = lo;
+			tile->step = fmaxf((hi - lo) / 65535.0f, precision);
+
+			tile->samples = malloc(width * depth * sizeof(uint16_t));
+			if (!tile->samples) {
+				freeQuantizedHeightmap(q);
+				return NULL;
+			}
+			for (uint32_t z = 0; z < depth; z++) {
+				for (uint32_t x = 0; x < width; x++) {
+					float steps = tile->step > 0.0f ? (source[x + z * size] - lo) / tile->step : 0.0f;
+					tile->samples[x + z * width] = (uint16_t) fminf(fmaxf(roundf(steps), 0.0f), 65535.0f);
+				}
+			}
+		}
+	}
+	return q;
+}
+
+void freeQuantizedHeightmap(struct QuantizedHeightmap *q)
+{
+	for (uint32_t i = 0; i < q->tilesPerSide * q->tilesPerSide; i++) {
+		free(q->tiles[i].samples);
+		free(q->tiles[i].packed);
+	}
+	free(q->tiles);
+	free(q);
+}
+
+float getQuantizedHeight(const struct QuantizedHeightmap *q, uint32_t x, uint32_t z)
+{
+	const uint32_t tx = x / QUANTIZED_TILE_SIZE, tz = z / QUANTIZED_TILE_SIZE;
+	const struct QuantizedTile *tile = &q->tiles[tx + tz * q->tilesPerSide];
+	uint32_t width, depth;
+	getTileExtent(q, tx, tz, &width, &depth);
+	const uint32_t i = (x - tx * QUANTIZED_TILE_SIZE) + (z - tz * QUANTIZED_TILE_SIZE) * width;
+
+	if (tile->samples) {
+		return tile->offset + (float) tile->samples[i] * tile->step;
+	}
+	// only decoded as far as the sample that's wanted
+	uint16_t samples[QUANTIZED_TILE_SIZE * QUANTIZED_TILE_SIZE];
+	unpackTile(tile->packed, width, i + 1, samples);
+	return tile->offset + (float) samples[i] * tile->step;
+}
+
+void dequantizeHeightmap(const struct QuantizedHeightmap *q, float *heightmap)
+{
+	uint16_t unpacked[QUANTIZED_TILE_SIZE * QUANTIZED_TILE_SIZE];
+	for (uint32_t tz = 0; tz < q->tilesPerSide; tz++) {
+		for (uint32_t tx = 0; tx < q->tilesPerSide; tx++) {
+			const struct QuantizedTile *tile = &q->tiles[tx + tz * q->tilesPerSide];
+			uint32_t width, depth;
+			getTileExtent(q, tx, tz, &width, &depth);
+			const uint16_t *samples = tile->samples;
+			if (!samples) {
+				unpackTile(tile->packed, width, width * depth, unpacked);
+				samples = unpacked;
+			}
+			float *out = &heightmap[tx * QUANTIZED_TILE_SIZE + tz * QUANTIZED_TILE_SIZE * q->size];
+			for (uint32_t z = 0; z < depth; z++) {
+				for (uint32_t x = 0; x < width; x++) {
+					out[x + z * q->size] = tile->offset + (float) samples[x + z * width] * tile->step;
+				}
+			}
+		}
+	}
+}
+
+bool setQuantizedTileCold(struct QuantizedHeightmap *q, uint32_t tx, uint32_t tz, bool cold)
+{
+	struct QuantizedTile *tile = &q->tiles[tx + tz * q->tilesPerSide];
+	uint32_t width, depth;
+	getTileExtent(q, tx, tz, &width, &depth);
+
+	if (cold && tile->samples) {
+		tile->packed = packTile(tile->samples, width, depth, &tile->packedSize);
+		if (!tile->packed) {
+			return false;
+		}
+		free(tile->samples);
+		tile->samples = NULL;
+	} else if (!cold && tile->packed) {
+		tile->samples = malloc(width * depth * sizeof(uint16_t));
+		if (!tile->samples) {
+			return false;
+		}
+		unpackTile(tile->packed, width, width * depth, tile->samples);
+		free(tile->packed);
+		tile->packed = NULL;
+		tile->packedSize = 0;
+	}
+	return true;
+}
+
+uint64_t getQuantizedHeightmapMemory(const struct QuantizedHeightmap *q)
+{
+	uint64_t bytes = 0;
+	for (uint32_t tz = 0; tz < q->tilesPerSide; tz++) {
+		for (uint32_t tx = 0; tx < q->tilesPerSide; tx++) {
+			const struct QuantizedTile *tile = &q->tiles[tx + tz * q->tilesPerSide];
+			uint32_t width, depth;
+			getTileExtent(q, tx, tz, &width, &depth);
+			bytes += tile->samples ? width * depth * sizeof(uint16_t) : tile->packedSize;
+		}
+	}
+	return bytes;
+}
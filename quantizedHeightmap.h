@@ -0,0 +1,51 @@
+#ifndef QUANTIZED_HEIGHTMAP_H
+#define QUANTIZED_HEIGHTMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* samples along each side of a tile, tiles don't share samples */
+#define QUANTIZED_TILE_SIZE 64
+
+/*
+ * A tile's samples are 16 bit steps above the tile's lowest point, so the
+ * error is at most half a step, 1/131070th of the tile's height range at full
+ * precision. A tile is either hot, with the samples ready to read, or cold,
+ * with them delta coded against their neighbours and Rice coded, which is
+ * lossless.
+ */
+struct QuantizedTile {
+	float offset, step; /* height = offset + sample * step */
+	uint16_t *samples; /* NULL while the tile is cold */
+	uint8_t *packed; /* NULL while the tile is hot */
+	uint32_t packedSize;
+};
+
+struct QuantizedHeightmap {
+	uint32_t size; /* samples along each side of the map */
+	uint32_t tilesPerSide;
+	struct QuantizedTile *tiles;
+};
+
+/*
+ * Quantizes a size * size float heightmap, every tile starts hot. Steps are no
+ * finer than precision, so a map that came from an 8 bit image (steps of 1/15)
+ * keeps its exact levels and packs far smaller when cold. 0 uses all 16 bits.
+ */
+struct QuantizedHeightmap *quantizeHeightmap(const float *heightmap, uint32_t size, float precision);
+
+void freeQuantizedHeightmap(struct QuantizedHeightmap *q);
+
+/* sample (x, z), which must be on the map. Cold tiles are decoded for every call */
+float getQuantizedHeight(const struct QuantizedHeightmap *q, uint32_t x, uint32_t z);
+
+/* writes every sample back out as floats */
+void dequantizeHeightmap(const struct QuantizedHeightmap *q, float *heightmap);
+
+/* packs a tile that isn't needed often into its compressed form, or unpacks it again */
+bool setQuantizedTileCold(struct QuantizedHeightmap *q, uint32_t tx, uint32_t tz, bool cold);
+
+/* bytes used by the samples of every tile in their current form */
+uint64_t getQuantizedHeightmapMemory(const struct QuantizedHeightmap *q);
+
+#endif
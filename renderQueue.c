@@ -0,0 +1,262 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "renderQueue.h"
+
+#define KEY_PASS_SHIFT 60
+#define KEY_PROGRAM_SHIFT 56
+#define KEY_TEXTURE_SHIFT 44
+#define KEY_VAO_SHIFT 32
+#define KEY_NAME_MASK 0xfffu
+
+/* nothing is assumed to be bound when drawing starts */
+#define UNKNOWN_NAME ((GLuint) -1)
+
+struct RenderQueue *createRenderQueue(void)
+{
+	return calloc(1, sizeof(struct RenderQueue));
+}
+
+uint32_t addRenderProgram(struct RenderQueue *queue, GLuint program, bool objectUniforms)
+{
+	if (queue->numPrograms == RENDER_QUEUE_MAX_PROGRAMS) {
+		return UINT32_MAX;
+	}
+	const struct RenderProgram renderProgram = {.program = program, .objectUniforms = objectUniforms};
+	queue->programs[queue->numPrograms] = renderProgram;
+	return queue->numPrograms++;
+}
+
+void beginRenderQueue(struct RenderQueue *queue, const float *cameraPosition, const float *frustumPlanes)
+{
+	queue->numItems = 0;
+	memcpy(queue->cameraPosition, cameraPosition, sizeof(queue->cameraPosition));
+	memcpy(queue->frustumPlanes, frustumPlanes, sizeof(queue->frustumPlanes));
+}
+
+static bool growQueue(struct RenderQueue *queue)
+{
+	const uint32_t capacity = queue->capacity ? queue->capacity * 2 : 256;
+	struct RenderItem **itemArrays[] = {&queue->items, &queue->sorted};
+	for (int i = 0; i < 2; i++) {
+		struct RenderItem *items = realloc(*itemArrays[i], capacity * sizeof(struct RenderItem));
+		if (!items) {
+			return false;
+		}
+		*itemArrays[i] = items;
+	}
+	struct CullBounds *b = &queue->bounds;
+	float **boundArrays[] = {&b->x, &b->y, &b->z, &b->extentX, &b->extentY, &b->extentZ, &b->radius};
+	for (int i = 0; i < 7; i++) {
+		float *bounds = realloc(*boundArrays[i], capacity * sizeof(float));
+		if (!bounds) {
+			return false;
+		}
+		*boundArrays[i] = bounds;
+	}
+	uint8_t *visible = realloc(queue->visible, capacity);
+	if (!visible) {
+		return false;
+	}
+	queue->visible = visible;
+	queue->capacity = capacity;
+	return true;
+}
+
+static bool pushItem(struct RenderQueue *queue, uint64_t key, struct Mesh *mesh, struct MeshInstances *instances,
+	const float *centre, const float *extents, float radius)
+{
+	if (queue->numItems == queue->capacity && !growQueue(queue)) {
+		return false;
+	}
+	const uint32_t i = queue->numItems++;
+	const struct RenderItem item = {.key = key, .mesh = mesh, .instances = instances};
+	queue->items[i] = item;
+	struct CullBounds *b = &queue->bounds;
+	b->x[i] = centre[0]; b->y[i] = centre[1]; b->z[i] = centre[2];
+	b->extentX[i] = extents[0]; b->extentY[i] = extents[1]; b->extentZ[i] = extents[2];
+	b->radius[i] = radius;
+	return true;
+}
+
+static uint64_t stateKey(enum RenderPass pass, uint32_t program, GLuint texture, GLuint VAO)
+{
+	return (uint64_t) pass << KEY_PASS_SHIFT | (uint64_t) program << KEY_PROGRAM_SHIFT |
+		(uint64_t) (texture & KEY_NAME_MASK) << KEY_TEXTURE_SHIFT | (uint64_t) (VAO & KEY_NAME_MASK) << KEY_VAO_SHIFT;
+}
+
+bool queueMesh(struct RenderQueue *queue, enum RenderPass pass, uint32_t program, struct Mesh *mesh)
+{
+	float centre[3], extents[3], radius;
+	getMeshWorldBounds(mesh, centre, extents, &radius);
+
+	const float dx = centre[0] - queue->cameraPosition[0];
+	const float dy = centre[1] - queue->cameraPosition[1];
+	const float dz = centre[2] - queue->cameraPosition[2];
+	const float distanceSquared = dx * dx + dy * dy + dz * dz;
+
+	// the bits of a non-negative float sort the same way as its value
+	uint32_t depth;
+	memcpy(&depth, &distanceSquared, sizeof(depth));
+
+	return pushItem(queue, stateKey(pass, program, mesh->texture, mesh->VAO) | depth, mesh, NULL, centre, extents,
+		radius);
+}
+
+bool queueMeshInstances(struct RenderQueue *queue, enum RenderPass pass, uint32_t program,
+	struct MeshInstances *instances)
+{
+	if (!instances->numInstances) {
+		return true;
+	}
+	// bounds that reach every plane, instances are spread out and drawn together
+	const float centre[] = {0.0f, 0.0f, 0.0f};
+	const float extents[] = {INFINITY, INFINITY, INFINITY};
+	return pushItem(queue, stateKey(pass, program, instances->mesh->texture, instances->VAO), NULL, instances,
+		centre, extents, INFINITY);
+}
+
+/* drops the items culling found off screen, keeping the rest in order */
+static void cullItems(struct RenderQueue *queue)
+{
+	queue->bounds.count = queue->numItems;
+	const uint32_t numVisible = cullBounds(queue->frustumPlanes, &queue->bounds, queue->visible);
+	queue->numCulled = queue->numItems - numVisible;
+
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < queue->numItems; i++) {
+		if (queue->visible[i]) {
+			queue->items[n++] = queue->items[i];
+		}
+	}
+	queue->numItems = n;
+}
+
+/* least significant byte first, skipping bytes every key shares */
+static void sortItems(struct RenderQueue *queue)
+{
+	uint32_t counts[8][256] = {{0}};
+	for (uint32_t i = 0; i < queue->numItems; i++) {
+		const uint64_t key = queue->items[i].key;
+		for (uint32_t byte = 0; byte < 8; byte++) {
+			counts[byte][(key >> (byte * 8)) & 0xff]++;
+		}
+	}
+
+	struct RenderItem *from = queue->items, *to = queue->sorted;
+	for (uint32_t byte = 0; byte < 8; byte++) {
+		const uint32_t shift = byte * 8;
+		if (counts[byte][(from[0].key >> shift) & 0xff] == queue->numItems) {
+			continue;
+		}
+		uint32_t offsets[256];
+		uint32_t offset = 0;
+		for (uint32_t i = 0; i < 256; i++) {
+			offsets[i] = offset;
+			offset += counts[byte][i];
+		}
+		for (uint32_t i = 0; i < queue->numItems; i++) {
+			to[offsets[(from[i].key >> shift) & 0xff]++] = from[i];
+		}
+		struct RenderItem *swap = from;
+		from = to;
+		to = swap;
+	}
+	// the sorted items end up in whichever array was written last
+	queue->items = from;
+	queue->sorted = to;
+}
+
+static const struct RenderProgram *itemProgram(const struct RenderQueue *queue, const struct RenderItem *item)
+{
+	return &queue->programs[(item->key >> KEY_PROGRAM_SHIFT) & (RENDER_QUEUE_MAX_PROGRAMS - 1)];
+}
+
+static bool hasObjectUniforms(const struct RenderQueue *queue, const struct RenderItem *item)
+{
+	return item->mesh && itemProgram(queue, item)->objectUniforms;
+}
+
+uint32_t drawRenderQueue(struct RenderQueue *queue, struct UniformRing *ring)
+{
+	cullItems(queue);
+	if (!queue->numItems) {
+		return 0;
+	}
+	sortItems(queue);
+
+	// every Object block is written, in draw order, before anything is drawn
+	uint32_t numObjects = 0;
+	for (uint32_t i = 0; i < queue->numItems; i++) {
+		numObjects += hasObjectUniforms(queue, &queue->items[i]);
+	}
+	GLintptr objectOffset = 0;
+	if (numObjects) {
+		uint8_t *objects = mapObjectUniforms(ring, numObjects, &objectOffset);
+		if (!objects) {
+			return 0;
+		}
+		for (uint32_t i = 0; i < queue->numItems; i++) {
+			if (hasObjectUniforms(queue, &queue->items[i])) {
+				loadMeshObjectUniforms(queue->items[i].mesh, (struct ObjectUniforms *) objects);
+				objects += ring->objectStride;
+			}
+		}
+		unmapObjectUniforms(ring);
+	}
+
+	const struct RenderProgram *program = NULL;
+	GLuint VAO = UNKNOWN_NAME, texture = UNKNOWN_NAME;
+	for (uint32_t i = 0; i < queue->numItems; i++) {
+		const struct RenderItem *item = &queue->items[i];
+		if (itemProgram(queue, item) != program) {
+			program = itemProgram(queue, item);
+			glUseProgram(program->program);
+		}
+
+		const struct Mesh *mesh = item->mesh ? item->mesh : item->instances->mesh;
+		GLuint itemVAO = mesh->VAO;
+		if (item->instances) {
+			updateMeshInstances(item->instances);
+			itemVAO = item->instances->VAO;
+		} else if (program->objectUniforms) {
+			bindObjectUniforms(ring, objectOffset);
+			objectOffset += ring->objectStride;
+		}
+		if (itemVAO != VAO) {
+			glBindVertexArray(itemVAO);
+			VAO = itemVAO;
+		}
+		if (mesh->texture != texture) {
+			glBindTexture(GL_TEXTURE_2D, mesh->texture);
+			texture = mesh->texture;
+		}
+
+		if (item->instances && mesh->indexBuffer) {
+			glDrawElementsInstanced(GL_TRIANGLES, mesh->numIndices, mesh->indexType, NULL,
+				item->instances->numInstances);
+		} else if (item->instances) {
+			glDrawArraysInstanced(GL_TRIANGLES, 0, mesh->numVertices, item->instances->numInstances);
+		} else if (mesh->indexBuffer) {
+			glDrawElements(GL_TRIANGLES, mesh->numIndices, mesh->indexType, NULL);
+		} else {
+			glDrawArrays(GL_TRIANGLES, 0, mesh->numVertices);
+		}
+	}
+
+	// buffer updates elsewhere mustn't land in the last VAO
+	glBindVertexArray(0);
+	return queue->numItems;
+}
+
+void cleanupRenderQueue(struct RenderQueue *queue)
+{
+	free(queue->items);
+	free(queue->sorted);
+	free(queue->bounds.x); free(queue->bounds.y); free(queue->bounds.z);
+	free(queue->bounds.extentX); free(queue->bounds.extentY); free(queue->bounds.extentZ);
+	free(queue->bounds.radius);
+	free(queue->visible);
+	free(queue);
+}
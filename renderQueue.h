@@ -0,0 +1,87 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+#include "culling.h"
+#include "mesh.h"
+#include "meshInstances.h"
+#include "uniformRing.h"
+
+#define RENDER_QUEUE_MAX_PROGRAMS 16
+
+/* passes are drawn in this order */
+enum RenderPass {
+	RENDER_PASS_OPAQUE /* front to back, so hidden fragments fail the depth test early */
+};
+
+/* a program items are drawn with, reading its view matrix from the Frame block */
+struct RenderProgram {
+	GLuint program;
+	bool objectUniforms; /* reads an Object block per mesh, instanced programs don't */
+};
+
+/*
+ * Sort key, most significant first:
+ * pass (4 bits) | program (4) | texture (12) | VAO (12) | depth (32)
+ * Texture and VAO names are truncated, so two may share bits. That only costs
+ * an extra bind, the names themselves are compared before binding.
+ */
+struct RenderItem {
+	uint64_t key;
+	struct Mesh *mesh; /* one of mesh or instances */
+	struct MeshInstances *instances;
+};
+
+/*
+ * Draws submitted during a frame. When drawn, those outside the frustum are
+ * culled and the rest radix sorted by key so that programs, textures and VAOs
+ * are only bound when they change. Filled again every frame, the arrays are
+ * kept between frames.
+ */
+struct RenderQueue {
+	struct RenderProgram programs[RENDER_QUEUE_MAX_PROGRAMS];
+	uint32_t numPrograms;
+	struct RenderItem *items, *sorted;
+	uint32_t numItems, capacity;
+	struct CullBounds bounds; /* world bounds of each item as it was queued */
+	uint8_t *visible;
+	float cameraPosition[3];
+	float frustumPlanes[24];
+	uint32_t numCulled; /* items the last drawRenderQueue found off screen */
+};
+
+struct RenderQueue *createRenderQueue(void);
+
+/* returns the program's index for submitting items, or UINT32_MAX if there are already RENDER_QUEUE_MAX_PROGRAMS */
+uint32_t addRenderProgram(struct RenderQueue *queue, GLuint program, bool objectUniforms);
+
+/* empties the queue for a new frame, depths are measured from cameraPosition and items culled against frustumPlanes */
+void beginRenderQueue(struct RenderQueue *queue, const float *cameraPosition, const float *frustumPlanes);
+
+/*
+ * The mesh is culled and its depth measured where it is now, from its bounds,
+ * and drawn where it is when the queue is drawn. false if there's no memory
+ * for it.
+ */
+bool queueMesh(struct RenderQueue *queue, enum RenderPass pass, uint32_t program, struct Mesh *mesh);
+
+/*
+ * Instances are spread out, so they are never culled and are drawn ahead of
+ * meshes sharing their state rather than by depth.
+ */
+bool queueMeshInstances(struct RenderQueue *queue, enum RenderPass pass, uint32_t program,
+	struct MeshInstances *instances);
+
+/*
+ * Culls and sorts everything queued, writes the meshes' Object blocks into the ring's
+ * current frame and draws it all. Returns the number of draw calls.
+ */
+uint32_t drawRenderQueue(struct RenderQueue *queue, struct UniformRing *ring);
+
+void cleanupRenderQueue(struct RenderQueue *queue);
+
+#endif
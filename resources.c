@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "resources.h"
+
+/* few distinct resources are shared by many meshes, so lists are searched quickly enough */
+static struct Texture *textures;
+static struct Geometry *geometries;
+
+struct Texture *acquireTexture(const char *path)
+{
+	for (struct Texture *texture = textures; texture; texture = texture->next) {
+		if (strcmp(texture->path, path) == 0) {
+			texture->references++;
+			return texture;
+		}
+	}
+
+	struct Texture *texture = calloc(1, sizeof(struct Texture));
+	if (!texture) {
+		return NULL;
+	}
+	texture->path = malloc(strlen(path) + 1);
+	if (!texture->path) {
+		free(texture);
+		return NULL;
+	}
+	strcpy(texture->path, path);
+
+	int width, height, n;
+	unsigned char *imageData = stbi_load(path, &width, &height, &n, 0);
+	if (!imageData) {
+		fprintf(stderr, "Error loading texture %s.\n", path);
+		free(texture->path); free(texture);
+		return NULL;
+	}
+
+	glGenTextures(1, &texture->name);
+	glBindTexture(GL_TEXTURE_2D, texture->name);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	free(imageData);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+	texture->references = 1;
+	texture->next = textures;
+	textures = texture;
+	return texture;
+}
+
+void releaseTexture(struct Texture *texture)
+{
+	if (--texture->references) {
+		return;
+	}
+	struct Texture **link = &textures;
+	while (*link != texture) {
+		link = &(*link)->next;
+	}
+	*link = texture->next;
+
+	glDeleteTextures(1, &texture->name);
+	free(texture->path);
+	free(texture);
+}
+
+struct Geometry *acquireGeometry(enum GeometryShape shape, float size, GLint positionAttribLocation,
+	GLint vertexUVAttribLocation, GLint normalAttribLocation, GeometryBuilder build)
+{
+	// a VAO remembers which attributes it feeds, so geometry for another program is another geometry
+	for (struct Geometry *geometry = geometries; geometry; geometry = geometry->next) {
+		if (geometry->shape == shape && geometry->size == size &&
+			geometry->positionAttribLocation == positionAttribLocation &&
+			geometry->vertexUVAttribLocation == vertexUVAttribLocation &&
+			geometry->normalAttribLocation == normalAttribLocation) {
+			geometry->references++;
+			return geometry;
+		}
+	}
+
+	struct Geometry *geometry = calloc(1, sizeof(struct Geometry));
+	if (!geometry) {
+		return NULL;
+	}
+	geometry->shape = shape;
+	geometry->size = size;
+	geometry->positionAttribLocation = positionAttribLocation;
+	geometry->vertexUVAttribLocation = vertexUVAttribLocation;
+	geometry->normalAttribLocation = normalAttribLocation;
+	if (!build(geometry)) {
+		free(geometry);
+		return NULL;
+	}
+
+	geometry->references = 1;
+	geometry->next = geometries;
+	geometries = geometry;
+	return geometry;
+}
+
+void releaseGeometry(struct Geometry *geometry)
+{
+	if (--geometry->references) {
+		return;
+	}
+	struct Geometry **link = &geometries;
+	while (*link != geometry) {
+		link = &(*link)->next;
+	}
+	*link = geometry->next;
+
+	glDeleteVertexArrays(1, &geometry->VAO);
+	glDeleteBuffers(1, &geometry->vertexBuffer);
+	free(geometry);
+}
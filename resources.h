@@ -0,0 +1,56 @@
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+/*
+ * Reference counted GL resources shared between meshes. Textures are shared by
+ * path and primitive geometry by shape, size and attribute locations, so a
+ * thousand brick cubes decode and upload brick512.png once and hold one VAO
+ * between them. Everything here must be called from the thread that owns the
+ * GL context.
+ */
+
+struct Texture {
+	char *path;
+	GLuint name;
+	uint32_t references;
+	struct Texture *next;
+};
+
+enum GeometryShape {
+	GEOMETRY_SQUARE,
+	GEOMETRY_PYRAMID,
+	GEOMETRY_CUBE
+};
+
+struct Geometry {
+	enum GeometryShape shape;
+	float size;
+	GLint positionAttribLocation, vertexUVAttribLocation, normalAttribLocation;
+	GLuint VAO, vertexBuffer;
+	uint32_t numVertices;
+	float min[3], max[3], radius; /* as struct Mesh's */
+	uint32_t references;
+	struct Geometry *next;
+};
+
+/* fills in the VAO, vertex buffer, vertex count and bounds of a new geometry from its shape, size and attribute locations */
+typedef bool (*GeometryBuilder)(struct Geometry *geometry);
+
+/* the texture loaded from path, loading it on first use. NULL if it can't be loaded */
+struct Texture *acquireTexture(const char *path);
+
+/* drops a reference, the texture is deleted with the last one */
+void releaseTexture(struct Texture *texture);
+
+/* the matching geometry, made with build on first use. NULL if build fails */
+struct Geometry *acquireGeometry(enum GeometryShape shape, float size, GLint positionAttribLocation,
+	GLint vertexUVAttribLocation, GLint normalAttribLocation, GeometryBuilder build);
+
+void releaseGeometry(struct Geometry *geometry);
+
+#endif
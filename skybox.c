@@ -0,0 +1,104 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stb_image.h"
+
+#include "skybox.h"
+
+/* corner i is at x = bit 0, y = bit 1, z = bit 2, each -1 or 1 */
+static const float corners[] = {
+	-1.0f, -1.0f, -1.0f,
+	1.0f, -1.0f, -1.0f,
+	-1.0f, 1.0f, -1.0f,
+	1.0f, 1.0f, -1.0f,
+	-1.0f, -1.0f, 1.0f,
+	1.0f, -1.0f, 1.0f,
+	-1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f
+};
+
+static const uint8_t indices[] = {
+	0, 2, 6, 0, 6, 4, // -x
+	1, 5, 7, 1, 7, 3, // +x
+	0, 4, 5, 0, 5, 1, // -y
+	2, 3, 7, 2, 7, 6, // +y
+	0, 1, 3, 0, 3, 2, // -z
+	4, 6, 7, 4, 7, 5 // +z
+};
+
+static bool loadCubeMap(GLuint texture, const char *const *faces)
+{
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+	for (int i = 0; i < 6; i++) {
+		int width, height, n;
+		unsigned char *imageData = stbi_load(faces[i], &width, &height, &n, 3);
+		if (!imageData) {
+			fprintf(stderr, "Error loading skybox face %s.\n", faces[i]);
+			return false;
+		}
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE,
+			imageData);
+		free(imageData);
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	// no seams where faces meet
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+	return true;
+}
+
+struct Skybox *createSkybox(const char *const *faces, GLint positionAttribLocation)
+{
+	struct Skybox *skybox = calloc(1, sizeof(struct Skybox));
+	if (!skybox) {
+		return NULL;
+	}
+
+	glGenTextures(1, &skybox->texture);
+	if (!loadCubeMap(skybox->texture, faces)) {
+		glDeleteTextures(1, &skybox->texture);
+		free(skybox);
+		return NULL;
+	}
+
+	glGenVertexArrays(1, &skybox->VAO);
+	glBindVertexArray(skybox->VAO);
+
+	glGenBuffers(1, &skybox->vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, skybox->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glVertexAttribPointer(positionAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(positionAttribLocation);
+
+	glGenBuffers(1, &skybox->indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, skybox->indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+	return skybox;
+}
+
+void drawSkybox(struct Skybox *skybox)
+{
+	// the depth buffer is cleared to the far plane, which the sky is on
+	glDepthFunc(GL_LEQUAL);
+	glBindVertexArray(skybox->VAO);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, skybox->texture);
+	glDrawElements(GL_TRIANGLES, sizeof(indices), GL_UNSIGNED_BYTE, NULL);
+	glBindVertexArray(0);
+	glDepthFunc(GL_LESS);
+}
+
+void cleanupSkybox(struct Skybox *skybox)
+{
+	glDeleteVertexArrays(1, &skybox->VAO);
+	glDeleteBuffers(1, &skybox->vertexBuffer);
+	glDeleteBuffers(1, &skybox->indexBuffer);
+	glDeleteTextures(1, &skybox->texture);
+	free(skybox);
+}
@@ -0,0 +1,10 @@
+#version 140
+
+uniform samplerCube skyboxSampler;
+
+in vec3 direction;
+
+void main()
+{
+	gl_FragColor = texture(skyboxSampler, direction);
+}
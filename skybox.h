@@ -0,0 +1,24 @@
+#ifndef SKYBOX_H
+#define SKYBOX_H
+
+#include <GL/glew.h>
+
+/*
+ * A unit cube around the camera sampling one cube map texture. skybox.vert
+ * drops the view matrix's translation and puts every vertex on the far plane,
+ * so drawn last the sky only fills pixels nothing else covered.
+ */
+struct Skybox {
+	GLuint VAO, vertexBuffer, indexBuffer;
+	GLuint texture; /* GL_TEXTURE_CUBE_MAP */
+};
+
+/* faces are image paths in the order +x, -x, +y, -y, +z, -z. NULL if one can't be loaded */
+struct Skybox *createSkybox(const char *const *faces, GLint positionAttribLocation);
+
+/* program (built from skybox.vert) must be in use, with this frame's Frame uniform block bound */
+void drawSkybox(struct Skybox *skybox);
+
+void cleanupSkybox(struct Skybox *skybox);
+
+#endif
@@ -0,0 +1,23 @@
+#version 140
+
+// per frame, struct FrameUniforms
+layout(std140, row_major) uniform Frame {
+	mat4 projection;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	vec4 lightColour;
+	float lightIntensity;
+};
+
+in vec3 position;
+
+out vec3 direction;
+
+void main()
+{
+	direction = position;
+	// rotation only, the sky is always centred on the camera
+	vec4 clipPosition = projection * vec4(mat3(viewMatrix) * position, 1.0f);
+	// z = w puts it on the far plane
+	gl_Position = clipPosition.xyww;
+}
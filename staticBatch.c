@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "meshInstances.h"
+#include "staticBatch.h"
+#include "vertexFormat.h"
+
+bool staticBatchSupported(void)
+{
+	// commands with a baseInstance need GL_ARB_base_instance as well before 4.3
+	return GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+}
+
+static int compareTextures(const void *a, const void *b)
+{
+	const GLuint textureA = (*(struct Mesh *const *) a)->texture, textureB = (*(struct Mesh *const *) b)->texture;
+	return (textureA > textureB) - (textureA < textureB);
+}
+
+/* a bucket for each run of meshes with the same texture */
+static bool fillBuckets(struct StaticBatch *batch)
+{
+	batch->buckets = calloc(batch->numObjects, sizeof(struct StaticBatchBucket));
+	if (!batch->buckets) {
+		return false;
+	}
+	for (uint32_t i = 0; i < batch->numObjects; i++) {
+		const GLuint texture = batch->meshes[i]->texture;
+		if (!batch->numBuckets || batch->buckets[batch->numBuckets - 1].texture != texture) {
+			batch->buckets[batch->numBuckets].texture = texture;
+			batch->buckets[batch->numBuckets].firstObject = i;
+			batch->numBuckets++;
+		}
+		batch->buckets[batch->numBuckets - 1].numObjects++;
+	}
+	return true;
+}
+
+/* the commands drawing each object from the shared buffers, which need numVertices vertices and numIndices indices */
+static void fillObjectCommands(struct StaticBatch *batch, uint32_t *numVertices, uint32_t *numIndices)
+{
+	*numVertices = 0; *numIndices = 0;
+	for (uint32_t i = 0; i < batch->numObjects; i++) {
+		const struct Mesh *mesh = batch->meshes[i];
+		const struct DrawElementsIndirectCommand command = {
+			.count = mesh->indexBuffer ? mesh->numIndices : mesh->numVertices,
+			.instanceCount = 1,
+			.firstIndex = *numIndices,
+			.baseVertex = (GLint) *numVertices,
+			.baseInstance = i
+		};
+		batch->objectCommands[i] = command;
+		*numVertices += mesh->numVertices;
+		*numIndices += command.count;
+	}
+}
+
+/* copies the indices, generating them for non-indexed meshes */
+static bool copyIndices(struct StaticBatch *batch, uint32_t numIndices)
+{
+	glGenBuffers(1, &batch->indexBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, batch->indexBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, numIndices * sizeof(uint16_t), NULL, GL_STATIC_DRAW);
+
+	uint16_t *sequence = NULL;
+	uint32_t sequenceLength = 0;
+	for (uint32_t i = 0; i < batch->numObjects; i++) {
+		const struct Mesh *mesh = batch->meshes[i];
+		const struct DrawElementsIndirectCommand *command = &batch->objectCommands[i];
+		const GLintptr offset = command->firstIndex * sizeof(uint16_t);
+		if (mesh->indexBuffer) {
+			glBindBuffer(GL_COPY_READ_BUFFER, mesh->indexBuffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, offset,
+				command->count * sizeof(uint16_t));
+			continue;
+		}
+		if (command->count > sequenceLength) {
+			uint16_t *longer = realloc(sequence, command->count * sizeof(uint16_t));
+			if (!longer) {
+				free(sequence);
+				return false;
+			}
+			sequence = longer;
+			for (; sequenceLength < command->count; sequenceLength++) {
+				sequence[sequenceLength] = (uint16_t) sequenceLength;
+			}
+		}
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, command->count * sizeof(uint16_t), sequence);
+	}
+	free(sequence);
+	return true;
+}
+
+void refreshStaticBatch(struct StaticBatch *batch)
+{
+	glBindBuffer(GL_COPY_WRITE_BUFFER, batch->vertexBuffer);
+	for (uint32_t i = 0; i < batch->numObjects; i++) {
+		const struct Mesh *mesh = batch->meshes[i];
+		glBindBuffer(GL_COPY_READ_BUFFER, getMeshVertexBuffer(mesh));
+		const GLintptr offset = batch->objectCommands[i].baseVertex * sizeof(struct PackedVertex);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, offset,
+			mesh->numVertices * sizeof(struct PackedVertex));
+	}
+
+	struct CullBounds *b = &batch->bounds;
+	for (uint32_t i = 0; i < batch->numObjects; i++) {
+		float centre[3], extents[3];
+		getMeshWorldBounds(batch->meshes[i], centre, extents, &b->radius[i]);
+		b->x[i] = centre[0]; b->y[i] = centre[1]; b->z[i] = centre[2];
+		b->extentX[i] = extents[0]; b->extentY[i] = extents[1]; b->extentZ[i] = extents[2];
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, batch->instanceBuffer);
+	struct MeshInstance *instances = glMapBufferRange(GL_ARRAY_BUFFER, 0,
+		batch->numObjects * sizeof(struct MeshInstance), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!instances) {
+		fprintf(stderr, "Error mapping static batch instances.\n");
+		return;
+	}
+	for (uint32_t i = 0; i < batch->numObjects; i++) {
+		const struct Mesh *mesh = batch->meshes[i];
+		const struct MeshInstance instance = {.x = mesh->x, .y = mesh->y, .z = mesh->z, .rx = mesh->rx, .ry = mesh->ry};
+		instances[i] = instance;
+	}
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+}
+
+struct StaticBatch *createStaticBatch(struct Mesh **meshes, uint32_t numMeshes, GLuint program)
+{
+	if (!numMeshes) {
+		return NULL;
+	}
+	for (uint32_t i = 0; i < numMeshes; i++) {
+		const struct Mesh *mesh = meshes[i];
+		if (mesh->indexBuffer ? mesh->indexType != GL_UNSIGNED_SHORT : mesh->numVertices > UINT16_MAX + 1) {
+			fprintf(stderr, "Mesh %u can't be batched, it needs 16 bit indices.\n", i);
+			return NULL;
+		}
+	}
+
+	struct StaticBatch *batch = calloc(1, sizeof(struct StaticBatch));
+	if (!batch) {
+		return NULL;
+	}
+	batch->numObjects = numMeshes;
+	batch->meshes = malloc(numMeshes * sizeof(struct Mesh *));
+	batch->objectCommands = malloc(numMeshes * sizeof(struct DrawElementsIndirectCommand));
+	batch->commands = malloc(numMeshes * sizeof(struct DrawElementsIndirectCommand));
+	float *bounds = malloc(7 * numMeshes * sizeof(float));
+	batch->visible = malloc(numMeshes);
+	if (!batch->meshes || !batch->objectCommands || !batch->commands || !bounds || !batch->visible) {
+		free(batch->meshes); free(batch->objectCommands); free(batch->commands); free(bounds); free(batch->visible);
+		free(batch);
+		return NULL;
+	}
+	struct CullBounds *b = &batch->bounds;
+	b->x = bounds; b->y = b->x + numMeshes; b->z = b->y + numMeshes;
+	b->extentX = b->z + numMeshes; b->extentY = b->extentX + numMeshes; b->extentZ = b->extentY + numMeshes;
+	b->radius = b->extentZ + numMeshes;
+	b->count = numMeshes;
+
+	// a texture's objects next to each other, so each is one draw
+	for (uint32_t i = 0; i < numMeshes; i++) {
+		batch->meshes[i] = meshes[i];
+	}
+	qsort(batch->meshes, numMeshes, sizeof(struct Mesh *), compareTextures);
+	if (!fillBuckets(batch)) {
+		cleanupStaticBatch(batch);
+		return NULL;
+	}
+
+	uint32_t numVertices, numIndices;
+	fillObjectCommands(batch, &numVertices, &numIndices);
+	if (!copyIndices(batch, numIndices)) {
+		cleanupStaticBatch(batch);
+		return NULL;
+	}
+
+	glGenVertexArrays(1, &batch->VAO);
+	glBindVertexArray(batch->VAO);
+
+	glGenBuffers(1, &batch->vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, batch->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(struct PackedVertex), NULL, GL_STATIC_DRAW);
+	setPackedVertexAttribs(glGetAttribLocation(program, "position"), glGetAttribLocation(program, "vertexUV"),
+		glGetAttribLocation(program, "normal"));
+
+	glGenBuffers(1, &batch->instanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, batch->instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, numMeshes * sizeof(struct MeshInstance), NULL, GL_STATIC_DRAW);
+	setMeshInstanceAttribs(program);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->indexBuffer);
+
+	glBindVertexArray(0);
+
+	glGenBuffers(1, &batch->indirectBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch->indirectBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, numMeshes * sizeof(struct DrawElementsIndirectCommand), NULL,
+		GL_STREAM_DRAW);
+
+	refreshStaticBatch(batch);
+	return batch;
+}
+
+uint32_t drawStaticBatch(struct StaticBatch *batch, const float *frustumPlanes)
+{
+	const uint32_t numVisible = cullBounds(frustumPlanes, &batch->bounds, batch->visible);
+	batch->numCulled = batch->numObjects - numVisible;
+	if (!numVisible) {
+		return 0;
+	}
+
+	uint32_t numCommands = 0;
+	for (uint32_t i = 0; i < batch->numBuckets; i++) {
+		struct StaticBatchBucket *bucket = &batch->buckets[i];
+		bucket->firstCommand = numCommands;
+		for (uint32_t j = bucket->firstObject; j < bucket->firstObject + bucket->numObjects; j++) {
+			if (batch->visible[j]) {
+				batch->commands[numCommands++] = batch->objectCommands[j];
+			}
+		}
+		bucket->numCommands = numCommands - bucket->firstCommand;
+	}
+
+	// orphaned, so the GPU can still be reading last frame's commands
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch->indirectBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, batch->numObjects * sizeof(struct DrawElementsIndirectCommand), NULL,
+		GL_STREAM_DRAW);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, numCommands * sizeof(struct DrawElementsIndirectCommand),
+		batch->commands);
+
+	glBindVertexArray(batch->VAO);
+	for (uint32_t i = 0; i < batch->numBuckets; i++) {
+		const struct StaticBatchBucket *bucket = &batch->buckets[i];
+		if (!bucket->numCommands) {
+			continue;
+		}
+		glBindTexture(GL_TEXTURE_2D, bucket->texture);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT,
+			(void *) (bucket->firstCommand * sizeof(struct DrawElementsIndirectCommand)), bucket->numCommands, 0);
+	}
+	glBindVertexArray(0);
+	return numVisible;
+}
+
+void cleanupStaticBatch(struct StaticBatch *batch)
+{
+	glDeleteVertexArrays(1, &batch->VAO);
+	glDeleteBuffers(1, &batch->vertexBuffer);
+	glDeleteBuffers(1, &batch->indexBuffer);
+	glDeleteBuffers(1, &batch->instanceBuffer);
+	glDeleteBuffers(1, &batch->indirectBuffer);
+	free(batch->meshes);
+	free(batch->objectCommands);
+	free(batch->commands);
+	free(batch->buckets);
+	free(batch->bounds.x);
+	free(batch->visible);
+	free(batch);
+}
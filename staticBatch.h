@@ -0,0 +1,70 @@
+#ifndef STATIC_BATCH_H
+#define STATIC_BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+#include "culling.h"
+#include "mesh.h"
+
+/* the command glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER */
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+/* the batch's objects sharing one texture, which are next to each other */
+struct StaticBatchBucket {
+	GLuint texture;
+	uint32_t firstObject, numObjects;
+	uint32_t firstCommand, numCommands; /* of the visible objects, the last time the batch was drawn */
+};
+
+/*
+ * Meshes that never move, copied into one vertex and one index buffer and
+ * drawn with a glMultiDrawElementsIndirect per texture. Each frame the objects
+ * are culled and a command written for each that is visible, its baseInstance
+ * picking its struct MeshInstance out of the instance buffer for
+ * instancedLighting.vert, so the CPU's work per draw is per texture rather than
+ * per object. Needs GL 4.3 or GL_ARB_multi_draw_indirect with
+ * GL_ARB_base_instance.
+ */
+struct StaticBatch {
+	GLuint VAO;
+	GLuint vertexBuffer, indexBuffer; /* struct PackedVertex and 16 bit indices, offset by each command */
+	GLuint instanceBuffer, indirectBuffer;
+	struct Mesh **meshes; /* by object, sorted by texture */
+	struct DrawElementsIndirectCommand *objectCommands; /* the command drawing each object */
+	struct DrawElementsIndirectCommand *commands; /* the visible objects' commands, by bucket */
+	struct StaticBatchBucket *buckets;
+	uint32_t numObjects, numBuckets;
+	struct CullBounds bounds; /* world bounds of each object */
+	uint8_t *visible;
+	uint32_t numCulled; /* objects the last drawStaticBatch found off screen */
+};
+
+/* whether the GL can draw a batch */
+bool staticBatchSupported(void);
+
+/*
+ * Copies the meshes, where they are now, into a batch drawn with program
+ * (built from instancedLighting.vert). They must have struct PackedVertex
+ * vertices, as the primitives and terrain chunks do, and 16 bit indices or
+ * none, and outlive the batch. NULL if they don't or there's no memory.
+ */
+struct StaticBatch *createStaticBatch(struct Mesh **meshes, uint32_t numMeshes, GLuint program);
+
+/* copies the meshes' vertices and bounds again, after their vertex buffers have been updated */
+void refreshStaticBatch(struct StaticBatch *batch);
+
+/* culls the objects against frustumPlanes and draws the rest, returns the number of objects drawn */
+uint32_t drawStaticBatch(struct StaticBatch *batch, const float *frustumPlanes);
+
+void cleanupStaticBatch(struct StaticBatch *batch);
+
+#endif
@@ -1,100 +1,567 @@
+#include <math.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "stb_image.h"
 
 #include "file.h"
+#include "heightmap.h"
 #include "maths.h"
+#include "noise.h"
+#include "parallel.h"
+#include "quantizedHeightmap.h"
+#include "renderQueue.h"
 #include "terrain.h"
+#include "terrainGPU.h"
+#include "terrainLOD.h"
+#include "terrainRay.h"
+#include "terrainStream.h"
 #include "utils.h"
 
-float heightmapGet(float *heightmap, uint32_t size, float x, float z)
+float terrainGetHeightAt(struct Terrain *t, float x, float z)
 {
-	int i = x + z * size;
-	if (i < 0 || i > (size * size - 1))
-		return 0;
-	return heightmap[i];
+	if (t->stream) {
+		return terrainStreamGetHeightAt(t, x, z);
+	}
+
+	float height;
+	terrainGetHeightsAt(t, &x, &z, 1, &height, NULL, NULL);
+	return height;
 }
 
-float terrainGetHeightAt(struct Terrain *t, float x, float z)
+void cleanupTerrain(struct Terrain *terrain)
 {
-	float cameraXTerrainSpace = x - t->mesh->x, cameraZTerrainSpace = z - t->mesh->z;
-	cameraXTerrainSpace /= t->scale;
-	cameraZTerrainSpace /= t->scale;
+	if (terrain->stream) {
+		cleanupTerrainStream(terrain->stream);
+	}
+	for (uint32_t i = 0; i < terrain->numChunks * terrain->numChunks; i++) {
+		struct Mesh *mesh = terrain->chunks[i].mesh;
+		if (!mesh) {
+			continue;
+		}
+		// shared between chunks, deleted below
+		mesh->texture = 0;
+		mesh->indexBuffer = 0;
+		CleanupMesh(mesh);
+	}
+	if (terrain->lod) {
+		cleanupTerrainLOD(terrain->lod);
+	}
+	if (terrain->gpu) {
+		cleanupTerrainGPU(terrain->gpu);
+	}
+	if (terrain->pyramid) {
+		cleanupTerrainPyramid(terrain->pyramid);
+	}
+	glDeleteBuffers(4, terrain->chunkIndexBuffers);
+	glDeleteTextures(1, &terrain->texture);
+	free(terrain->chunks);
+	freeTerrainHeightmap(terrain);
+}
 
-	/*
-		h0 x----x h1
-		   |    |
-		   |    |
-		h2 x----x h3
-	*/
+void freeTerrainHeightmap(struct Terrain *terrain)
+{
+	if (terrain->heightmapFile) {
+		closeHeightmapFile(terrain->heightmapFile);
+	} else {
+		free(terrain->heightmap);
+	}
+	if (terrain->quantized) {
+		freeQuantizedHeightmap(terrain->quantized);
+	}
+	free(terrain);
+}
 
-	int gx = (int) cameraXTerrainSpace, gz = (int) cameraZTerrainSpace;
+uint32_t queueTerrain(struct Terrain *t, struct RenderQueue *queue, uint32_t program)
+{
+	if (t->stream) {
+		return queueTerrainStream(t, queue, program);
+	}
 
-	float h0 = heightmapGet(t->heightmap, t->size, gx, gz);
-	float h1 = heightmapGet(t->heightmap, t->size, gx + 1, gz);
-	float h2 = heightmapGet(t->heightmap, t->size, gx, gz + 1);
-	float h3 = heightmapGet(t->heightmap, t->size, gx + 1, gz + 1);
+	struct Mesh *mesh;
+	for (uint32_t i = 0; i < t->numChunks * t->numChunks; i++) {
+		getTerrainChunkMeshes(t, i, 1, &mesh);
+		queueMesh(queue, RENDER_PASS_OPAQUE, program, mesh);
+	}
+	return t->numChunks * t->numChunks;
+}
 
-	if (cameraXTerrainSpace <= 1 - cameraZTerrainSpace) {
-		// upper tri
-		return barycentric(gx + 1, h1, gz, gx, h0, gz, gx, h2, gz + 1, cameraXTerrainSpace, cameraZTerrainSpace);
-	} else {
-		// lower tri
-		return barycentric(gx + 1, h1, gz, gx, h2, gz + 1, gx + 1, h3, gz + 1, cameraXTerrainSpace, cameraZTerrainSpace);
+uint32_t getTerrainChunkMeshes(struct Terrain *t, uint32_t first, uint32_t count, struct Mesh **meshes)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		struct TerrainChunk *chunk = &t->chunks[first + i];
+		// chunk vertices are relative to the chunk's corner
+		chunk->mesh->x = t->x + chunk->min[0]; chunk->mesh->y = t->y; chunk->mesh->z = t->z + chunk->min[2];
+		meshes[i] = chunk->mesh;
 	}
+	return count;
 }
 
-void cleanupTerrain(struct Terrain *terrain)
+/* the (unnormalised) normal of the triangle between grid points a, b and c, added to normal */
+static void accumulateFaceNormal(const struct Terrain *t, float *normal, uint32_t ax, uint32_t az, uint32_t bx,
+	uint32_t bz, uint32_t cx, uint32_t cz)
 {
-	CleanupMesh(terrain->mesh);
-	free(terrain->heightmap);
-	free(terrain);
+	const float ha = t->heightmap[getTerrainSampleIndex(t, ax, az)];
+	const float hb = t->heightmap[getTerrainSampleIndex(t, bx, bz)];
+	const float hc = t->heightmap[getTerrainSampleIndex(t, cx, cz)];
+	const float pax = (float) ax * t->scale, paz = (float) az * t->scale;
+	const float pbx = (float) bx * t->scale, pbz = (float) bz * t->scale;
+	const float pcx = (float) cx * t->scale, pcz = (float) cz * t->scale;
+
+	float nx, ny, nz;
+	crossProduct(pbx - pax, hb - ha, pbz - paz, pcx - pax, hc - ha, pcz - paz, &nx, &ny, &nz);
+
+	normal[0] += nx; normal[1] += ny; normal[2] += nz;
+}
+
+struct TerrainNormalsJob {
+	const struct Terrain *t;
+	float *normals;
+};
+
+/*
+	0 x----x 1
+	  |  / |
+	  | /  |
+	2 x----x 3
+
+	Each quad is split into triangles (1, 0, 2) and (1, 2, 3). Every vertex
+	sums the faces around it itself, in a fixed order, so any set of vertices
+	can be done on any thread and still give the same bits.
+*/
+static void computeTerrainNormal(const struct Terrain *t, uint32_t x, uint32_t y, float *normal)
+{
+	const uint32_t last = t->size - 1;
+	normal[0] = normal[1] = normal[2] = 0.0f;
+	if (x > 0 && y > 0) {
+		// vertex 3 of the quad up and to the left
+		accumulateFaceNormal(t, normal, x, y - 1, x - 1, y, x, y);
+	}
+	if (x < last && y > 0) {
+		// vertex 2 of the quad above
+		accumulateFaceNormal(t, normal, x + 1, y - 1, x, y - 1, x, y);
+		accumulateFaceNormal(t, normal, x + 1, y - 1, x, y, x + 1, y);
+	}
+	if (x > 0 && y < last) {
+		// vertex 1 of the quad to the left
+		accumulateFaceNormal(t, normal, x, y, x - 1, y, x - 1, y + 1);
+		accumulateFaceNormal(t, normal, x, y, x - 1, y + 1, x, y + 1);
+	}
+	if (x < last && y < last) {
+		// vertex 0 of its own quad
+		accumulateFaceNormal(t, normal, x + 1, y, x, y, x, y + 1);
+	}
+	// face normals are area weighted, normalising the sum gives the smooth vertex normal
+	normalise(normal);
 }
 
-/* for a size * size grid, returns the number of triangles */
-uint32_t getTerrainMeshNumTris(uint32_t size)
+static bool computeTerrainNormalRows(void *arg, uint32_t begin, uint32_t end)
 {
-	uint32_t numTris = 2;
-	for (uint32_t i = 3; i <= size; i++) {
-		numTris += 2 * ((i - 1) + (i - 2));
+	const struct TerrainNormalsJob *job = arg;
+	const uint32_t size = job->t->size;
+	for (uint32_t y = begin; y < end; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			computeTerrainNormal(job->t, x, y, &job->normals[(x + y * size) * 3]);
+		}
 	}
-	return numTris;
+	return true;
 }
 
-struct Terrain *generateTerrain(uint32_t size, GLint positionAttribLocation, GLint vertexUVAttribLocation,
-	GLint normalAttribLocation, const char *texture, unsigned int seed, const char *map, float scale)
+/* smooth per-sample normals for the whole heightmap, row-major whatever its layout, so that chunk edges match up */
+static float *computeTerrainNormals(const struct Terrain *t)
 {
-	float *heightmap = calloc(size * size, sizeof(float));
-	if (!heightmap) {
+	struct TerrainNormalsJob job = {.t = t, .normals = malloc((size_t) t->size * t->size * 3 * sizeof(float))};
+	if (!job.normals) {
 		return NULL;
 	}
+	parallelFor(t->size, computeTerrainNormalRows, &job);
+	return job.normals;
+}
+
+/*
+ * Chunks are all TERRAIN_CHUNK_SIZE quads wide except along the far edges, so
+ * there are at most four distinct index patterns. They are created on demand
+ * and must be bound while the chunk's VAO is bound.
+ */
+static GLuint getChunkIndexBuffer(struct Terrain *t, uint32_t width, uint32_t depth)
+{
+	GLuint *buffer = &t->chunkIndexBuffers[(width != TERRAIN_CHUNK_SIZE) + 2 * (depth != TERRAIN_CHUNK_SIZE)];
+	if (*buffer) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *buffer);
+		return *buffer;
+	}
+
+	uint16_t *indices = malloc(width * depth * 6 * sizeof(uint16_t));
+	if (!indices) {
+		return 0;
+	}
+
+	uint32_t indicesIndex = 0, stride = width + 1;
+	for (uint32_t y = 0; y < depth; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			uint16_t i0 = x + y * stride, i1 = i0 + 1, i2 = i0 + stride, i3 = i2 + 1;
+			indices[indicesIndex++] = i1; indices[indicesIndex++] = i0; indices[indicesIndex++] = i2;
+			indices[indicesIndex++] = i1; indices[indicesIndex++] = i2; indices[indicesIndex++] = i3;
+		}
+	}
+
+	glGenBuffers(1, buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *buffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesIndex * sizeof(uint16_t), indices, GL_STATIC_DRAW);
+	free(indices);
+	return *buffer;
+}
+
+uint32_t getTerrainNumChunks(uint32_t size)
+{
+	return (size - 1 + TERRAIN_CHUNK_SIZE - 1) / TERRAIN_CHUNK_SIZE;
+}
+
+static bool prepareTerrainChunk(struct Terrain *t, const float *normals, uint32_t cx, uint32_t cz,
+	struct TerrainChunkData *data)
+{
+	const uint32_t x0 = cx * TERRAIN_CHUNK_SIZE, z0 = cz * TERRAIN_CHUNK_SIZE;
+	const uint32_t width = t->size - 1 - x0 < TERRAIN_CHUNK_SIZE ? t->size - 1 - x0 : TERRAIN_CHUNK_SIZE;
+	const uint32_t depth = t->size - 1 - z0 < TERRAIN_CHUNK_SIZE ? t->size - 1 - z0 : TERRAIN_CHUNK_SIZE;
+	const uint32_t numVertices = (width + 1) * (depth + 1);
+
+	data->width = width;
+	data->depth = depth;
+	data->vertices = malloc(numVertices * sizeof(struct PackedVertex));
+	if (!data->vertices) {
+		return false;
+	}
+
+	float minHeight = t->heightmap[getTerrainSampleIndex(t, x0, z0)], maxHeight = minHeight;
+	uint32_t v = 0;
+	for (uint32_t z = z0; z <= z0 + depth; z++) {
+		for (uint32_t x = x0; x <= x0 + width; x++, v++) {
+			uint32_t i = x + z * t->size;
+			float h = t->heightmap[getTerrainSampleIndex(t, x, z)];
+			minHeight = fminf(minHeight, h);
+			maxHeight = fmaxf(maxHeight, h);
+
+			// a plane of heightmap is z plane
+			const float position[] = {(float) (x - x0) * t->scale, h, (float) (z - z0) * t->scale};
+			// texture repeats once per grid cell
+			packVertex(&data->vertices[v], position, &normals[i * 3], (float) (x - x0), (float) (z - z0));
+		}
+	}
+
+	data->min[0] = (float) x0 * t->scale; data->min[1] = minHeight; data->min[2] = (float) z0 * t->scale;
+	data->max[0] = (float) (x0 + width) * t->scale; data->max[1] = maxHeight;
+	data->max[2] = (float) (z0 + depth) * t->scale;
+	return true;
+}
+
+/* the chunk's bounds relative to its mesh, which is placed at the chunk's corner and the terrain's height */
+static void setChunkMeshBounds(struct TerrainChunk *chunk)
+{
+	const float min[] = {0.0f, chunk->min[1], 0.0f};
+	const float max[] = {chunk->max[0] - chunk->min[0], chunk->max[1], chunk->max[2] - chunk->min[2]};
+	setMeshBounds(chunk->mesh, min, max);
+}
+
+static bool uploadTerrainChunk(struct Terrain *t, struct TerrainChunk *chunk, const struct TerrainChunkData *data,
+	GLint positionAttribLocation, GLint vertexUVAttribLocation, GLint normalAttribLocation)
+{
+	const uint32_t numVertices = (data->width + 1) * (data->depth + 1);
 
 	struct Mesh *mesh = calloc(1, sizeof(struct Mesh));
 	if (!mesh) {
-		free(heightmap);
+		return false;
+	}
+	chunk->mesh = mesh;
+	memcpy(chunk->min, data->min, sizeof(chunk->min));
+	memcpy(chunk->max, data->max, sizeof(chunk->max));
+	setChunkMeshBounds(chunk);
+
+	mesh->numVertices = numVertices;
+	mesh->numIndices = data->width * data->depth * 6;
+	mesh->indexType = GL_UNSIGNED_SHORT;
+	mesh->texture = t->texture;
+
+	glGenVertexArrays(1, &mesh->VAO);
+	glBindVertexArray(mesh->VAO);
+
+	glGenBuffers(1, &mesh->vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(struct PackedVertex), data->vertices, GL_STATIC_DRAW);
+	setPackedVertexAttribs(positionAttribLocation, vertexUVAttribLocation, normalAttribLocation);
+
+	mesh->indexBuffer = getChunkIndexBuffer(t, data->width, data->depth);
+
+	glBindVertexArray(0);
+	return mesh->indexBuffer != 0;
+}
+
+void freeTerrainChunkData(struct TerrainChunkData *data, uint32_t numChunks)
+{
+	for (uint32_t i = 0; i < numChunks * numChunks; i++) {
+		free(data[i].vertices);
+	}
+	free(data);
+}
+
+struct TerrainChunksJob {
+	struct Terrain *t;
+	const float *normals;
+	struct TerrainChunkData *data;
+	uint32_t numChunks;
+};
+
+static bool prepareTerrainChunkRows(void *arg, uint32_t begin, uint32_t end)
+{
+	const struct TerrainChunksJob *job = arg;
+	for (uint32_t cz = begin; cz < end; cz++) {
+		for (uint32_t cx = 0; cx < job->numChunks; cx++) {
+			if (!prepareTerrainChunk(job->t, job->normals, cx, cz, &job->data[cx + cz * job->numChunks])) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static struct TerrainChunkData *prepareTerrainChunksWithNormals(struct Terrain *t, const float *normals)
+{
+	const uint32_t numChunks = getTerrainNumChunks(t->size);
+	struct TerrainChunkData *data = calloc(numChunks * numChunks, sizeof(struct TerrainChunkData));
+	if (!data) {
+		return NULL;
+	}
+
+	// every chunk has its own output arrays, so rows of chunks are meshed in parallel
+	struct TerrainChunksJob job = {.t = t, .normals = normals, .data = data, .numChunks = numChunks};
+	if (!parallelFor(numChunks, prepareTerrainChunkRows, &job)) {
+		freeTerrainChunkData(data, numChunks);
+		return NULL;
+	}
+	return data;
+}
+
+struct TerrainChunkData *prepareTerrainChunks(struct Terrain *t)
+{
+	if (!t->heightmap) {
+		return NULL;
+	}
+	float *normals = computeTerrainNormals(t);
+	if (!normals) {
+		return NULL;
+	}
+	struct TerrainChunkData *data = prepareTerrainChunksWithNormals(t, normals);
+	free(normals);
+	return data;
+}
+
+struct TerrainChunkData *prepareTerrainChunksWithApron(struct Terrain *t, const float *apron)
+{
+	if (!t->heightmap) {
+		return NULL;
+	}
+	// normals of the bordered map, whose inner samples see the faces on both sides of the edges
+	const uint32_t size = t->size, apronSize = size + 2;
+	const struct Terrain bordered = {.heightmap = (float *) apron, .size = apronSize, .scale = t->scale};
+	float *apronNormals = computeTerrainNormals(&bordered);
+	float *normals = malloc((size_t) size * size * 3 * sizeof(float));
+	if (!apronNormals || !normals) {
+		free(apronNormals);
+		free(normals);
+		return NULL;
+	}
+	for (uint32_t z = 0; z < size; z++) {
+		memcpy(&normals[(size_t) z * size * 3], &apronNormals[(1 + (size_t) (z + 1) * apronSize) * 3],
+			size * 3 * sizeof(float));
+	}
+	free(apronNormals);
+
+	struct TerrainChunkData *data = prepareTerrainChunksWithNormals(t, normals);
+	free(normals);
+	return data;
+}
+
+bool uploadTerrainChunks(struct Terrain *t, const struct TerrainChunkData *data, GLint positionAttribLocation,
+	GLint vertexUVAttribLocation, GLint normalAttribLocation)
+{
+	const uint32_t numChunks = getTerrainNumChunks(t->size);
+	t->chunks = calloc(numChunks * numChunks, sizeof(struct TerrainChunk));
+	if (!t->chunks) {
+		return false;
+	}
+	t->numChunks = numChunks;
+
+	for (uint32_t i = 0; i < numChunks * numChunks; i++) {
+		if (!uploadTerrainChunk(t, &t->chunks[i], &data[i], positionAttribLocation, vertexUVAttribLocation,
+			normalAttribLocation)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* rewrites the vertices of a chunk between global samples (x0, z0) and (x1, z1), which must lie inside it */
+static bool updateTerrainChunk(struct Terrain *t, uint32_t cx, uint32_t cz, uint32_t x0, uint32_t z0, uint32_t x1,
+	uint32_t z1)
+{
+	struct TerrainChunk *chunk = &t->chunks[cx + cz * t->numChunks];
+	const uint32_t chunkX = cx * TERRAIN_CHUNK_SIZE, chunkZ = cz * TERRAIN_CHUNK_SIZE;
+	const uint32_t width = t->size - 1 - chunkX < TERRAIN_CHUNK_SIZE ? t->size - 1 - chunkX : TERRAIN_CHUNK_SIZE;
+	const uint32_t depth = t->size - 1 - chunkZ < TERRAIN_CHUNK_SIZE ? t->size - 1 - chunkZ : TERRAIN_CHUNK_SIZE;
+	const uint32_t stride = width + 1;
+
+	// vertices are stored row by row, so one contiguous range covers the rectangle
+	const uint32_t first = (x0 - chunkX) + (z0 - chunkZ) * stride, last = (x1 - chunkX) + (z1 - chunkZ) * stride;
+	const uint32_t count = last - first + 1;
+	// texture coordinates are rewritten along with the rest of each interleaved vertex
+	struct PackedVertex *vertices = malloc(count * sizeof(struct PackedVertex));
+	if (!vertices) {
+		return false;
+	}
+	for (uint32_t v = 0; v < count; v++) {
+		const uint32_t lx = (first + v) % stride, lz = (first + v) / stride;
+		const float position[] = {
+			(float) lx * t->scale, t->heightmap[getTerrainSampleIndex(t, chunkX + lx, chunkZ + lz)],
+			(float) lz * t->scale
+		};
+		float normal[3];
+		computeTerrainNormal(t, chunkX + lx, chunkZ + lz, normal);
+		packVertex(&vertices[v], position, normal, (float) lx, (float) lz);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, chunk->mesh->vertexBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(struct PackedVertex), count * sizeof(struct PackedVertex),
+		vertices);
+	free(vertices);
+
+	// the edit may have lowered the highest point as well as raised it, so the chunk is rescanned
+	float minHeight = t->heightmap[getTerrainSampleIndex(t, chunkX, chunkZ)], maxHeight = minHeight;
+	for (uint32_t z = chunkZ; z <= chunkZ + depth; z++) {
+		for (uint32_t x = chunkX; x <= chunkX + width; x++) {
+			minHeight = fminf(minHeight, t->heightmap[getTerrainSampleIndex(t, x, z)]);
+			maxHeight = fmaxf(maxHeight, t->heightmap[getTerrainSampleIndex(t, x, z)]);
+		}
+	}
+	chunk->min[1] = minHeight;
+	chunk->max[1] = maxHeight;
+	setChunkMeshBounds(chunk);
+	return true;
+}
+
+void updateTerrainRegion(struct Terrain *t, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1)
+{
+	if (!t->heightmap || x0 > x1 || z0 > z1 || x0 >= t->size || z0 >= t->size) {
+		return;
+	}
+	x1 = x1 < t->size - 1 ? x1 : t->size - 1;
+	z1 = z1 < t->size - 1 ? z1 : t->size - 1;
+
+	// the file's tile bounds describe the heights as they were on disk
+	if (t->heightmapFile) {
+		t->heightmapFile->minMax = NULL;
+	}
+	if (t->pyramid) {
+		updateTerrainPyramid(t, x0, z0, x1, z1);
+	}
+	if (t->lod) {
+		updateTerrainLOD(t, x0, z0, x1, z1);
+	}
+	if (t->gpu) {
+		updateTerrainGPU(t, x0, z0, x1, z1);
+	}
+	if (!t->chunks) {
+		return;
+	}
+
+	// the normals of neighbouring samples change too
+	const uint32_t nx0 = x0 ? x0 - 1 : 0, nz0 = z0 ? z0 - 1 : 0;
+	const uint32_t nx1 = x1 + 1 < t->size ? x1 + 1 : x1, nz1 = z1 + 1 < t->size ? z1 + 1 : z1;
+
+	// samples on a chunk edge belong to the chunks either side
+	const uint32_t last = t->numChunks - 1;
+	const uint32_t cx0 = nx0 ? (nx0 - 1) / TERRAIN_CHUNK_SIZE : 0, cz0 = nz0 ? (nz0 - 1) / TERRAIN_CHUNK_SIZE : 0;
+	const uint32_t cx1 = nx1 / TERRAIN_CHUNK_SIZE < last ? nx1 / TERRAIN_CHUNK_SIZE : last;
+	const uint32_t cz1 = nz1 / TERRAIN_CHUNK_SIZE < last ? nz1 / TERRAIN_CHUNK_SIZE : last;
+	for (uint32_t cz = cz0; cz <= cz1; cz++) {
+		for (uint32_t cx = cx0; cx <= cx1; cx++) {
+			const uint32_t chunkX = cx * TERRAIN_CHUNK_SIZE, chunkZ = cz * TERRAIN_CHUNK_SIZE;
+			const uint32_t ux0 = nx0 > chunkX ? nx0 : chunkX, uz0 = nz0 > chunkZ ? nz0 : chunkZ;
+			const uint32_t ux1 = nx1 < chunkX + TERRAIN_CHUNK_SIZE ? nx1 : chunkX + TERRAIN_CHUNK_SIZE;
+			const uint32_t uz1 = nz1 < chunkZ + TERRAIN_CHUNK_SIZE ? nz1 : chunkZ + TERRAIN_CHUNK_SIZE;
+			if (ux0 <= ux1 && uz0 <= uz1 && !updateTerrainChunk(t, cx, cz, ux0, uz0, ux1, uz1)) {
+				fprintf(stderr, "Could not update terrain chunk %u, %u.\n", cx, cz);
+			}
+		}
+	}
+}
+
+static struct Terrain *mapTerrainHeightmap(uint32_t size, const char *map, float scale)
+{
+	struct HeightmapFile *file = openHeightmapFile(map);
+	if (!file) {
+		fprintf(stderr, "Could not load height map %s.\n", map);
+		return NULL;
+	}
+	if (file->header->width != size || file->header->height != size) {
+		fprintf(stderr, "Height map %s is %ux%u, expected %ux%u.\n", map, file->header->width,
+			file->header->height, size, size);
+		closeHeightmapFile(file);
+		return NULL;
+	}
+	// the samples' spacing is part of the map, loaded at another it would come out the wrong size
+	if (file->header->scale != scale) {
+		fprintf(stderr, "Height map %s was made for a scale of %g, expected %g.\n", map, file->header->scale, scale);
+		closeHeightmapFile(file);
+		return NULL;
+	}
+
+	struct Terrain *terrain = calloc(1, sizeof(struct Terrain));
+	if (!terrain) {
+		closeHeightmapFile(file);
+		return NULL;
+	}
+
+	terrain->heightmap = file->samples;
+	terrain->heightmapFile = file;
+	terrain->size = size;
+	terrain->scale = scale;
+	return terrain;
+}
+
+struct Terrain *loadTerrainHeightmap(uint32_t size, const char *map, float scale)
+{
+	if (isHeightmapFile(map)) {
+		return mapTerrainHeightmap(size, map, scale);
+	}
+
+	float *heightmap = calloc(size * size, sizeof(float));
+	if (!heightmap) {
 		return NULL;
 	}
 
 	struct Terrain *terrain = calloc(1, sizeof(struct Terrain));
 	if (!terrain) {
 		free(heightmap);
-		free(mesh);
 		return NULL;
 	}
 
 	terrain->heightmap = heightmap;
-	terrain->mesh = mesh;
 	terrain->size = size;
 	terrain->scale = scale;
 
 	int mapWidth, mapHeight, nn;
 	int x, y;
 
-	unsigned char *hmap = stbi_load(map, &mapWidth, &mapHeight, &nn, 0);
+	unsigned char *hmap = stbi_load(map, &mapWidth, &mapHeight, &nn, 1);
 	if (!hmap) {
-		fprintf(stderr, "Could not load height map.\n");
-		free(heightmap); free(mesh); free(terrain);
+		fprintf(stderr, "Could not load height map %s.\n", map);
+		free(heightmap); free(terrain);
+		return NULL;
+	}
+	if (mapWidth != size || mapHeight != size) {
+		fprintf(stderr, "Height map %s is %dx%d, expected %ux%u.\n", map, mapWidth, mapHeight, size, size);
+		free(hmap); free(heightmap); free(terrain);
 		return NULL;
 	}
 	// generate
@@ -105,147 +572,146 @@ struct Terrain *generateTerrain(uint32_t size, GLint positionAttribLocation, GLi
 	}
 	free(hmap);
 
-	// produce mesh
-	uint32_t numTris = getTerrainMeshNumTris(size);
+	return terrain;
+}
 
-	float *positions = malloc(numTris * 9 * sizeof(float)); // 3 floats per vertex
-	if (!positions) {
-		free(heightmap); free(mesh); free(terrain);
-		return NULL;
+bool compactTerrainHeightmap(struct Terrain *t, float precision)
+{
+	if (t->stream || !t->heightmap) {
+		return false;
 	}
-	float *textureCoordinates = malloc(numTris * 6 * sizeof(float)); // 2 floats per vertex
-	if (!textureCoordinates) {
-		free(heightmap); free(mesh); free(terrain); free(positions);
-		return NULL;
+	// quantizing reads rows
+	if (t->tiled && !setTerrainHeightmapTiled(t, false)) {
+		return false;
 	}
-	float *normals = malloc(numTris * 9 * sizeof(float));
-	if (!normals) {
-		free(heightmap); free(mesh); free(terrain); free(positions); free(textureCoordinates);
-		return NULL;
-	}
-
-	mesh->numVertices = numTris * 3;
-
-	uint32_t positionsIndex = 0, textureCoordinatesIndex = 0, normalsIndex = 0;
-	for (y = 0; y < size; y++) {
-		for (x = 0; x < size; x++) {
-			if (x < size - 1 && y < size - 1) {
-				// 0
-				positions[positionsIndex++] = (float) x + 1.0f;
-				positions[positionsIndex++] = heightmap[x + 1 + y * size];
-				positions[positionsIndex++] = (float) y; // a plane of heightmap is z plane
-				textureCoordinates[textureCoordinatesIndex++] = 1.0f;
-				textureCoordinates[textureCoordinatesIndex++] = 0.0f;
-
-				// 1
-				positions[positionsIndex++] = (float) x;
-				positions[positionsIndex++] = heightmap[x + y * size];
-				positions[positionsIndex++] = (float) y; // a plane of heightmap is z plane
-				textureCoordinates[textureCoordinatesIndex++] = 0.0f;
-				textureCoordinates[textureCoordinatesIndex++] = 0.0f;
-
-				// 2
-				positions[positionsIndex++] = (float) x;
-				positions[positionsIndex++] = heightmap[x + (y + 1) * size];
-				positions[positionsIndex++] = (float) y + 1.0f; // a plane of heightmap is z plane
-				textureCoordinates[textureCoordinatesIndex++] = 0.0f;
-				textureCoordinates[textureCoordinatesIndex++] = 1.0f;
-
-				float ux = (float) x - (float) (x + 1);
-				float uy = heightmap[x + y * size] - heightmap[x + 1 + y * size];
-				float uz = (float) y - (float) y;
-
-				float vx = (float) x - (x + 1.0f);
-				float vy = heightmap[x + (y + 1) * size] - heightmap[x + 1 + y * size];
-				float vz = (float) (y + 1) - (float) y;
-
-				float nx, ny, nz;
-				crossProduct(ux, uy, uz, vx, vy, vz, &nx, &ny, &nz);
-
-				normals[normalsIndex++] = nx; normals[normalsIndex++] = ny; normals[normalsIndex++] = nz;
-				normals[normalsIndex++] = nx; normals[normalsIndex++] = ny; normals[normalsIndex++] = nz;
-				normals[normalsIndex++] = nx; normals[normalsIndex++] = ny; normals[normalsIndex++] = nz;
-			}
-			if (x > 0 && y < size - 1) {
-				positions[positionsIndex++] = (float) x;
-				positions[positionsIndex++] = heightmap[x + y * size];
-				positions[positionsIndex++] = (float) y; // plane of heightmap is z plane
-				textureCoordinates[textureCoordinatesIndex++] = 1.0f;
-				textureCoordinates[textureCoordinatesIndex++] = 0.0f;
-
-				positions[positionsIndex++] = (float) x - 1.0f;
-				positions[positionsIndex++] = heightmap[x - 1 + (y + 1) * size];
-				positions[positionsIndex++] = (float) y + 1.0f; // plane of heightmap is z plane
-				textureCoordinates[textureCoordinatesIndex++] = 0.0f;
-				textureCoordinates[textureCoordinatesIndex++] = 1.0f;
-
-				positions[positionsIndex++] = (float) x;
-				positions[positionsIndex++] = heightmap[x + (y + 1) * size];
-				positions[positionsIndex++] = (float) y + 1.0f; // plane of heightmap is z plane
-				textureCoordinates[textureCoordinatesIndex++] = 1.0f;
-				textureCoordinates[textureCoordinatesIndex++] = 1.0f;
-
-				float ux = (float) (x - 1.0f) - (float) x;
-				float uy = heightmap[x - 1 + (y + 1) * size] - heightmap[x + y * size];
-				float uz = (float) (y + 1.0f) - (float) y;
-
-				float vx = (float) x - (float) x;
-				float vy = heightmap[x + (y + 1) * size] - heightmap[x + y * size];
-				float vz = (float) (y + 1.0f) - (float) y;
-
-				float nx, ny, nz;
-				crossProduct(ux, uy, uz, vx, vy, vz, &nx, &ny, &nz);
-
-				normals[normalsIndex++] = nx; normals[normalsIndex++] = ny; normals[normalsIndex++] = nz;
-				normals[normalsIndex++] = nx; normals[normalsIndex++] = ny; normals[normalsIndex++] = nz;
-				normals[normalsIndex++] = nx; normals[normalsIndex++] = ny; normals[normalsIndex++] = nz;
+	struct QuantizedHeightmap *quantized = quantizeHeightmap(t->heightmap, t->size, precision);
+	if (!quantized) {
+		return false;
+	}
+	if (t->heightmapFile) {
+		closeHeightmapFile(t->heightmapFile);
+		t->heightmapFile = NULL;
+	} else {
+		free(t->heightmap);
+	}
+	t->heightmap = NULL;
+	t->quantized = quantized;
+	return true;
+}
 
-			}
+bool setTerrainHeightmapTiled(struct Terrain *t, bool tiled)
+{
+	if (!t->heightmap || t->lod || t->gpu) {
+		return false;
+	}
+	if (tiled == t->tiled) {
+		return true;
+	}
+
+	float *heightmap;
+	if (tiled) {
+		heightmap = tileHeightmap(t->heightmap, t->size);
+	} else {
+		heightmap = malloc((size_t) t->size * t->size * sizeof(float));
+		if (heightmap) {
+			untileHeightmap(t->heightmap, t->size, heightmap);
 		}
 	}
+	if (!heightmap) {
+		return false;
+	}
 
-	glGenVertexArrays(1, &mesh->VAO);
-	glBindVertexArray(mesh->VAO);
+	// a mapped file stays row-major on disk, the terrain gets its own copy
+	if (t->heightmapFile) {
+		closeHeightmapFile(t->heightmapFile);
+		t->heightmapFile = NULL;
+	} else {
+		free(t->heightmap);
+	}
+	t->heightmap = heightmap;
+	t->tiled = tiled;
+	return true;
+}
 
-	glGenBuffers(1, &mesh->positionsBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->positionsBuffer);
-	glBufferData(GL_ARRAY_BUFFER, mesh->numVertices * 3 * sizeof(float), positions, GL_STATIC_DRAW);
-	free(positions);
-	glVertexAttribPointer(positionAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(positionAttribLocation);
+struct Terrain *generateTerrainHeightmap(uint32_t size, unsigned int seed, const struct NoiseParams *params,
+	float scale)
+{
+	float *heightmap = malloc((size_t) size * size * sizeof(float));
+	if (!heightmap) {
+		return NULL;
+	}
 
-	glGenBuffers(1, &mesh->normals);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->normals);
-	glBufferData(GL_ARRAY_BUFFER, mesh->numVertices * 3 * sizeof(float), normals, GL_STATIC_DRAW);
-	free(normals);
-	glVertexAttribPointer(normalAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(normalAttribLocation);
+	struct Terrain *terrain = calloc(1, sizeof(struct Terrain));
+	if (!terrain) {
+		free(heightmap);
+		return NULL;
+	}
 
-	glGenBuffers(1, &mesh->textureCoordinatesBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->textureCoordinatesBuffer);
-	glBufferData(GL_ARRAY_BUFFER, mesh->numVertices * 2 * sizeof(float), textureCoordinates, GL_STATIC_DRAW);
-	free(textureCoordinates);
-	glVertexAttribPointer(vertexUVAttribLocation, 2, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(vertexUVAttribLocation);
+	const struct NoiseParams defaults = getDefaultNoiseParams();
+	fillNoiseHeightmap(heightmap, size, size, params ? params : &defaults, seed);
+	terrain->heightmap = heightmap;
+	terrain->size = size;
+	terrain->scale = scale;
+	return terrain;
+}
+
+struct Terrain *loadTerrain(uint32_t size, const char *texture, unsigned int seed, const char *map, float scale)
+{
+	struct Terrain *terrain = map ? loadTerrainHeightmap(size, map, scale) :
+		generateTerrainHeightmap(size, seed, NULL, scale);
+	if (!terrain) {
+		return NULL;
+	}
 
-	// load a texture
+	terrain->texture = loadTerrainTexture(texture);
+	return terrain;
+}
+
+GLuint loadTerrainTexture(const char *texture)
+{
 	int width, height, n;
 	unsigned char *imageData = stbi_load(texture, &width, &height, &n, 0);
 	if (!imageData) {
 		fprintf(stderr, "Error loading texture %s.\n", texture);
-		glBindVertexArray(0);
-		return terrain;
+		return 0;
 	}
 
-	glGenTextures(1, &mesh->texture);
-	glBindTexture(GL_TEXTURE_2D, mesh->texture);
+	GLuint name;
+	glGenTextures(1, &name);
+	glBindTexture(GL_TEXTURE_2D, name);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
 	glGenerateMipmap(GL_TEXTURE_2D);
 	free(imageData);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	return name;
+}
 
-	glBindVertexArray(0);
-	return terrain;
+bool buildTerrainChunks(struct Terrain *t, GLint positionAttribLocation, GLint vertexUVAttribLocation,
+	GLint normalAttribLocation)
+{
+	// produce mesh: one vertex per heightmap sample, split into chunks that can be culled separately
+	struct TerrainChunkData *data = prepareTerrainChunks(t);
+	if (!data) {
+		return false;
+	}
+
+	bool uploaded = uploadTerrainChunks(t, data, positionAttribLocation, vertexUVAttribLocation, normalAttribLocation);
+	freeTerrainChunkData(data, getTerrainNumChunks(t->size));
+	return uploaded;
 }
 
+struct Terrain *generateTerrain(uint32_t size, GLint positionAttribLocation, GLint vertexUVAttribLocation,
+	GLint normalAttribLocation, const char *texture, unsigned int seed, const char *map, float scale)
+{
+	struct Terrain *terrain = loadTerrain(size, texture, seed, map, scale);
+	if (!terrain) {
+		return NULL;
+	}
+
+	if (!buildTerrainChunks(terrain, positionAttribLocation, vertexUVAttribLocation, normalAttribLocation)) {
+		cleanupTerrain(terrain);
+		return NULL;
+	}
+	return terrain;
+}
@@ -1,23 +1,161 @@
 #ifndef TERRAIN_H
 #define TERRAIN_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "mesh.h"
+#include "tiledHeightmap.h"
+#include "vertexFormat.h"
 
-struct Terrain {
+/* quads along each side of a chunk, small enough for 16 bit indices */
+#define TERRAIN_CHUNK_SIZE 64
+
+struct HeightmapFile;
+struct NoiseParams;
+struct QuantizedHeightmap;
+struct RenderQueue;
+struct TerrainGPU;
+struct TerrainLOD;
+struct TerrainPyramid;
+struct TerrainStream;
+
+struct TerrainChunk {
 	struct Mesh *mesh;
+	float min[3], max[3]; /* bounds relative to the terrain's position */
+};
+
+/* CPU side vertex data for one chunk, built by prepareTerrainChunks */
+struct TerrainChunkData {
+	struct PackedVertex *vertices; /* row by row */
+	uint32_t width, depth; /* in quads */
+	float min[3], max[3];
+};
+
+struct Terrain {
+	struct TerrainChunk *chunks;
+	uint32_t numChunks; /* along each side */
+	GLuint texture;
+	GLuint chunkIndexBuffers[4];
+	struct TerrainLOD *lod; /* NULL unless buildTerrainLOD has been called */
+	struct TerrainGPU *gpu; /* NULL unless buildTerrainGPU has been called */
+	struct TerrainPyramid *pyramid; /* NULL until buildTerrainPyramid or the first raycast */
+	struct TerrainStream *stream; /* set for streamed terrain, which has no heightmap or chunks of its own */
 	float *heightmap;
+	struct HeightmapFile *heightmapFile; /* set if heightmap is mapped from a native file rather than allocated */
+	struct QuantizedHeightmap *quantized; /* replaces heightmap after compactTerrainHeightmap */
+	bool tiled; /* heightmap is in tiledHeightmap.h order rather than row-major */
 	uint32_t size;
 	float scale;
+	float x, y, z;
 };
 
+/* index of heightmap sample (x, z) in whichever layout the terrain uses */
+static inline uint32_t getTerrainSampleIndex(const struct Terrain *t, uint32_t x, uint32_t z)
+{
+	return t->tiled ? getTiledHeightmapIndex(t->size, x, z) : x + z * t->size;
+}
+
+/* height of the terrain mesh at world (x, z), 0 off the edge of the map */
 float terrainGetHeightAt(struct Terrain *t, float x, float z);
 
+/*
+ * terrainGetHeightAt for count points at once, vectorised where the CPU allows
+ * and giving the same results as the one point version. normals (3 floats per
+ * point) and slopes (rise over run) describe the triangle under each point and
+ * may be NULL if not wanted. On streamed terrain, points over tiles that aren't
+ * resident are treated as off the edge of the map.
+ */
+void terrainGetHeightsAt(struct Terrain *t, const float *x, const float *z, uint32_t count, float *heights,
+	float *normals, float *slopes);
+
+/*
+ * Loads the heightmap only, makes no GL calls so is safe to use from any thread.
+ * map is either a grayscale image or a native .hmap file, which is mapped
+ * rather than read (see heightmap.h) and must have been made for scale.
+ */
+struct Terrain *loadTerrainHeightmap(uint32_t size, const char *map, float scale);
+
+/*
+ * Procedural heightmap from seeded noise (see noise.h), NULL params for the
+ * defaults. Like loadTerrainHeightmap it makes no GL calls.
+ */
+struct Terrain *generateTerrainHeightmap(uint32_t size, unsigned int seed, const struct NoiseParams *params,
+	float scale);
+
+/*
+ * Swaps the float heightmap for 16 bit samples quantized per tile (see
+ * quantizedHeightmap.h for precision), which halves its memory, and more with
+ * cold tiles.
+ * Meant for servers and tools: afterwards the terrain answers height queries
+ * but can't be meshed, drawn, raycast or edited.
+ */
+bool compactTerrainHeightmap(struct Terrain *t, float precision);
+
+/*
+ * Switches the heightmap between row-major and tiled order. Tiles keep 2D
+ * neighbourhoods in a few cache lines, bench/heightmapLayout.c measures whether
+ * that beats row-major on a given machine. Tiled terrain can't have a LOD or
+ * GPU heightmap texture, those upload rows.
+ */
+bool setTerrainHeightmapTiled(struct Terrain *t, bool tiled);
+
+GLuint loadTerrainTexture(const char *texture);
+
+/* loads the heightmap and texture only, no geometry is built. With a NULL map the heightmap is generated from seed */
+struct Terrain *loadTerrain(uint32_t size, const char *texture, unsigned int seed, const char *map, float scale);
+
+/* number of chunks along each side of a size * size heightmap */
+uint32_t getTerrainNumChunks(uint32_t size);
+
+/*
+ * Builds the vertex data of every chunk without making any GL calls, so it can
+ * run on another thread. Returns an array of getTerrainNumChunks(size)^2 chunks.
+ */
+struct TerrainChunkData *prepareTerrainChunks(struct Terrain *t);
+
+/*
+ * As prepareTerrainChunks, with normals worked out from apron: the (size + 2)^2
+ * row-major heights of the heightmap and a one sample border around it. The
+ * edge normals then take in the faces beyond the edge, so they match those of
+ * a neighbouring heightmap that shares the edge.
+ */
+struct TerrainChunkData *prepareTerrainChunksWithApron(struct Terrain *t, const float *apron);
+
+bool uploadTerrainChunks(struct Terrain *t, const struct TerrainChunkData *data, GLint positionAttribLocation,
+	GLint vertexUVAttribLocation, GLint normalAttribLocation);
+
+void freeTerrainChunkData(struct TerrainChunkData *data, uint32_t numChunks);
+
+/*
+ * Call after changing the heightmap between samples (x0, z0) and (x1, z1)
+ * inclusive. Only that area's normals, vertex buffers, bounds, raycast pyramid,
+ * LOD and GPU heightmap data are brought up to date, so the cost follows the
+ * size of the edit rather than the map. Does nothing for streamed or compacted terrain.
+ */
+void updateTerrainRegion(struct Terrain *t, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1);
+
+/* builds the full resolution chunked mesh, prepareTerrainChunks followed by uploadTerrainChunks */
+bool buildTerrainChunks(struct Terrain *t, GLint positionAttribLocation, GLint vertexUVAttribLocation,
+	GLint normalAttribLocation);
+
+/* loadTerrain followed by buildTerrainChunks */
 struct Terrain *generateTerrain(uint32_t size, GLint positionAttribLocation, GLint vertexUVAttribLocation,
 	GLint normalAttribLocation, const char *texture, unsigned int seed, const char *map, float scale);
 
+/* queues the chunks to be drawn with program (and culled by the queue), returns how many were queued */
+uint32_t queueTerrain(struct Terrain *t, struct RenderQueue *queue, uint32_t program);
+
+/*
+ * Meshes of chunks first to first + count (of numChunks * numChunks), placed
+ * where the terrain is, for drawing some other way than queueTerrain. Not for
+ * streamed terrain.
+ */
+uint32_t getTerrainChunkMeshes(struct Terrain *t, uint32_t first, uint32_t count, struct Mesh **meshes);
+
 void cleanupTerrain(struct Terrain *terrain);
 
-#endif
+/* frees a terrain that has only its heightmap, without GL calls so it can be done on any thread */
+void freeTerrainHeightmap(struct Terrain *terrain);
 
+#endif
@@ -0,0 +1,216 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "file.h"
+#include "terrainCache.h"
+
+static uint64_t mixHash(uint64_t h, uint64_t word)
+{
+	h ^= word * 0x9e3779b97f4a7c15ull;
+	h = (h << 27 | h >> 37) * 0xc2b2ae3d27d4eb4full;
+	return h + 0x165667b19e3779f9ull;
+}
+
+/* not cryptographic, just quick enough to run over a whole heightmap at every launch */
+static uint64_t hashBytes(uint64_t h, const void *data, size_t length)
+{
+	const uint8_t *bytes = data;
+	for (; length >= 8; bytes += 8, length -= 8) {
+		uint64_t word;
+		memcpy(&word, bytes, 8);
+		h = mixHash(h, word);
+	}
+	uint64_t tail = length;
+	for (size_t i = 0; i < length; i++) {
+		tail = tail << 8 | bytes[i];
+	}
+	h = mixHash(h, tail);
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	return h;
+}
+
+uint64_t getTerrainCacheKey(const struct Terrain *t)
+{
+	if (!t->heightmap) {
+		return 0;
+	}
+	// everything that changes the vertex data, besides the heights themselves
+	const struct {
+		uint32_t version, size, chunkSize, tiled;
+		float scale;
+	} params = {TERRAIN_CACHE_VERSION, t->size, TERRAIN_CHUNK_SIZE, t->tiled, t->scale};
+	const size_t samples = t->tiled ? getTiledHeightmapLength(t->size) : (size_t) t->size * t->size;
+
+	uint64_t key = hashBytes(0, &params, sizeof(params));
+	key = hashBytes(key, t->heightmap, samples * sizeof(float));
+	return key ? key : 1;
+}
+
+bool getTerrainCachePath(char *path, size_t length, const char *directory, const char *map, unsigned int seed,
+	uint32_t size)
+{
+#ifdef _WIN32
+	_mkdir(directory);
+#else
+	mkdir(directory, 0755);
+#endif
+	// one entry per source, so a changed heightmap replaces its old entry rather than piling up
+	uint64_t name = map ? hashBytes(0, map, strlen(map)) : hashBytes(0, &seed, sizeof(seed));
+	name = hashBytes(name, &size, sizeof(size));
+	int written = snprintf(path, length, "%s/terrain-%016" PRIx64 ".cache", directory, name);
+	return written > 0 && (size_t) written < length;
+}
+
+/* the width and depth in quads of chunk (cx, cz), as prepareTerrainChunks makes them */
+static void getChunkExtent(uint32_t size, uint32_t cx, uint32_t cz, uint32_t *width, uint32_t *depth)
+{
+	const uint32_t x0 = cx * TERRAIN_CHUNK_SIZE, z0 = cz * TERRAIN_CHUNK_SIZE;
+	*width = size - 1 - x0 < TERRAIN_CHUNK_SIZE ? size - 1 - x0 : TERRAIN_CHUNK_SIZE;
+	*depth = size - 1 - z0 < TERRAIN_CHUNK_SIZE ? size - 1 - z0 : TERRAIN_CHUNK_SIZE;
+}
+
+static uint64_t getChunkBytes(uint32_t width, uint32_t depth)
+{
+	return (uint64_t) (width + 1) * (depth + 1) * sizeof(struct PackedVertex);
+}
+
+bool writeTerrainCache(const char *path, const struct Terrain *t, const struct TerrainChunkData *data)
+{
+	const uint32_t numChunks = getTerrainNumChunks(t->size);
+	struct TerrainCacheHeader header = {
+		.magic = TERRAIN_CACHE_MAGIC, .version = TERRAIN_CACHE_VERSION, .key = getTerrainCacheKey(t),
+		.size = t->size, .numChunks = numChunks
+	};
+	if (!header.key) {
+		return false;
+	}
+
+	struct TerrainCacheChunk *chunks = calloc(numChunks * numChunks, sizeof(struct TerrainCacheChunk));
+	if (!chunks) {
+		return false;
+	}
+	uint64_t offset = sizeof(header) + numChunks * numChunks * sizeof(struct TerrainCacheChunk);
+	for (uint32_t i = 0; i < numChunks * numChunks; i++) {
+		chunks[i].width = data[i].width;
+		chunks[i].depth = data[i].depth;
+		memcpy(chunks[i].min, data[i].min, sizeof(chunks[i].min));
+		memcpy(chunks[i].max, data[i].max, sizeof(chunks[i].max));
+		chunks[i].offset = offset;
+		offset += getChunkBytes(data[i].width, data[i].depth);
+	}
+	header.length = offset;
+
+	// written aside and renamed into place, so a crash or a second instance never sees half a file
+	char temporaryPath[1024];
+	if (snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", path) >= (int) sizeof(temporaryPath)) {
+		free(chunks);
+		return false;
+	}
+	FILE *file = fopen(temporaryPath, "wb");
+	if (!file) {
+		free(chunks);
+		return false;
+	}
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(chunks, sizeof(struct TerrainCacheChunk), numChunks * numChunks, file) == numChunks * numChunks;
+	for (uint32_t i = 0; written && i < numChunks * numChunks; i++) {
+		const size_t numVertices = (size_t) (data[i].width + 1) * (data[i].depth + 1);
+		written = fwrite(data[i].vertices, sizeof(struct PackedVertex), numVertices, file) == numVertices;
+	}
+	free(chunks);
+	if (fclose(file) != 0 || !written) {
+		remove(temporaryPath);
+		return false;
+	}
+#ifdef _WIN32
+	remove(path);
+#endif
+	if (rename(temporaryPath, path) != 0) {
+		remove(temporaryPath);
+		return false;
+	}
+	return true;
+}
+
+/* chunk data pointing into the mapped cache, or NULL if it's missing, damaged or from another heightmap */
+static struct TerrainChunkData *readTerrainCache(const struct MappedFile *cache, const struct Terrain *t)
+{
+	const uint32_t numChunks = getTerrainNumChunks(t->size);
+	const struct TerrainCacheHeader *header = cache->base;
+	if (cache->length < sizeof(*header) || memcmp(header->magic, TERRAIN_CACHE_MAGIC, 4) != 0 ||
+		header->version != TERRAIN_CACHE_VERSION || header->size != t->size || header->numChunks != numChunks ||
+		header->length != cache->length || header->key != getTerrainCacheKey(t) ||
+		sizeof(*header) + (uint64_t) numChunks * numChunks * sizeof(struct TerrainCacheChunk) > cache->length) {
+		return NULL;
+	}
+
+	struct TerrainChunkData *data = calloc(numChunks * numChunks, sizeof(struct TerrainChunkData));
+	if (!data) {
+		return NULL;
+	}
+	const struct TerrainCacheChunk *chunks = (const struct TerrainCacheChunk *) (header + 1);
+	for (uint32_t cz = 0; cz < numChunks; cz++) {
+		for (uint32_t cx = 0; cx < numChunks; cx++) {
+			const uint32_t i = cx + cz * numChunks;
+			uint32_t width, depth;
+			getChunkExtent(t->size, cx, cz, &width, &depth);
+			if (chunks[i].width != width || chunks[i].depth != depth || chunks[i].offset % sizeof(float) ||
+				chunks[i].offset + getChunkBytes(width, depth) > cache->length) {
+				free(data);
+				return NULL;
+			}
+			data[i].width = width;
+			data[i].depth = depth;
+			data[i].vertices = (struct PackedVertex *) ((char *) cache->base + chunks[i].offset);
+			memcpy(data[i].min, chunks[i].min, sizeof(data[i].min));
+			memcpy(data[i].max, chunks[i].max, sizeof(data[i].max));
+		}
+	}
+	return data;
+}
+
+bool buildTerrainChunksCached(struct Terrain *t, const char *path, GLint positionAttribLocation,
+	GLint vertexUVAttribLocation, GLint normalAttribLocation)
+{
+	if (!t->heightmap) {
+		return false;
+	}
+
+	struct MappedFile cache;
+	if (mapFile(path, false, &cache)) {
+		struct TerrainChunkData *data = readTerrainCache(&cache, t);
+		if (data) {
+			// the vertex data goes from the page cache to the driver without being copied or touched here
+			bool uploaded = uploadTerrainChunks(t, data, positionAttribLocation, vertexUVAttribLocation,
+				normalAttribLocation);
+			free(data);
+			unmapFile(&cache);
+			return uploaded;
+		}
+		unmapFile(&cache);
+	}
+
+	struct TerrainChunkData *data = prepareTerrainChunks(t);
+	if (!data) {
+		return false;
+	}
+	bool uploaded = uploadTerrainChunks(t, data, positionAttribLocation, vertexUVAttribLocation,
+		normalAttribLocation);
+	// a stale entry for this source is replaced
+	if (uploaded && !writeTerrainCache(path, t, data)) {
+		fprintf(stderr, "Could not write terrain cache %s.\n", path);
+	}
+	freeTerrainChunkData(data, getTerrainNumChunks(t->size));
+	return uploaded;
+}
@@ -0,0 +1,60 @@
+#ifndef TERRAIN_CACHE_H
+#define TERRAIN_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "terrain.h"
+
+/*
+ * On-disk cache of baked chunk vertex data, so a terrain that hasn't changed
+ * since the last launch skips meshing and its normal pass and is uploaded
+ * straight from a mapped file. Entries are keyed by a hash of the heightmap's
+ * bytes, size, scale and TERRAIN_CACHE_VERSION, any difference is a miss and
+ * the stale entry is replaced. The file is only meant for the machine that
+ * wrote it.
+ *
+ *	header
+ *	numChunks^2 chunk records, row-major
+ *	for each chunk: its struct PackedVertex vertices, as uploaded
+ */
+#define TERRAIN_CACHE_MAGIC "TCHE"
+/* bump whenever the chunk vertex format or the way chunks are meshed changes */
+#define TERRAIN_CACHE_VERSION 2
+
+struct TerrainCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t size, numChunks;
+	uint64_t length; /* of the whole file, so truncated files are caught */
+};
+
+struct TerrainCacheChunk {
+	uint32_t width, depth;
+	float min[3], max[3];
+	uint64_t offset; /* of the chunk's vertices */
+};
+
+/* hash identifying the chunk data t's heightmap meshes to, 0 if it has no float heightmap */
+uint64_t getTerrainCacheKey(const struct Terrain *t);
+
+/*
+ * Writes the path of the cache entry for a terrain built from map, or from
+ * seed if map is NULL, at size into path, creating directory if needed.
+ */
+bool getTerrainCachePath(char *path, size_t length, const char *directory, const char *map, unsigned int seed,
+	uint32_t size);
+
+bool writeTerrainCache(const char *path, const struct Terrain *t, const struct TerrainChunkData *data);
+
+/*
+ * buildTerrainChunks, but uploads the cached vertex data at path if it was
+ * baked from the same heightmap, otherwise meshes the terrain and caches the
+ * result there for next time.
+ */
+bool buildTerrainChunksCached(struct Terrain *t, const char *path, GLint positionAttribLocation,
+	GLint vertexUVAttribLocation, GLint normalAttribLocation);
+
+#endif
@@ -0,0 +1,90 @@
+#version 140
+
+// per frame, struct FrameUniforms
+layout(std140, row_major) uniform Frame {
+	mat4 projection;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	vec4 lightColour;
+	float lightIntensity;
+};
+
+uniform sampler2D heightmapSampler;
+uniform int heightmapSize;
+uniform float terrainScale;
+uniform vec3 terrainOrigin;
+
+in vec2 position; // grid coordinates within the patch
+in vec2 chunk; // per instance, heightmap x and z of the chunk's corner
+
+out vec2 UV;
+out vec4 colour;
+
+float angleBetween(vec4 a, vec4 b)
+{
+	float n = dot(a, b);
+	float d = length(a) * length(b);
+	return degrees(acos(n / d));
+}
+
+vec3 pointAt(ivec2 coord)
+{
+	return vec3(float(coord.x) * terrainScale, texelFetch(heightmapSampler, coord, 0).r, float(coord.y) * terrainScale);
+}
+
+vec3 faceNormal(ivec2 a, ivec2 b, ivec2 c)
+{
+	vec3 pa = pointAt(a);
+	return cross(pointAt(b) - pa, pointAt(c) - pa);
+}
+
+// the same area weighted sum of the faces around the vertex as the CPU built chunks
+vec3 normalAt(ivec2 c)
+{
+	int last = heightmapSize - 1;
+	vec3 normal = vec3(0.0f);
+	if (c.x > 0 && c.y > 0) {
+		normal += faceNormal(c + ivec2(0, -1), c + ivec2(-1, 0), c);
+	}
+	if (c.x < last && c.y > 0) {
+		normal += faceNormal(c + ivec2(1, -1), c + ivec2(0, -1), c);
+		normal += faceNormal(c + ivec2(1, -1), c, c + ivec2(1, 0));
+	}
+	if (c.x > 0 && c.y < last) {
+		normal += faceNormal(c, c + ivec2(-1, 0), c + ivec2(-1, 1));
+		normal += faceNormal(c, c + ivec2(-1, 1), c + ivec2(0, 1));
+	}
+	if (c.x < last && c.y < last) {
+		normal += faceNormal(c + ivec2(1, 0), c, c + ivec2(0, 1));
+	}
+	return normalize(normal);
+}
+
+void main()
+{
+	// patches hanging over the far edges of the map collapse onto the last row or column
+	ivec2 coord = min(ivec2(chunk + position), ivec2(heightmapSize - 1));
+
+	vec4 worldPosition = vec4(terrainOrigin + pointAt(coord), 1.0f);
+	vec4 worldNormal = vec4(normalAt(coord), 0.0f);
+
+	vec4 lightToVertexRay = worldPosition - lightPosition;
+
+	// default brightness is ambient term
+	float energy = 0.5f;
+
+	// compute diffuse
+	if (dot(lightToVertexRay, worldNormal) <= 0) {
+		float brightness = angleBetween(lightToVertexRay, worldNormal) / 90.0f;
+
+		// compute attenuation (linear)
+		float attenuation = 1.0f / min((0.1f * distance(worldPosition, lightPosition)), 1.0f);
+
+		energy = max(attenuation * lightIntensity * brightness, 1.0f);
+	}
+
+	colour = energy * lightColour;
+	// texture repeats once per grid cell
+	UV = vec2(coord);
+	gl_Position = projection * viewMatrix * worldPosition;
+}
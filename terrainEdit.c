@@ -0,0 +1,109 @@
+#include <math.h>
+
+#include "terrainEdit.h"
+
+/* rim height and reach of a crater, relative to its depth and radius */
+#define CRATER_RIM_HEIGHT 0.2f
+#define CRATER_RIM_WIDTH 0.5f
+
+/* samples covered by a circle, false if it misses the map */
+static bool getEditBounds(const struct Terrain *t, float x, float z, float radius, uint32_t *x0, uint32_t *z0,
+	uint32_t *x1, uint32_t *z1)
+{
+	if (!t->heightmap) {
+		return false;
+	}
+	const float last = (float) (t->size - 1);
+	float lx = ceilf((x - radius - t->x) / t->scale), hx = floorf((x + radius - t->x) / t->scale);
+	float lz = ceilf((z - radius - t->z) / t->scale), hz = floorf((z + radius - t->z) / t->scale);
+	if (!(hx >= 0.0f && hz >= 0.0f && lx <= last && lz <= last && lx <= hx && lz <= hz)) {
+		return false;
+	}
+	*x0 = (uint32_t) fmaxf(lx, 0.0f); *x1 = (uint32_t) fminf(hx, last);
+	*z0 = (uint32_t) fmaxf(lz, 0.0f); *z1 = (uint32_t) fminf(hz, last);
+	return true;
+}
+
+/* distance of sample (sx, sz) from (x, z) as a fraction of radius */
+static float getEditDistance(const struct Terrain *t, uint32_t sx, uint32_t sz, float x, float z, float radius)
+{
+	float dx = t->x + (float) sx * t->scale - x, dz = t->z + (float) sz * t->scale - z;
+	return sqrtf(dx * dx + dz * dz) / radius;
+}
+
+/* 1 at the centre down to 0 at the edge, with no crease at either end */
+static float getFalloff(float d)
+{
+	if (d >= 1.0f) {
+		return 0.0f;
+	}
+	float f = 1.0f - d * d;
+	return f * f;
+}
+
+void raiseTerrain(struct Terrain *t, float x, float z, float radius, float amount)
+{
+	uint32_t x0, z0, x1, z1;
+	if (!getEditBounds(t, x, z, radius, &x0, &z0, &x1, &z1)) {
+		return;
+	}
+	for (uint32_t sz = z0; sz <= z1; sz++) {
+		for (uint32_t sx = x0; sx <= x1; sx++) {
+			t->heightmap[getTerrainSampleIndex(t, sx, sz)] += amount * getFalloff(getEditDistance(t, sx, sz, x, z, radius));
+		}
+	}
+	updateTerrainRegion(t, x0, z0, x1, z1);
+}
+
+void flattenTerrain(struct Terrain *t, float x, float z, float radius, float height, float strength)
+{
+	uint32_t x0, z0, x1, z1;
+	if (!getEditBounds(t, x, z, radius, &x0, &z0, &x1, &z1)) {
+		return;
+	}
+	for (uint32_t sz = z0; sz <= z1; sz++) {
+		for (uint32_t sx = x0; sx <= x1; sx++) {
+			float *h = &t->heightmap[getTerrainSampleIndex(t, sx, sz)];
+			*h += (height - *h) * strength * getFalloff(getEditDistance(t, sx, sz, x, z, radius));
+		}
+	}
+	updateTerrainRegion(t, x0, z0, x1, z1);
+}
+
+void craterTerrain(struct Terrain *t, float x, float z, float radius, float depth)
+{
+	const float reach = 1.0f + CRATER_RIM_WIDTH, rim = depth * CRATER_RIM_HEIGHT;
+	uint32_t x0, z0, x1, z1;
+	if (!getEditBounds(t, x, z, radius * reach, &x0, &z0, &x1, &z1)) {
+		return;
+	}
+	for (uint32_t sz = z0; sz <= z1; sz++) {
+		for (uint32_t sx = x0; sx <= x1; sx++) {
+			float d = getEditDistance(t, sx, sz, x, z, radius);
+			if (d < 1.0f) {
+				// parabolic bowl meeting the top of the rim at the edge
+				t->heightmap[getTerrainSampleIndex(t, sx, sz)] += (rim + depth) * d * d - depth;
+			} else if (d < reach) {
+				float f = 1.0f - (d - 1.0f) / CRATER_RIM_WIDTH;
+				t->heightmap[getTerrainSampleIndex(t, sx, sz)] += rim * f * f;
+			}
+		}
+	}
+	updateTerrainRegion(t, x0, z0, x1, z1);
+}
+
+void setTerrainHeights(struct Terrain *t, uint32_t x, uint32_t z, uint32_t width, uint32_t depth,
+	const float *heights)
+{
+	if (!t->heightmap || !width || !depth || x >= t->size || z >= t->size) {
+		return;
+	}
+	const uint32_t x1 = x + width - 1 < t->size - 1 ? x + width - 1 : t->size - 1;
+	const uint32_t z1 = z + depth - 1 < t->size - 1 ? z + depth - 1 : t->size - 1;
+	for (uint32_t sz = z; sz <= z1; sz++) {
+		for (uint32_t sx = x; sx <= x1; sx++) {
+			t->heightmap[getTerrainSampleIndex(t, sx, sz)] = heights[(sx - x) + (sz - z) * width];
+		}
+	}
+	updateTerrainRegion(t, x, z, x1, z1);
+}
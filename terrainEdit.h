@@ -0,0 +1,27 @@
+#ifndef TERRAIN_EDIT_H
+#define TERRAIN_EDIT_H
+
+#include <stdint.h>
+
+#include "terrain.h"
+
+/*
+ * Runtime terrain editing. Each call changes the heightmap in a rectangle and
+ * then updates only that part of the terrain with updateTerrainRegion. Positions
+ * and radii are in world units, edits off the map are clipped.
+ */
+
+/* adds amount to the heights within radius of (x, z), falling off smoothly to the edge. Negative amounts dig */
+void raiseTerrain(struct Terrain *t, float x, float z, float radius, float amount);
+
+/* moves the heights within radius of (x, z) towards height, strength 1 flattens the centre completely */
+void flattenTerrain(struct Terrain *t, float x, float z, float radius, float height, float strength);
+
+/* a bowl depth deep inside radius, with a low rim thrown up around it */
+void craterTerrain(struct Terrain *t, float x, float z, float radius, float depth);
+
+/* replaces a width * depth block of samples starting at sample (x, z) with heights */
+void setTerrainHeights(struct Terrain *t, uint32_t x, uint32_t z, uint32_t width, uint32_t depth,
+	const float *heights);
+
+#endif
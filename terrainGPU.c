@@ -0,0 +1,218 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "maths.h"
+#include "terrainGPU.h"
+
+/* min and max heights of a chunk, including the samples on its far edges */
+static void buildChunkMinMax(struct Terrain *t, uint32_t cx, uint32_t cz)
+{
+	const uint32_t last = t->size - 1;
+	const uint32_t x0 = cx * TERRAIN_CHUNK_SIZE, z0 = cz * TERRAIN_CHUNK_SIZE;
+	const uint32_t x1 = x0 + TERRAIN_CHUNK_SIZE < last ? x0 + TERRAIN_CHUNK_SIZE : last;
+	const uint32_t z1 = z0 + TERRAIN_CHUNK_SIZE < last ? z0 + TERRAIN_CHUNK_SIZE : last;
+
+	float lo = INFINITY, hi = -INFINITY;
+	for (uint32_t z = z0; z <= z1; z++) {
+		for (uint32_t x = x0; x <= x1; x++) {
+			lo = fminf(lo, t->heightmap[getTerrainSampleIndex(t, x, z)]);
+			hi = fmaxf(hi, t->heightmap[getTerrainSampleIndex(t, x, z)]);
+		}
+	}
+	float *minMax = &t->gpu->minMax[(cx + cz * t->gpu->numChunks) * 2];
+	minMax[0] = lo;
+	minMax[1] = hi;
+}
+
+uint32_t drawTerrainGPU(struct Terrain *t, const float *frustumPlanes)
+{
+	struct TerrainGPU *gpu = t->gpu;
+	const uint32_t last = t->size - 1;
+
+	uint32_t numDrawn = 0;
+	for (uint32_t cz = 0; cz < gpu->numChunks; cz++) {
+		for (uint32_t cx = 0; cx < gpu->numChunks; cx++) {
+			const uint32_t x0 = cx * TERRAIN_CHUNK_SIZE, z0 = cz * TERRAIN_CHUNK_SIZE;
+			const uint32_t x1 = x0 + TERRAIN_CHUNK_SIZE < last ? x0 + TERRAIN_CHUNK_SIZE : last;
+			const uint32_t z1 = z0 + TERRAIN_CHUNK_SIZE < last ? z0 + TERRAIN_CHUNK_SIZE : last;
+			const float *minMax = &gpu->minMax[(cx + cz * gpu->numChunks) * 2];
+			const float min[] = {t->x + (float) x0 * t->scale, t->y + minMax[0], t->z + (float) z0 * t->scale};
+			const float max[] = {t->x + (float) x1 * t->scale, t->y + minMax[1], t->z + (float) z1 * t->scale};
+			if (!aabbInFrustum(frustumPlanes, min, max)) {
+				continue;
+			}
+			gpu->instances[numDrawn * 2] = (float) x0;
+			gpu->instances[numDrawn * 2 + 1] = (float) z0;
+			numDrawn++;
+		}
+	}
+	if (!numDrawn) {
+		return 0;
+	}
+
+	glUniform3f(gpu->terrainOriginUniformLocation, t->x, t->y, t->z);
+
+	// orphaned every frame so the driver doesn't have to wait for the previous frame's draw
+	glBindBuffer(GL_ARRAY_BUFFER, gpu->instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, gpu->numChunks * gpu->numChunks * 2 * sizeof(float), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, numDrawn * 2 * sizeof(float), gpu->instances);
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, gpu->heightmapTexture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, t->texture);
+	glBindVertexArray(gpu->patch->VAO);
+	glDrawElementsInstanced(GL_TRIANGLES, gpu->patch->numIndices, GL_UNSIGNED_SHORT, NULL, numDrawn);
+	glBindVertexArray(0);
+	return numDrawn;
+}
+
+/* grid of (TERRAIN_CHUNK_SIZE + 1)^2 vertices at integer x, z, plus the per-instance chunk corner */
+static struct Mesh *buildPatch(GLuint instanceBuffer, GLint positionAttribLocation, GLint chunkAttribLocation)
+{
+	const uint32_t n = TERRAIN_CHUNK_SIZE, stride = n + 1;
+
+	struct Mesh *mesh = calloc(1, sizeof(struct Mesh));
+	if (!mesh) {
+		return NULL;
+	}
+
+	uint8_t *positions = malloc(stride * stride * 2);
+	uint16_t *indices = malloc(n * n * 6 * sizeof(uint16_t));
+	if (!positions || !indices) {
+		free(positions); free(indices); free(mesh);
+		return NULL;
+	}
+
+	uint32_t positionsIndex = 0;
+	for (uint32_t z = 0; z <= n; z++) {
+		for (uint32_t x = 0; x <= n; x++) {
+			positions[positionsIndex++] = (uint8_t) x;
+			positions[positionsIndex++] = (uint8_t) z;
+		}
+	}
+
+	// same triangulation as the chunk meshes
+	uint32_t indicesIndex = 0;
+	for (uint32_t z = 0; z < n; z++) {
+		for (uint32_t x = 0; x < n; x++) {
+			uint16_t i0 = x + z * stride, i1 = i0 + 1, i2 = i0 + stride, i3 = i2 + 1;
+			indices[indicesIndex++] = i1; indices[indicesIndex++] = i0; indices[indicesIndex++] = i2;
+			indices[indicesIndex++] = i1; indices[indicesIndex++] = i2; indices[indicesIndex++] = i3;
+		}
+	}
+
+	mesh->numVertices = stride * stride;
+	mesh->numIndices = indicesIndex;
+	mesh->indexType = GL_UNSIGNED_SHORT;
+
+	glGenVertexArrays(1, &mesh->VAO);
+	glBindVertexArray(mesh->VAO);
+
+	glGenBuffers(1, &mesh->vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, mesh->numVertices * 2, positions, GL_STATIC_DRAW);
+	free(positions);
+	glVertexAttribPointer(positionAttribLocation, 2, GL_UNSIGNED_BYTE, GL_FALSE, 0, NULL);
+	glEnableVertexAttribArray(positionAttribLocation);
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glVertexAttribPointer(chunkAttribLocation, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+	glEnableVertexAttribArray(chunkAttribLocation);
+	glVertexAttribDivisor(chunkAttribLocation, 1);
+
+	glGenBuffers(1, &mesh->indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->numIndices * sizeof(uint16_t), indices, GL_STATIC_DRAW);
+	free(indices);
+
+	glBindVertexArray(0);
+	return mesh;
+}
+
+bool buildTerrainGPU(struct Terrain *t, GLuint program)
+{
+	// the texture is uploaded straight from the heightmap's rows
+	if (!t->heightmap || t->tiled) {
+		return false;
+	}
+	struct TerrainGPU *gpu = calloc(1, sizeof(struct TerrainGPU));
+	if (!gpu) {
+		return false;
+	}
+	t->gpu = gpu;
+
+	gpu->numChunks = getTerrainNumChunks(t->size);
+	gpu->instances = malloc(gpu->numChunks * gpu->numChunks * 2 * sizeof(float));
+	gpu->minMax = malloc(gpu->numChunks * gpu->numChunks * 2 * sizeof(float));
+	if (!gpu->instances || !gpu->minMax) {
+		return false;
+	}
+	for (uint32_t cz = 0; cz < gpu->numChunks; cz++) {
+		for (uint32_t cx = 0; cx < gpu->numChunks; cx++) {
+			buildChunkMinMax(t, cx, cz);
+		}
+	}
+
+	glGenBuffers(1, &gpu->instanceBuffer);
+	gpu->patch = buildPatch(gpu->instanceBuffer, glGetAttribLocation(program, "position"),
+		glGetAttribLocation(program, "chunk"));
+	if (!gpu->patch) {
+		return false;
+	}
+	gpu->terrainOriginUniformLocation = glGetUniformLocation(program, "terrainOrigin");
+
+	// vertices sit exactly on samples and are read with texelFetch, so there is nothing to filter
+	glGenTextures(1, &gpu->heightmapTexture);
+	glBindTexture(GL_TEXTURE_2D, gpu->heightmapTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, t->size, t->size, 0, GL_RED, GL_FLOAT, t->heightmap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "heightmapSampler"), 1);
+	glUniform1f(glGetUniformLocation(program, "terrainScale"), t->scale);
+	glUniform1i(glGetUniformLocation(program, "heightmapSize"), (GLint) t->size);
+	glUseProgram(previousProgram);
+
+	return true;
+}
+
+void updateTerrainGPU(struct Terrain *t, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1)
+{
+	struct TerrainGPU *gpu = t->gpu;
+
+	glBindTexture(GL_TEXTURE_2D, gpu->heightmapTexture);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, t->size);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x0, z0, x1 - x0 + 1, z1 - z0 + 1, GL_RED, GL_FLOAT,
+		&t->heightmap[x0 + z0 * t->size]);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+	// chunks include their far edge, so a sample on an edge is in the chunks either side
+	const uint32_t last = gpu->numChunks - 1;
+	const uint32_t cx0 = x0 ? (x0 - 1) / TERRAIN_CHUNK_SIZE : 0, cz0 = z0 ? (z0 - 1) / TERRAIN_CHUNK_SIZE : 0;
+	const uint32_t cx1 = x1 / TERRAIN_CHUNK_SIZE < last ? x1 / TERRAIN_CHUNK_SIZE : last;
+	const uint32_t cz1 = z1 / TERRAIN_CHUNK_SIZE < last ? z1 / TERRAIN_CHUNK_SIZE : last;
+	for (uint32_t cz = cz0; cz <= cz1; cz++) {
+		for (uint32_t cx = cx0; cx <= cx1; cx++) {
+			buildChunkMinMax(t, cx, cz);
+		}
+	}
+}
+
+void cleanupTerrainGPU(struct TerrainGPU *gpu)
+{
+	if (gpu->patch) {
+		CleanupMesh(gpu->patch);
+	}
+	glDeleteBuffers(1, &gpu->instanceBuffer);
+	glDeleteTextures(1, &gpu->heightmapTexture);
+	free(gpu->instances);
+	free(gpu->minMax);
+	free(gpu);
+}
@@ -0,0 +1,41 @@
+#ifndef TERRAIN_GPU_H
+#define TERRAIN_GPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+#include "terrain.h"
+
+/*
+ * Full resolution terrain displaced on the GPU. The heightmap is uploaded once
+ * as a texture and a single TERRAIN_CHUNK_SIZE quad grid patch is instanced
+ * over every visible chunk, terrainDisplacement.vert fetches each vertex's
+ * height and the samples around it for its normal. The mesh and shading match
+ * the chunks built by buildTerrainChunks, but the only vertex data is the
+ * patch's 8 KB of grid coordinates.
+ */
+struct TerrainGPU {
+	struct Mesh *patch; /* (TERRAIN_CHUNK_SIZE + 1)^2 vertices of unsigned byte grid coordinates */
+	GLuint heightmapTexture;
+	GLuint instanceBuffer; /* heightmap x and z of the corner of every chunk drawn this frame */
+	float *instances;
+	float *minMax; /* min and max height of every chunk, for culling */
+	uint32_t numChunks; /* along each side */
+
+	GLint terrainOriginUniformLocation;
+};
+
+/* sets up terrain t to be drawn with program (built from terrainDisplacement.vert) instead of chunk meshes */
+bool buildTerrainGPU(struct Terrain *t, GLuint program);
+
+/* draws every chunk in the frustum with one instanced call, program must be in use. Returns the number drawn */
+uint32_t drawTerrainGPU(struct Terrain *t, const float *frustumPlanes);
+
+/* re-uploads heightmap samples (x0, z0) to (x1, z1) and the bounds of the chunks over them after an edit */
+void updateTerrainGPU(struct Terrain *t, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1);
+
+void cleanupTerrainGPU(struct TerrainGPU *gpu);
+
+#endif
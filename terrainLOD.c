@@ -0,0 +1,347 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "heightmap.h"
+#include "maths.h"
+#include "terrainLOD.h"
+
+/* state for one frame's node selection */
+struct LODSelection {
+	struct Terrain *t;
+	const float *frustumPlanes;
+	const float *cameraPosition;
+	uint32_t numTris;
+};
+
+static void getNodeBounds(struct Terrain *t, uint32_t level, uint32_t nx, uint32_t nz, float *min, float *max)
+{
+	struct TerrainLOD *lod = t->lod;
+	const uint32_t nodeSize = TERRAIN_LOD_PATCH_SIZE << level, last = t->size - 1;
+	const float *minMax = &lod->minMax[level][(nx + nz * lod->nodesPerSide[level]) * 2];
+
+	min[0] = t->x + (float) (nx * nodeSize) * t->scale;
+	min[1] = t->y + minMax[0];
+	min[2] = t->z + (float) (nz * nodeSize) * t->scale;
+	max[0] = t->x + (float) ((nx + 1) * nodeSize < last ? (nx + 1) * nodeSize : last) * t->scale;
+	max[1] = t->y + minMax[1];
+	max[2] = t->z + (float) ((nz + 1) * nodeSize < last ? (nz + 1) * nodeSize : last) * t->scale;
+}
+
+static bool sphereIntersectsAABB(const float *centre, float radius, const float *min, const float *max)
+{
+	float d = 0.0f;
+	for (int i = 0; i < 3; i++) {
+		float v = centre[i] < min[i] ? min[i] - centre[i] : (centre[i] > max[i] ? centre[i] - max[i] : 0.0f);
+		d += v * v;
+	}
+	return d <= radius * radius;
+}
+
+/* quadrant is 0-3 to draw only that quarter of the node, or -1 for all of it */
+static void drawNode(struct LODSelection *s, uint32_t level, uint32_t nx, uint32_t nz, int quadrant)
+{
+	struct TerrainLOD *lod = s->t->lod;
+	const uint32_t nodeSize = TERRAIN_LOD_PATCH_SIZE << level;
+
+	glUniform4f(lod->nodeUniformLocation, (float) (nx * nodeSize), (float) (nz * nodeSize), (float) (1 << level), 0.0f);
+
+	if (level == lod->numLevels - 1) {
+		// nothing coarser to morph into
+		glUniform2f(lod->morphUniformLocation, 1.0f, 0.0f);
+	} else {
+		float previous = level ? lod->ranges[level - 1] : 0.0f;
+		float end = lod->ranges[level];
+		float start = previous + (end - previous) * TERRAIN_LOD_MORPH_START;
+		glUniform2f(lod->morphUniformLocation, end / (end - start), 1.0f / (end - start));
+	}
+
+	uint32_t count = lod->patch->numIndices, first = 0;
+	if (quadrant >= 0) {
+		count /= 4;
+		first = count * quadrant;
+	}
+	glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_SHORT, (void *) (first * sizeof(uint16_t)));
+	s->numTris += count / 3;
+}
+
+/*
+ * Returns false if the node is outside the range of its level, so the parent
+ * has to cover its area. Nodes outside the frustum count as handled.
+ */
+static bool selectNode(struct LODSelection *s, uint32_t level, uint32_t nx, uint32_t nz)
+{
+	struct TerrainLOD *lod = s->t->lod;
+	if (nx >= lod->nodesPerSide[level] || nz >= lod->nodesPerSide[level]) {
+		return true; // past the edge of the map
+	}
+
+	float min[3], max[3];
+	getNodeBounds(s->t, level, nx, nz, min, max);
+	if (!aabbInFrustum(s->frustumPlanes, min, max)) {
+		return true;
+	}
+	if (!sphereIntersectsAABB(s->cameraPosition, lod->ranges[level], min, max)) {
+		return false;
+	}
+
+	if (level == 0 || !sphereIntersectsAABB(s->cameraPosition, lod->ranges[level - 1], min, max)) {
+		drawNode(s, level, nx, nz, -1);
+		return true;
+	}
+
+	for (int quadrant = 0; quadrant < 4; quadrant++) {
+		if (!selectNode(s, level - 1, nx * 2 + (quadrant & 1), nz * 2 + (quadrant >> 1))) {
+			drawNode(s, level, nx, nz, quadrant);
+		}
+	}
+	return true;
+}
+
+uint32_t drawTerrainLOD(struct Terrain *t, const float *frustumPlanes, const float *cameraPosition)
+{
+	struct TerrainLOD *lod = t->lod;
+	struct LODSelection s = {.t = t, .frustumPlanes = frustumPlanes, .cameraPosition = cameraPosition};
+
+	glUniform3f(lod->cameraPositionUniformLocation, cameraPosition[0], cameraPosition[1], cameraPosition[2]);
+	glUniform3f(lod->terrainOriginUniformLocation, t->x, t->y, t->z);
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, lod->heightmapTexture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, t->texture);
+	glBindVertexArray(lod->patch->VAO);
+
+	const uint32_t top = lod->numLevels - 1;
+	for (uint32_t nz = 0; nz < lod->nodesPerSide[top]; nz++) {
+		for (uint32_t nx = 0; nx < lod->nodesPerSide[top]; nx++) {
+			// beyond the coarsest range is still drawn, at the coarsest level
+			if (!selectNode(&s, top, nx, nz)) {
+				drawNode(&s, top, nx, nz, -1);
+			}
+		}
+	}
+
+	glBindVertexArray(0);
+	return s.numTris;
+}
+
+/* grid of (TERRAIN_LOD_PATCH_SIZE + 1)^2 vertices at integer x, z, indices for each quadrant are contiguous */
+static struct Mesh *buildPatch(GLint positionAttribLocation)
+{
+	const uint32_t n = TERRAIN_LOD_PATCH_SIZE, half = n / 2, stride = n + 1;
+
+	struct Mesh *mesh = calloc(1, sizeof(struct Mesh));
+	if (!mesh) {
+		return NULL;
+	}
+
+	float *positions = malloc(stride * stride * 3 * sizeof(float));
+	uint16_t *indices = malloc(n * n * 6 * sizeof(uint16_t));
+	if (!positions || !indices) {
+		free(positions); free(indices); free(mesh);
+		return NULL;
+	}
+
+	uint32_t positionsIndex = 0;
+	for (uint32_t z = 0; z <= n; z++) {
+		for (uint32_t x = 0; x <= n; x++) {
+			positions[positionsIndex++] = (float) x;
+			positions[positionsIndex++] = 0.0f;
+			positions[positionsIndex++] = (float) z;
+		}
+	}
+
+	// same triangulation as the full resolution chunks
+	uint32_t indicesIndex = 0;
+	for (uint32_t quadrant = 0; quadrant < 4; quadrant++) {
+		uint32_t qx = (quadrant & 1) * half, qz = (quadrant >> 1) * half;
+		for (uint32_t z = qz; z < qz + half; z++) {
+			for (uint32_t x = qx; x < qx + half; x++) {
+				uint16_t i0 = x + z * stride, i1 = i0 + 1, i2 = i0 + stride, i3 = i2 + 1;
+				indices[indicesIndex++] = i1; indices[indicesIndex++] = i0; indices[indicesIndex++] = i2;
+				indices[indicesIndex++] = i1; indices[indicesIndex++] = i2; indices[indicesIndex++] = i3;
+			}
+		}
+	}
+
+	mesh->numVertices = stride * stride;
+	mesh->numIndices = indicesIndex;
+	mesh->indexType = GL_UNSIGNED_SHORT;
+
+	glGenVertexArrays(1, &mesh->VAO);
+	glBindVertexArray(mesh->VAO);
+
+	glGenBuffers(1, &mesh->vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, mesh->numVertices * 3 * sizeof(float), positions, GL_STATIC_DRAW);
+	free(positions);
+	glVertexAttribPointer(positionAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+	glEnableVertexAttribArray(positionAttribLocation);
+
+	glGenBuffers(1, &mesh->indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->numIndices * sizeof(uint16_t), indices, GL_STATIC_DRAW);
+	free(indices);
+
+	glBindVertexArray(0);
+	return mesh;
+}
+
+/* min and max heights of a node, level 0 from the heightmap and the rest from their children */
+static void buildNodeMinMax(struct Terrain *t, uint32_t level, uint32_t nx, uint32_t nz)
+{
+	struct TerrainLOD *lod = t->lod;
+	const uint32_t last = t->size - 1;
+	float lo = INFINITY, hi = -INFINITY;
+	if (level == 0) {
+		uint32_t x0 = nx * TERRAIN_LOD_PATCH_SIZE, z0 = nz * TERRAIN_LOD_PATCH_SIZE;
+		uint32_t x1 = x0 + TERRAIN_LOD_PATCH_SIZE < last ? x0 + TERRAIN_LOD_PATCH_SIZE : last;
+		uint32_t z1 = z0 + TERRAIN_LOD_PATCH_SIZE < last ? z0 + TERRAIN_LOD_PATCH_SIZE : last;
+		for (uint32_t z = z0; z <= z1; z++) {
+			for (uint32_t x = x0; x <= x1; x++) {
+				lo = fminf(lo, t->heightmap[getTerrainSampleIndex(t, x, z)]);
+				hi = fmaxf(hi, t->heightmap[getTerrainSampleIndex(t, x, z)]);
+			}
+		}
+	} else {
+		const uint32_t childN = lod->nodesPerSide[level - 1];
+		for (uint32_t child = 0; child < 4; child++) {
+			uint32_t cx = nx * 2 + (child & 1), cz = nz * 2 + (child >> 1);
+			if (cx < childN && cz < childN) {
+				lo = fminf(lo, lod->minMax[level - 1][(cx + cz * childN) * 2]);
+				hi = fmaxf(hi, lod->minMax[level - 1][(cx + cz * childN) * 2 + 1]);
+			}
+		}
+	}
+	float *minMax = &lod->minMax[level][(nx + nz * lod->nodesPerSide[level]) * 2];
+	minMax[0] = lo;
+	minMax[1] = hi;
+}
+
+static bool buildMinMax(struct Terrain *t)
+{
+	struct TerrainLOD *lod = t->lod;
+
+	// native heightmap files already carry level 0, taking it from there saves reading every page
+	const struct HeightmapFile *file = t->heightmapFile;
+	const bool precomputed = file && file->minMax && file->header->tileSize == TERRAIN_LOD_PATCH_SIZE &&
+		file->header->tilesX == lod->nodesPerSide[0] && file->header->tilesZ == lod->nodesPerSide[0];
+
+	for (uint32_t level = 0; level < lod->numLevels; level++) {
+		const uint32_t n = lod->nodesPerSide[level];
+		lod->minMax[level] = malloc(n * n * 2 * sizeof(float));
+		if (!lod->minMax[level]) {
+			return false;
+		}
+		if (level == 0 && precomputed) {
+			memcpy(lod->minMax[level], file->minMax, n * n * 2 * sizeof(float));
+			continue;
+		}
+		for (uint32_t nz = 0; nz < n; nz++) {
+			for (uint32_t nx = 0; nx < n; nx++) {
+				buildNodeMinMax(t, level, nx, nz);
+			}
+		}
+	}
+	return true;
+}
+
+bool buildTerrainLOD(struct Terrain *t, GLuint program, float detailDistance)
+{
+	// the texture is uploaded straight from the heightmap's rows
+	if (!t->heightmap || t->tiled) {
+		return false;
+	}
+	struct TerrainLOD *lod = calloc(1, sizeof(struct TerrainLOD));
+	if (!lod) {
+		return false;
+	}
+	t->lod = lod;
+
+	// enough levels for a single node to cover the whole map
+	const uint32_t quads = t->size - 1;
+	while (lod->numLevels < TERRAIN_LOD_MAX_LEVELS) {
+		uint32_t nodeSize = TERRAIN_LOD_PATCH_SIZE << lod->numLevels;
+		lod->nodesPerSide[lod->numLevels] = (quads + nodeSize - 1) / nodeSize;
+		lod->ranges[lod->numLevels] = detailDistance * (float) (1 << lod->numLevels);
+		lod->numLevels++;
+		if (nodeSize >= quads) {
+			break;
+		}
+	}
+
+	if (!buildMinMax(t)) {
+		return false;
+	}
+
+	lod->program = program;
+	lod->nodeUniformLocation = glGetUniformLocation(program, "node");
+	lod->morphUniformLocation = glGetUniformLocation(program, "morph");
+	lod->cameraPositionUniformLocation = glGetUniformLocation(program, "cameraPosition");
+	lod->terrainOriginUniformLocation = glGetUniformLocation(program, "terrainOrigin");
+	lod->terrainScaleUniformLocation = glGetUniformLocation(program, "terrainScale");
+	lod->heightmapSizeUniformLocation = glGetUniformLocation(program, "heightmapSize");
+	lod->heightmapSamplerUniformLocation = glGetUniformLocation(program, "heightmapSampler");
+
+	lod->patch = buildPatch(glGetAttribLocation(program, "position"));
+	if (!lod->patch) {
+		return false;
+	}
+
+	// heights are sampled in the vertex shader, filtered so morphing vertices land between samples
+	glGenTextures(1, &lod->heightmapTexture);
+	glBindTexture(GL_TEXTURE_2D, lod->heightmapTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, t->size, t->size, 0, GL_RED, GL_FLOAT, t->heightmap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glUseProgram(program);
+	glUniform1i(lod->heightmapSamplerUniformLocation, 1);
+	glUniform1f(lod->terrainScaleUniformLocation, t->scale);
+	glUniform1f(lod->heightmapSizeUniformLocation, (float) t->size);
+	glUseProgram(previousProgram);
+
+	return true;
+}
+
+void updateTerrainLOD(struct Terrain *t, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1)
+{
+	struct TerrainLOD *lod = t->lod;
+
+	glBindTexture(GL_TEXTURE_2D, lod->heightmapTexture);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, t->size);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x0, z0, x1 - x0 + 1, z1 - z0 + 1, GL_RED, GL_FLOAT,
+		&t->heightmap[x0 + z0 * t->size]);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+	// nodes include their far edge, so a sample on an edge is in the nodes either side
+	uint32_t nx0 = x0 ? (x0 - 1) / TERRAIN_LOD_PATCH_SIZE : 0, nz0 = z0 ? (z0 - 1) / TERRAIN_LOD_PATCH_SIZE : 0;
+	uint32_t nx1 = x1 / TERRAIN_LOD_PATCH_SIZE, nz1 = z1 / TERRAIN_LOD_PATCH_SIZE;
+	for (uint32_t level = 0; level < lod->numLevels; level++) {
+		const uint32_t n = lod->nodesPerSide[level];
+		for (uint32_t nz = nz0; nz <= nz1 && nz < n; nz++) {
+			for (uint32_t nx = nx0; nx <= nx1 && nx < n; nx++) {
+				buildNodeMinMax(t, level, nx, nz);
+			}
+		}
+		nx0 /= 2; nz0 /= 2; nx1 /= 2; nz1 /= 2;
+	}
+}
+
+void cleanupTerrainLOD(struct TerrainLOD *lod)
+{
+	if (lod->patch) {
+		CleanupMesh(lod->patch);
+	}
+	glDeleteTextures(1, &lod->heightmapTexture);
+	for (uint32_t level = 0; level < lod->numLevels; level++) {
+		free(lod->minMax[level]);
+	}
+	free(lod);
+}
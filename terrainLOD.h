@@ -0,0 +1,57 @@
+#ifndef TERRAIN_LOD_H
+#define TERRAIN_LOD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+#include "terrain.h"
+
+/* quads along each side of the grid patch every quadtree node is drawn with */
+#define TERRAIN_LOD_PATCH_SIZE 32
+#define TERRAIN_LOD_MAX_LEVELS 16
+/* fraction of the way through a level's range at which vertices start morphing to the next level */
+#define TERRAIN_LOD_MORPH_START 0.66f
+
+/*
+ * Continuous distance-dependent level of detail (CDLOD). The heightmap lives in
+ * a texture and every selected quadtree node is drawn with the same grid patch,
+ * displaced in terrainLOD.vert. Level 0 nodes are TERRAIN_LOD_PATCH_SIZE quads
+ * across at full resolution, each level up doubles the node size and vertex
+ * spacing. Vertices morph into the next level before a node switches so there
+ * is no popping.
+ */
+struct TerrainLOD {
+	struct Mesh *patch; /* (TERRAIN_LOD_PATCH_SIZE + 1)^2 vertices, indices grouped by quadrant */
+	GLuint heightmapTexture;
+	uint32_t numLevels;
+	uint32_t nodesPerSide[TERRAIN_LOD_MAX_LEVELS];
+	float *minMax[TERRAIN_LOD_MAX_LEVELS]; /* min and max height of every node, row-major per level */
+	float ranges[TERRAIN_LOD_MAX_LEVELS]; /* distance up to which each level is used */
+
+	GLuint program;
+	GLint nodeUniformLocation, morphUniformLocation, cameraPositionUniformLocation;
+	GLint terrainOriginUniformLocation, terrainScaleUniformLocation, heightmapSizeUniformLocation;
+	GLint heightmapSamplerUniformLocation;
+};
+
+/*
+ * Sets up the LOD structures for terrain t, to be drawn with program (built
+ * from terrainLOD.vert). detailDistance is the range of the full resolution
+ * level, each coarser level covers twice the distance of the previous one.
+ */
+bool buildTerrainLOD(struct Terrain *t, GLuint program, float detailDistance);
+
+/*
+ * Selects and draws the quadtree nodes for a camera at cameraPosition, program
+ * must be in use. Returns the number of triangles drawn.
+ */
+uint32_t drawTerrainLOD(struct Terrain *t, const float *frustumPlanes, const float *cameraPosition);
+
+/* re-uploads heightmap samples (x0, z0) to (x1, z1) and the bounds of the nodes over them after an edit */
+void updateTerrainLOD(struct Terrain *t, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1);
+
+void cleanupTerrainLOD(struct TerrainLOD *lod);
+
+#endif
@@ -0,0 +1,79 @@
+#version 140
+
+// per frame, struct FrameUniforms
+layout(std140, row_major) uniform Frame {
+	mat4 projection;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	vec4 lightColour;
+	float lightIntensity;
+};
+
+uniform sampler2D heightmapSampler;
+uniform float heightmapSize;
+uniform float terrainScale;
+uniform vec3 terrainOrigin;
+uniform vec3 cameraPosition;
+
+uniform vec4 node; // heightmap x and z of the node's corner, heightmap samples per grid quad
+uniform vec2 morph; // morph end / (end - start), 1 / (end - start)
+
+in vec3 position; // grid coordinates within the patch, y unused
+
+out vec2 UV;
+out vec4 colour;
+
+float angleBetween(vec4 a, vec4 b)
+{
+	float n = dot(a, b);
+	float d = length(a) * length(b);
+	return degrees(acos(n / d));
+}
+
+float heightAt(vec2 coord)
+{
+	return textureLod(heightmapSampler, (coord + 0.5f) / heightmapSize, 0.0f).r;
+}
+
+vec3 worldPositionAt(vec2 coord)
+{
+	return terrainOrigin + vec3(coord.x * terrainScale, heightAt(coord), coord.y * terrainScale);
+}
+
+void main()
+{
+	vec2 coord = node.xy + position.xz * node.z;
+
+	// odd grid vertices slide onto their even neighbour towards the end of the level's range,
+	// so the patch matches the next coarser level by the time it switches
+	float morphK = 1.0f - clamp(morph.x - distance(worldPositionAt(coord), cameraPosition) * morph.y, 0.0f, 1.0f);
+	coord -= fract(position.xz * 0.5f) * 2.0f * node.z * morphK;
+	coord = min(coord, vec2(heightmapSize - 1.0f));
+
+	vec4 worldPosition = vec4(worldPositionAt(coord), 1.0f);
+
+	// central differences, in world units
+	float hl = heightAt(coord - vec2(1.0f, 0.0f)), hr = heightAt(coord + vec2(1.0f, 0.0f));
+	float hu = heightAt(coord - vec2(0.0f, 1.0f)), hd = heightAt(coord + vec2(0.0f, 1.0f));
+	vec4 worldNormal = vec4(normalize(vec3(hl - hr, 2.0f * terrainScale, hu - hd)), 0.0f);
+
+	vec4 lightToVertexRay = worldPosition - lightPosition;
+
+	// default brightness is ambient term
+	float energy = 0.5f;
+
+	// compute diffuse
+	if (dot(lightToVertexRay, worldNormal) <= 0) {
+		float brightness = angleBetween(lightToVertexRay, worldNormal) / 90.0f;
+
+		// compute attenuation (linear)
+		float attenuation = 1.0f / min((0.1f * distance(worldPosition, lightPosition)), 1.0f);
+
+		energy = max(attenuation * lightIntensity * brightness, 1.0f);
+	}
+
+	colour = energy * lightColour;
+	// texture repeats once per heightmap cell
+	UV = coord;
+	gl_Position = projection * viewMatrix * worldPosition;
+}
@@ -0,0 +1,238 @@
+#include <math.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define TERRAIN_QUERY_X86 1
+#include <immintrin.h>
+#endif
+
+#include "quantizedHeightmap.h"
+#include "terrain.h"
+#include "terrainStream.h"
+
+/*
+ * Every path below evaluates exactly the same sequence of float operations per
+ * point so the vector versions match the scalar one bit for bit, which is
+ * why the Makefile builds with -ffp-contract=off.
+ *
+ *	h0 x----x h1
+ *	   |  / |
+ *	   | /  |
+ *	h2 x----x h3
+ */
+
+/* heightmap coordinates are clamped to just outside the map first, which keeps them in int range */
+#define QUERY_MIN -2.0f
+
+static float sampleOrZero(const struct Terrain *t, int32_t x, int32_t z)
+{
+	if (x < 0 || z < 0 || x >= (int32_t) t->size || z >= (int32_t) t->size) {
+		return 0.0f;
+	}
+	return t->heightmap ? t->heightmap[getTerrainSampleIndex(t, x, z)] : getQuantizedHeight(t->quantized, x, z);
+}
+
+static void querySingle(const struct Terrain *t, float x, float z, float *height, float *normal, float *slope)
+{
+	const float hi = (float) t->size + 1.0f;
+	float tx = fminf(fmaxf((x - t->x) / t->scale, QUERY_MIN), hi);
+	float tz = fminf(fmaxf((z - t->z) / t->scale, QUERY_MIN), hi);
+	float gxf = floorf(tx), gzf = floorf(tz);
+	int32_t gx = (int32_t) gxf, gz = (int32_t) gzf;
+	float fx = tx - gxf, fz = tz - gzf;
+
+	float h0 = sampleOrZero(t, gx, gz), h1 = sampleOrZero(t, gx + 1, gz);
+	float h2 = sampleOrZero(t, gx, gz + 1), h3 = sampleOrZero(t, gx + 1, gz + 1);
+
+	float dx, dz;
+	if (fx + fz <= 1.0f) {
+		*height = h0 + (h1 - h0) * fx + (h2 - h0) * fz;
+		dx = h1 - h0; dz = h2 - h0;
+	} else {
+		*height = h3 + (h2 - h3) * (1.0f - fx) + (h1 - h3) * (1.0f - fz);
+		dx = h3 - h2; dz = h3 - h1;
+	}
+
+	if (normal || slope) {
+		dx = dx / t->scale; dz = dz / t->scale;
+		if (normal) {
+			float length = sqrtf(dx * dx + 1.0f + dz * dz);
+			normal[0] = -dx / length; normal[1] = 1.0f / length; normal[2] = -dz / length;
+		}
+		if (slope) {
+			*slope = sqrtf(dx * dx + dz * dz);
+		}
+	}
+}
+
+#ifdef TERRAIN_QUERY_X86
+/* SSE2 is always there on x86-64, four points at a time with scalar loads of the corners */
+static uint32_t querySSE2(const struct Terrain *t, const float *x, const float *z, uint32_t count,
+	float *heights, float *normals, float *slopes)
+{
+	const __m128 originX = _mm_set1_ps(t->x), originZ = _mm_set1_ps(t->z), scale = _mm_set1_ps(t->scale);
+	const __m128 lo = _mm_set1_ps(QUERY_MIN), hi = _mm_set1_ps((float) t->size + 1.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	uint32_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 tx = _mm_min_ps(_mm_max_ps(_mm_div_ps(_mm_sub_ps(_mm_loadu_ps(x + i), originX), scale), lo), hi);
+		__m128 tz = _mm_min_ps(_mm_max_ps(_mm_div_ps(_mm_sub_ps(_mm_loadu_ps(z + i), originZ), scale), lo), hi);
+
+		// floor: truncate, then step down where that rounded a negative value up
+		__m128i gx = _mm_cvttps_epi32(tx), gz = _mm_cvttps_epi32(tz);
+		gx = _mm_add_epi32(gx, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(gx), tx)));
+		gz = _mm_add_epi32(gz, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(gz), tz)));
+		__m128 fx = _mm_sub_ps(tx, _mm_cvtepi32_ps(gx)), fz = _mm_sub_ps(tz, _mm_cvtepi32_ps(gz));
+
+		int32_t ix[4], iz[4];
+		_mm_storeu_si128((__m128i *) ix, gx);
+		_mm_storeu_si128((__m128i *) iz, gz);
+		float c0[4], c1[4], c2[4], c3[4];
+		for (int j = 0; j < 4; j++) {
+			c0[j] = sampleOrZero(t, ix[j], iz[j]);
+			c1[j] = sampleOrZero(t, ix[j] + 1, iz[j]);
+			c2[j] = sampleOrZero(t, ix[j], iz[j] + 1);
+			c3[j] = sampleOrZero(t, ix[j] + 1, iz[j] + 1);
+		}
+		__m128 h0 = _mm_loadu_ps(c0), h1 = _mm_loadu_ps(c1), h2 = _mm_loadu_ps(c2), h3 = _mm_loadu_ps(c3);
+
+		__m128 upper = _mm_cmple_ps(_mm_add_ps(fx, fz), one);
+		__m128 upperHeight = _mm_add_ps(_mm_add_ps(h0, _mm_mul_ps(_mm_sub_ps(h1, h0), fx)),
+			_mm_mul_ps(_mm_sub_ps(h2, h0), fz));
+		__m128 lowerHeight = _mm_add_ps(_mm_add_ps(h3, _mm_mul_ps(_mm_sub_ps(h2, h3), _mm_sub_ps(one, fx))),
+			_mm_mul_ps(_mm_sub_ps(h1, h3), _mm_sub_ps(one, fz)));
+		_mm_storeu_ps(heights + i, _mm_or_ps(_mm_and_ps(upper, upperHeight), _mm_andnot_ps(upper, lowerHeight)));
+
+		if (!normals && !slopes) {
+			continue;
+		}
+		__m128 dx = _mm_or_ps(_mm_and_ps(upper, _mm_sub_ps(h1, h0)), _mm_andnot_ps(upper, _mm_sub_ps(h3, h2)));
+		__m128 dz = _mm_or_ps(_mm_and_ps(upper, _mm_sub_ps(h2, h0)), _mm_andnot_ps(upper, _mm_sub_ps(h3, h1)));
+		dx = _mm_div_ps(dx, scale); dz = _mm_div_ps(dz, scale);
+		__m128 dx2 = _mm_mul_ps(dx, dx), dz2 = _mm_mul_ps(dz, dz);
+		if (normals) {
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(dx2, one), dz2));
+			float nx[4], ny[4], nz[4];
+			_mm_storeu_ps(nx, _mm_div_ps(_mm_xor_ps(dx, _mm_set1_ps(-0.0f)), length));
+			_mm_storeu_ps(ny, _mm_div_ps(one, length));
+			_mm_storeu_ps(nz, _mm_div_ps(_mm_xor_ps(dz, _mm_set1_ps(-0.0f)), length));
+			for (int j = 0; j < 4; j++) {
+				normals[(i + j) * 3] = nx[j]; normals[(i + j) * 3 + 1] = ny[j]; normals[(i + j) * 3 + 2] = nz[j];
+			}
+		}
+		if (slopes) {
+			_mm_storeu_ps(slopes + i, _mm_sqrt_ps(_mm_add_ps(dx2, dz2)));
+		}
+	}
+	return i;
+}
+
+/* eight points at a time, corners fetched with masked gathers so off-map samples read as 0 */
+__attribute__((target("avx2")))
+static uint32_t queryAVX2(const struct Terrain *t, const float *x, const float *z, uint32_t count,
+	float *heights, float *normals, float *slopes)
+{
+	const __m256 originX = _mm256_set1_ps(t->x), originZ = _mm256_set1_ps(t->z), scale = _mm256_set1_ps(t->scale);
+	const __m256 lo = _mm256_set1_ps(QUERY_MIN), hi = _mm256_set1_ps((float) t->size + 1.0f);
+	const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+	const __m256i size = _mm256_set1_epi32((int32_t) t->size), minusOne = _mm256_set1_epi32(-1);
+	const __m256i oneI = _mm256_set1_epi32(1);
+
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 tx = _mm256_min_ps(_mm256_max_ps(_mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(x + i), originX),
+			scale), lo), hi);
+		__m256 tz = _mm256_min_ps(_mm256_max_ps(_mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(z + i), originZ),
+			scale), lo), hi);
+		__m256 gxf = _mm256_floor_ps(tx), gzf = _mm256_floor_ps(tz);
+		__m256i gx = _mm256_cvttps_epi32(gxf), gz = _mm256_cvttps_epi32(gzf);
+		__m256 fx = _mm256_sub_ps(tx, gxf), fz = _mm256_sub_ps(tz, gzf);
+
+		// a coordinate is usable if -1 < c < size
+		__m256i gx1 = _mm256_add_epi32(gx, oneI), gz1 = _mm256_add_epi32(gz, oneI);
+		__m256i inX0 = _mm256_and_si256(_mm256_cmpgt_epi32(gx, minusOne), _mm256_cmpgt_epi32(size, gx));
+		__m256i inX1 = _mm256_and_si256(_mm256_cmpgt_epi32(gx1, minusOne), _mm256_cmpgt_epi32(size, gx1));
+		__m256i inZ0 = _mm256_and_si256(_mm256_cmpgt_epi32(gz, minusOne), _mm256_cmpgt_epi32(size, gz));
+		__m256i inZ1 = _mm256_and_si256(_mm256_cmpgt_epi32(gz1, minusOne), _mm256_cmpgt_epi32(size, gz1));
+		__m256i row0 = _mm256_mullo_epi32(gz, size), row1 = _mm256_add_epi32(row0, size);
+
+		__m256 h0 = _mm256_mask_i32gather_ps(zero, t->heightmap, _mm256_add_epi32(row0, gx),
+			_mm256_castsi256_ps(_mm256_and_si256(inX0, inZ0)), 4);
+		__m256 h1 = _mm256_mask_i32gather_ps(zero, t->heightmap, _mm256_add_epi32(row0, gx1),
+			_mm256_castsi256_ps(_mm256_and_si256(inX1, inZ0)), 4);
+		__m256 h2 = _mm256_mask_i32gather_ps(zero, t->heightmap, _mm256_add_epi32(row1, gx),
+			_mm256_castsi256_ps(_mm256_and_si256(inX0, inZ1)), 4);
+		__m256 h3 = _mm256_mask_i32gather_ps(zero, t->heightmap, _mm256_add_epi32(row1, gx1),
+			_mm256_castsi256_ps(_mm256_and_si256(inX1, inZ1)), 4);
+
+		__m256 upper = _mm256_cmp_ps(_mm256_add_ps(fx, fz), one, _CMP_LE_OQ);
+		__m256 upperHeight = _mm256_add_ps(_mm256_add_ps(h0, _mm256_mul_ps(_mm256_sub_ps(h1, h0), fx)),
+			_mm256_mul_ps(_mm256_sub_ps(h2, h0), fz));
+		__m256 lowerHeight = _mm256_add_ps(_mm256_add_ps(h3, _mm256_mul_ps(_mm256_sub_ps(h2, h3),
+			_mm256_sub_ps(one, fx))), _mm256_mul_ps(_mm256_sub_ps(h1, h3), _mm256_sub_ps(one, fz)));
+		_mm256_storeu_ps(heights + i, _mm256_blendv_ps(lowerHeight, upperHeight, upper));
+
+		if (!normals && !slopes) {
+			continue;
+		}
+		__m256 dx = _mm256_blendv_ps(_mm256_sub_ps(h3, h2), _mm256_sub_ps(h1, h0), upper);
+		__m256 dz = _mm256_blendv_ps(_mm256_sub_ps(h3, h1), _mm256_sub_ps(h2, h0), upper);
+		dx = _mm256_div_ps(dx, scale); dz = _mm256_div_ps(dz, scale);
+		__m256 dx2 = _mm256_mul_ps(dx, dx), dz2 = _mm256_mul_ps(dz, dz);
+		if (normals) {
+			__m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(dx2, one), dz2));
+			float nx[8], ny[8], nz[8];
+			_mm256_storeu_ps(nx, _mm256_div_ps(_mm256_xor_ps(dx, _mm256_set1_ps(-0.0f)), length));
+			_mm256_storeu_ps(ny, _mm256_div_ps(one, length));
+			_mm256_storeu_ps(nz, _mm256_div_ps(_mm256_xor_ps(dz, _mm256_set1_ps(-0.0f)), length));
+			for (int j = 0; j < 8; j++) {
+				normals[(i + j) * 3] = nx[j]; normals[(i + j) * 3 + 1] = ny[j]; normals[(i + j) * 3 + 2] = nz[j];
+			}
+		}
+		if (slopes) {
+			_mm256_storeu_ps(slopes + i, _mm256_sqrt_ps(_mm256_add_ps(dx2, dz2)));
+		}
+	}
+	return i;
+}
+#endif
+
+void terrainGetHeightsAt(struct Terrain *t, const float *x, const float *z, uint32_t count, float *heights,
+	float *normals, float *slopes)
+{
+	uint32_t i = 0;
+	if (t->stream) {
+		// points can land in different tiles, no vector path
+		for (; i < count; i++) {
+			const struct Terrain *tile = getTerrainStreamTile(t, x[i], z[i]);
+			if (tile) {
+				querySingle(tile, x[i], z[i], &heights[i], normals ? &normals[i * 3] : NULL,
+					slopes ? &slopes[i] : NULL);
+				continue;
+			}
+			// flat ground at 0, as off the edge of a map
+			heights[i] = 0.0f;
+			if (normals) {
+				normals[i * 3] = 0.0f; normals[i * 3 + 1] = 1.0f; normals[i * 3 + 2] = 0.0f;
+			}
+			if (slopes) {
+				slopes[i] = 0.0f;
+			}
+		}
+		return;
+	}
+
+#ifdef TERRAIN_QUERY_X86
+	// gathers read the float heightmap directly, row-major, and index it with 32 bit ints
+	if (__builtin_cpu_supports("avx2") && t->heightmap && !t->tiled && (uint64_t) t->size * t->size <= INT32_MAX) {
+		i = queryAVX2(t, x, z, count, heights, normals, slopes);
+	}
+	i += querySSE2(t, x + i, z + i, count - i, heights + i, normals ? normals + i * 3 : NULL,
+		slopes ? slopes + i : NULL);
+#endif
+
+	for (; i < count; i++) {
+		querySingle(t, x[i], z[i], &heights[i], normals ? &normals[i * 3] : NULL, slopes ? &slopes[i] : NULL);
+	}
+}
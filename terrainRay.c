@@ -0,0 +1,257 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "terrainRay.h"
+
+/* slack when deciding which triangle of a quad a hit is in, so rays can't slip through the diagonal */
+#define TRIANGLE_EPSILON 1e-5f
+
+/* a ray in heightmap space, x and z in samples and y in world units relative to the terrain */
+struct TerrainRay {
+	const struct Terrain *t;
+	float origin[3], direction[3];
+	float distance;
+};
+
+/* min and max of a cell, from the heightmap at level 0 and from its children above that */
+static void buildPyramidCell(const struct Terrain *t, uint32_t level, uint32_t cx, uint32_t cz)
+{
+	struct TerrainPyramid *pyramid = t->pyramid;
+	float lo = INFINITY, hi = -INFINITY;
+	for (uint32_t i = 0; i < 4; i++) {
+		uint32_t x = cx * 2 + (i & 1), z = cz * 2 + (i >> 1);
+		if (level == 0) {
+			// the corners of the quad
+			float h = t->heightmap[getTerrainSampleIndex(t, cx + (i & 1), cz + (i >> 1))];
+			lo = fminf(lo, h);
+			hi = fmaxf(hi, h);
+		} else if (x < pyramid->cellsPerSide[level - 1] && z < pyramid->cellsPerSide[level - 1]) {
+			const float *child = &pyramid->minMax[level - 1][(x + z * pyramid->cellsPerSide[level - 1]) * 2];
+			lo = fminf(lo, child[0]);
+			hi = fmaxf(hi, child[1]);
+		}
+	}
+	float *minMax = &pyramid->minMax[level][(cx + cz * pyramid->cellsPerSide[level]) * 2];
+	minMax[0] = lo;
+	minMax[1] = hi;
+}
+
+bool buildTerrainPyramid(struct Terrain *t)
+{
+	if (!t->heightmap || t->size < 2) {
+		return false;
+	}
+	struct TerrainPyramid *pyramid = calloc(1, sizeof(struct TerrainPyramid));
+	if (!pyramid) {
+		return false;
+	}
+	t->pyramid = pyramid;
+
+	const uint32_t quads = t->size - 1;
+	for (uint32_t level = 0; level < TERRAIN_PYRAMID_MAX_LEVELS; level++) {
+		const uint32_t cellSize = 1u << level, n = (quads + cellSize - 1) / cellSize;
+		pyramid->minMax[level] = malloc((size_t) n * n * 2 * sizeof(float));
+		if (!pyramid->minMax[level]) {
+			cleanupTerrainPyramid(pyramid);
+			t->pyramid = NULL;
+			return false;
+		}
+		pyramid->cellsPerSide[level] = n;
+		pyramid->numLevels++;
+
+		for (uint32_t cz = 0; cz < n; cz++) {
+			for (uint32_t cx = 0; cx < n; cx++) {
+				buildPyramidCell(t, level, cx, cz);
+			}
+		}
+		if (n == 1) {
+			break;
+		}
+	}
+	return true;
+}
+
+void updateTerrainPyramid(struct Terrain *t, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1)
+{
+	const struct TerrainPyramid *pyramid = t->pyramid;
+	// quads that have one of the samples as a corner
+	uint32_t cx0 = x0 ? x0 - 1 : 0, cz0 = z0 ? z0 - 1 : 0;
+	uint32_t cx1 = x1 < pyramid->cellsPerSide[0] ? x1 : pyramid->cellsPerSide[0] - 1;
+	uint32_t cz1 = z1 < pyramid->cellsPerSide[0] ? z1 : pyramid->cellsPerSide[0] - 1;
+	for (uint32_t level = 0; level < pyramid->numLevels; level++) {
+		for (uint32_t cz = cz0; cz <= cz1; cz++) {
+			for (uint32_t cx = cx0; cx <= cx1; cx++) {
+				buildPyramidCell(t, level, cx, cz);
+			}
+		}
+		cx0 /= 2; cz0 /= 2; cx1 /= 2; cz1 /= 2;
+	}
+}
+
+void cleanupTerrainPyramid(struct TerrainPyramid *pyramid)
+{
+	for (uint32_t level = 0; level < pyramid->numLevels; level++) {
+		free(pyramid->minMax[level]);
+	}
+	free(pyramid);
+}
+
+/* narrows [s0, s1] to where the ray is between lo and hi along one axis */
+static bool clipSlab(float origin, float direction, float lo, float hi, float *s0, float *s1)
+{
+	if (direction == 0.0f) {
+		return origin >= lo && origin <= hi;
+	}
+	float a = (lo - origin) / direction, b = (hi - origin) / direction;
+	if (a > b) {
+		float tmp = a; a = b; b = tmp;
+	}
+	*s0 = fmaxf(*s0, a);
+	*s1 = fminf(*s1, b);
+	return *s0 <= *s1;
+}
+
+static bool clipCell(const struct TerrainRay *r, uint32_t level, uint32_t cx, uint32_t cz, float *s0, float *s1)
+{
+	const uint32_t quads = r->t->size - 1;
+	const uint32_t x0 = cx << level, z0 = cz << level;
+	const uint32_t x1 = (cx + 1) << level < quads ? (cx + 1) << level : quads;
+	const uint32_t z1 = (cz + 1) << level < quads ? (cz + 1) << level : quads;
+	return clipSlab(r->origin[0], r->direction[0], (float) x0, (float) x1, s0, s1) &&
+		clipSlab(r->origin[2], r->direction[2], (float) z0, (float) z1, s0, s1);
+}
+
+/*
+ * Where the ray meets the plane through grid point (px, pz) at height h with
+ * gradients dx and dz, or -1 if it runs parallel to it.
+ */
+static float intersectPlane(const struct TerrainRay *r, float px, float pz, float h, float dx, float dz)
+{
+	float denominator = r->direction[1] - dx * r->direction[0] - dz * r->direction[2];
+	if (denominator == 0.0f) {
+		return -1.0f;
+	}
+	return (h + dx * (r->origin[0] - px) + dz * (r->origin[2] - pz) - r->origin[1]) / denominator;
+}
+
+/* the two triangles of quad (x, z), split the same way as the mesh and terrainGetHeightAt */
+static bool intersectQuad(struct TerrainRay *r, uint32_t x, uint32_t z, float s0, float s1)
+{
+	const struct Terrain *t = r->t;
+	const float h0 = t->heightmap[getTerrainSampleIndex(t, x, z)];
+	const float h1 = t->heightmap[getTerrainSampleIndex(t, x + 1, z)];
+	const float h2 = t->heightmap[getTerrainSampleIndex(t, x, z + 1)];
+	const float h3 = t->heightmap[getTerrainSampleIndex(t, x + 1, z + 1)];
+	const float fx0 = (float) x, fz0 = (float) z;
+
+	bool hit = false;
+	float s = intersectPlane(r, fx0, fz0, h0, h1 - h0, h2 - h0);
+	if (s >= s0 && s <= s1) {
+		float fx = r->origin[0] + r->direction[0] * s - fx0, fz = r->origin[2] + r->direction[2] * s - fz0;
+		if (fx + fz <= 1.0f + TRIANGLE_EPSILON) {
+			r->distance = s;
+			hit = true;
+		}
+	}
+	s = intersectPlane(r, fx0 + 1.0f, fz0 + 1.0f, h3, h3 - h2, h3 - h1);
+	if (s >= s0 && s <= s1 && (!hit || s < r->distance)) {
+		float fx = r->origin[0] + r->direction[0] * s - fx0, fz = r->origin[2] + r->direction[2] * s - fz0;
+		if (fx + fz >= 1.0f - TRIANGLE_EPSILON) {
+			r->distance = s;
+			hit = true;
+		}
+	}
+	return hit;
+}
+
+/* [s0, s1] is the part of the ray inside the cell, children are visited front to back */
+static bool traceCell(struct TerrainRay *r, uint32_t level, uint32_t cx, uint32_t cz, float s0, float s1)
+{
+	const struct TerrainPyramid *pyramid = r->t->pyramid;
+	const float *minMax = &pyramid->minMax[level][(cx + cz * pyramid->cellsPerSide[level]) * 2];
+	float y0 = r->origin[1] + r->direction[1] * s0, y1 = r->origin[1] + r->direction[1] * s1;
+	if (fminf(y0, y1) > minMax[1] || fmaxf(y0, y1) < minMax[0]) {
+		return false; // passes entirely above or below everything in the cell
+	}
+	if (level == 0) {
+		return intersectQuad(r, cx, cz, s0, s1);
+	}
+
+	struct {
+		uint32_t x, z;
+		float s0, s1;
+	} children[4];
+	uint32_t numChildren = 0;
+	const uint32_t n = pyramid->cellsPerSide[level - 1];
+	for (uint32_t i = 0; i < 4; i++) {
+		uint32_t x = cx * 2 + (i & 1), z = cz * 2 + (i >> 1);
+		float c0 = s0, c1 = s1;
+		if (x >= n || z >= n || !clipCell(r, level - 1, x, z, &c0, &c1)) {
+			continue;
+		}
+		uint32_t j = numChildren++;
+		for (; j > 0 && children[j - 1].s0 > c0; j--) {
+			children[j] = children[j - 1];
+		}
+		children[j].x = x; children[j].z = z;
+		children[j].s0 = c0; children[j].s1 = c1;
+	}
+
+	// children don't overlap, so the first hit is the nearest
+	for (uint32_t i = 0; i < numChildren; i++) {
+		if (traceCell(r, level - 1, children[i].x, children[i].z, children[i].s0, children[i].s1)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* builds the pyramid on first use, false if the terrain has no float heightmap to build it from */
+static bool hasPyramid(struct Terrain *t)
+{
+	return t->pyramid || buildTerrainPyramid(t);
+}
+
+bool terrainRaycast(struct Terrain *t, const float *origin, const float *direction, float maxDistance,
+	float *distance)
+{
+	if (!hasPyramid(t)) {
+		return false;
+	}
+	struct TerrainRay r = {
+		.t = t,
+		.origin = {(origin[0] - t->x) / t->scale, origin[1] - t->y, (origin[2] - t->z) / t->scale},
+		.direction = {direction[0] / t->scale, direction[1], direction[2] / t->scale}
+	};
+
+	float s0 = 0.0f, s1 = maxDistance;
+	const uint32_t top = t->pyramid->numLevels - 1;
+	if (!clipCell(&r, top, 0, 0, &s0, &s1) || !traceCell(&r, top, 0, 0, s0, s1)) {
+		return false;
+	}
+	*distance = r.distance;
+	return true;
+}
+
+bool terrainLineOfSight(struct Terrain *t, const float *from, const float *to, bool *visible)
+{
+	if (!hasPyramid(t)) {
+		return false;
+	}
+	const float direction[] = {to[0] - from[0], to[1] - from[1], to[2] - from[2]};
+	float distance;
+	// direction is the whole segment, so it ends at 1
+	*visible = !terrainRaycast(t, from, direction, 1.0f, &distance);
+	return true;
+}
+
+bool terrainLinesOfSight(struct Terrain *t, const float *from, const float *to, uint32_t count, bool *visible)
+{
+	if (!hasPyramid(t)) {
+		return false;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		terrainLineOfSight(t, &from[i * 3], &to[i * 3], &visible[i]);
+	}
+	return true;
+}
@@ -0,0 +1,56 @@
+#ifndef TERRAIN_RAY_H
+#define TERRAIN_RAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "terrain.h"
+
+#define TERRAIN_PYRAMID_MAX_LEVELS 32
+
+/*
+ * Min/max height pyramid over a terrain's heightmap. A level 0 cell is a single
+ * quad of the mesh and every level up halves the cells along each side, until
+ * one cell covers the whole map. Rays only descend into cells whose height range
+ * they pass through, so empty space is skipped in large steps and the cost
+ * grows with the log of the map size rather than the length of the ray.
+ */
+struct TerrainPyramid {
+	uint32_t numLevels;
+	uint32_t cellsPerSide[TERRAIN_PYRAMID_MAX_LEVELS];
+	float *minMax[TERRAIN_PYRAMID_MAX_LEVELS]; /* min and max height of every cell, row-major per level */
+};
+
+/*
+ * Builds t->pyramid from the float heightmap, so not for streamed or compacted
+ * terrain. The queries below call it on first use, calling it up front just
+ * moves the cost to load time.
+ */
+bool buildTerrainPyramid(struct Terrain *t);
+
+/* recomputes the cells over heightmap samples (x0, z0) to (x1, z1) after they change */
+void updateTerrainPyramid(struct Terrain *t, uint32_t x0, uint32_t z0, uint32_t x1, uint32_t z1);
+
+void cleanupTerrainPyramid(struct TerrainPyramid *pyramid);
+
+/*
+ * Finds the first point along origin + direction * s, 0 <= s <= maxDistance,
+ * where the ray meets the terrain mesh and stores s in distance. direction
+ * doesn't have to be normalised, but distance is only in world units if it is.
+ * Returns false on a miss, or if the terrain has no pyramid and none can be
+ * built (streamed or compacted terrain).
+ */
+bool terrainRaycast(struct Terrain *t, const float *origin, const float *direction, float maxDistance,
+	float *distance);
+
+/*
+ * Sets visible if nothing but air lies on the segment between points from and
+ * to. Returns false, leaving visible alone, if the terrain can't be traced (see
+ * terrainRaycast), rather than reporting every segment as clear.
+ */
+bool terrainLineOfSight(struct Terrain *t, const float *from, const float *to, bool *visible);
+
+/* terrainLineOfSight for count pairs of points, 3 floats each */
+bool terrainLinesOfSight(struct Terrain *t, const float *from, const float *to, uint32_t count, bool *visible);
+
+#endif
@@ -0,0 +1,389 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "terrainStream.h"
+
+static float tileWorldSize(struct Terrain *t)
+{
+	return (float) t->stream->tileSize * t->scale;
+}
+
+/* distance in the xz plane from (x, z) to the nearest point of a tile */
+static float distanceToTile(struct Terrain *t, int32_t tx, int32_t tz, float x, float z)
+{
+	const float size = tileWorldSize(t);
+	const float x0 = t->x + tx * size, z0 = t->z + tz * size;
+	float dx = x < x0 ? x0 - x : (x > x0 + size ? x - (x0 + size) : 0.0f);
+	float dz = z < z0 ? z0 - z : (z > z0 + size ? z - (z0 + size) : 0.0f);
+	return sqrtf(dx * dx + dz * dz);
+}
+
+static struct TerrainTile *findTile(struct TerrainStream *s, int32_t tx, int32_t tz)
+{
+	for (uint32_t i = 0; i < s->maxTiles; i++) {
+		struct TerrainTile *tile = &s->tiles[i];
+		if (tile->state != TERRAIN_TILE_FREE && tile->x == tx && tile->z == tz) {
+			return tile;
+		}
+	}
+	return NULL;
+}
+
+/* frees everything a tile holds, the stream mutex must be held or the loader thread stopped */
+static void releaseTile(struct TerrainTile *tile)
+{
+	if (tile->chunkData) {
+		freeTerrainChunkData(tile->chunkData, getTerrainNumChunks(tile->terrain->size));
+	}
+	if (tile->terrain) {
+		tile->terrain->texture = 0; // owned by the stream
+		cleanupTerrain(tile->terrain);
+	}
+	memset(tile, 0, sizeof(struct TerrainTile));
+}
+
+/* the tile's heightmap, NULL if it has no file */
+static struct Terrain *loadTile(struct TerrainStream *s, int32_t tx, int32_t tz)
+{
+	// native tiles are preferred, they map without decoding
+	char path[4096];
+	snprintf(path, sizeof(path), "%s/%d_%d.hmap", s->directory, tx, tz);
+	FILE *file = fopen(path, "rb"); // tiles past the edge of the world are expected to be missing
+	if (!file) {
+		snprintf(path, sizeof(path), "%s/%d_%d.png", s->directory, tx, tz);
+		file = fopen(path, "rb");
+	}
+	if (!file) {
+		return NULL;
+	}
+	fclose(file);
+	return loadTerrainHeightmap(s->tileSize + 1, path, s->scale);
+}
+
+/* copies the apron samples that lie in the neighbour dx, dz tiles away, apron (ax, az) is tile sample (ax - 1, az - 1) */
+static void copyNeighbourSamples(struct TerrainStream *s, const struct Terrain *neighbour, float *apron, int32_t dx,
+	int32_t dz)
+{
+	const uint32_t n = s->tileSize + 3;
+	const uint32_t ax0 = dx < 0 ? 0 : (dx > 0 ? n - 1 : 1), ax1 = dx < 0 ? 0 : (dx > 0 ? n - 1 : n - 2);
+	const uint32_t az0 = dz < 0 ? 0 : (dz > 0 ? n - 1 : 1), az1 = dz < 0 ? 0 : (dz > 0 ? n - 1 : n - 2);
+	for (uint32_t az = az0; az <= az1; az++) {
+		for (uint32_t ax = ax0; ax <= ax1; ax++) {
+			const uint32_t x = (uint32_t) ((int32_t) ax - 1 - dx * (int32_t) s->tileSize);
+			const uint32_t z = (uint32_t) ((int32_t) az - 1 - dz * (int32_t) s->tileSize);
+			apron[ax + az * n] = neighbour->heightmap[getTerrainSampleIndex(neighbour, x, z)];
+		}
+	}
+}
+
+/*
+ * The tile's samples with a one sample border from its eight neighbours, so
+ * normals along shared edges match on both sides. Neighbours already loaded
+ * are read under the lock, others are loaded from their files just for the
+ * border. Where there's no neighbour the tile's edge is repeated outwards.
+ */
+static float *loadTileApron(struct TerrainStream *s, const struct Terrain *terrain, int32_t tx, int32_t tz)
+{
+	const uint32_t size = s->tileSize + 1, n = size + 2;
+	float *apron = malloc((size_t) n * n * sizeof(float));
+	if (!apron) {
+		return NULL;
+	}
+	for (uint32_t az = 0; az < n; az++) {
+		for (uint32_t ax = 0; ax < n; ax++) {
+			const uint32_t x = ax ? (ax - 1 < size ? ax - 1 : size - 1) : 0;
+			const uint32_t z = az ? (az - 1 < size ? az - 1 : size - 1) : 0;
+			apron[ax + az * n] = terrain->heightmap[getTerrainSampleIndex(terrain, x, z)];
+		}
+	}
+
+	for (int32_t dz = -1; dz <= 1; dz++) {
+		for (int32_t dx = -1; dx <= 1; dx++) {
+			if (!dx && !dz) {
+				continue;
+			}
+			// a loaded or resident neighbour's heightmap isn't freed while the lock is held
+			pthread_mutex_lock(&s->mutex);
+			const struct TerrainTile *tile = findTile(s, tx + dx, tz + dz);
+			const bool missing = tile && tile->state == TERRAIN_TILE_MISSING;
+			const bool copied = tile && tile->terrain;
+			if (copied) {
+				copyNeighbourSamples(s, tile->terrain, apron, dx, dz);
+			}
+			pthread_mutex_unlock(&s->mutex);
+			if (copied || missing) {
+				continue;
+			}
+			struct Terrain *neighbour = loadTile(s, tx + dx, tz + dz);
+			if (neighbour) {
+				copyNeighbourSamples(s, neighbour, apron, dx, dz);
+				freeTerrainHeightmap(neighbour);
+			}
+		}
+	}
+	return apron;
+}
+
+static void *loaderThread(void *arg)
+{
+	struct TerrainStream *s = arg;
+	const float size = (float) s->tileSize * s->scale;
+
+	pthread_mutex_lock(&s->mutex);
+	while (s->running) {
+		// nearest outstanding request first
+		struct TerrainTile *next = NULL;
+		float nearest = INFINITY;
+		for (uint32_t i = 0; i < s->maxTiles; i++) {
+			struct TerrainTile *tile = &s->tiles[i];
+			if (tile->state != TERRAIN_TILE_REQUESTED) {
+				continue;
+			}
+			float dx = (tile->x + 0.5f) * size - s->cameraX, dz = (tile->z + 0.5f) * size - s->cameraZ;
+			if (dx * dx + dz * dz < nearest) {
+				nearest = dx * dx + dz * dz;
+				next = tile;
+			}
+		}
+		if (!next) {
+			pthread_cond_wait(&s->requested, &s->mutex);
+			continue;
+		}
+		next->state = TERRAIN_TILE_LOADING;
+		int32_t tx = next->x, tz = next->z;
+		pthread_mutex_unlock(&s->mutex);
+
+		struct Terrain *terrain = loadTile(s, tx, tz);
+		struct TerrainChunkData *chunkData = NULL;
+		if (terrain) {
+			float *apron = loadTileApron(s, terrain, tx, tz);
+			if (apron) {
+				chunkData = prepareTerrainChunksWithApron(terrain, apron);
+				free(apron);
+			}
+		}
+
+		pthread_mutex_lock(&s->mutex);
+		next->terrain = terrain;
+		next->chunkData = chunkData;
+		next->state = chunkData ? TERRAIN_TILE_LOADED : TERRAIN_TILE_MISSING;
+		pthread_cond_broadcast(&s->loaded);
+	}
+	pthread_mutex_unlock(&s->mutex);
+	return NULL;
+}
+
+struct Terrain *streamTerrain(const char *directory, uint32_t tileSize, float scale, float radius,
+	const char *texture, GLint positionAttribLocation, GLint vertexUVAttribLocation, GLint normalAttribLocation)
+{
+	struct Terrain *terrain = calloc(1, sizeof(struct Terrain));
+	if (!terrain) {
+		return NULL;
+	}
+	terrain->scale = scale;
+
+	struct TerrainStream *s = calloc(1, sizeof(struct TerrainStream));
+	if (!s) {
+		free(terrain);
+		return NULL;
+	}
+
+	s->directory = malloc(strlen(directory) + 1);
+	// every tile within radius plus the extra tile kept before eviction
+	uint32_t side = 2 * (uint32_t) ceilf(radius / (tileSize * scale) + 1.0f) + 2;
+	s->maxTiles = side * side;
+	s->tiles = calloc(s->maxTiles, sizeof(struct TerrainTile));
+	if (!s->directory || !s->tiles) {
+		free(s->directory); free(s->tiles); free(s); free(terrain);
+		return NULL;
+	}
+	strcpy(s->directory, directory);
+	s->tileSize = tileSize;
+	s->scale = scale;
+	s->radius = radius;
+	s->positionAttribLocation = positionAttribLocation;
+	s->vertexUVAttribLocation = vertexUVAttribLocation;
+	s->normalAttribLocation = normalAttribLocation;
+
+	pthread_mutex_init(&s->mutex, NULL);
+	pthread_cond_init(&s->requested, NULL);
+	pthread_cond_init(&s->loaded, NULL);
+	s->running = true;
+	if (pthread_create(&s->thread, NULL, loaderThread, s)) {
+		fprintf(stderr, "Could not start the terrain loader thread.\n");
+		s->running = false;
+		pthread_mutex_destroy(&s->mutex); pthread_cond_destroy(&s->requested); pthread_cond_destroy(&s->loaded);
+		free(s->directory); free(s->tiles); free(s); free(terrain);
+		return NULL;
+	}
+
+	s->texture = loadTerrainTexture(texture);
+	terrain->stream = s;
+	return terrain;
+}
+
+static void uploadTile(struct Terrain *t, struct TerrainTile *tile)
+{
+	struct TerrainStream *s = t->stream;
+	struct Terrain *terrain = tile->terrain;
+
+	terrain->texture = s->texture;
+	terrain->x = t->x + tile->x * tileWorldSize(t);
+	terrain->y = t->y;
+	terrain->z = t->z + tile->z * tileWorldSize(t);
+	bool uploaded = uploadTerrainChunks(terrain, tile->chunkData, s->positionAttribLocation,
+		s->vertexUVAttribLocation, s->normalAttribLocation);
+	freeTerrainChunkData(tile->chunkData, getTerrainNumChunks(terrain->size));
+	tile->chunkData = NULL;
+
+	pthread_mutex_lock(&s->mutex);
+	if (uploaded) {
+		tile->state = TERRAIN_TILE_RESIDENT;
+		tile->resident = true;
+	} else {
+		terrain->texture = 0;
+		cleanupTerrain(terrain);
+		tile->terrain = NULL;
+		tile->state = TERRAIN_TILE_MISSING;
+	}
+	pthread_mutex_unlock(&s->mutex);
+}
+
+void updateTerrainStream(struct Terrain *t, float x, float z, bool wait)
+{
+	struct TerrainStream *s = t->stream;
+	const float size = tileWorldSize(t);
+
+	pthread_mutex_lock(&s->mutex);
+	s->cameraX = x - t->x;
+	s->cameraZ = z - t->z;
+
+	// evict past the load radius plus a tile, so moving back and forth over a border doesn't thrash
+	for (uint32_t i = 0; i < s->maxTiles; i++) {
+		struct TerrainTile *tile = &s->tiles[i];
+		if (tile->state == TERRAIN_TILE_FREE || tile->state == TERRAIN_TILE_LOADING) {
+			continue;
+		}
+		if (distanceToTile(t, tile->x, tile->z, x, z) > s->radius + size) {
+			releaseTile(tile);
+		}
+	}
+
+	// request everything in range that isn't already known
+	int32_t minX = (int32_t) floorf((x - t->x - s->radius) / size), maxX = (int32_t) floorf((x - t->x + s->radius) / size);
+	int32_t minZ = (int32_t) floorf((z - t->z - s->radius) / size), maxZ = (int32_t) floorf((z - t->z + s->radius) / size);
+	bool requested = false;
+	for (int32_t tz = minZ; tz <= maxZ; tz++) {
+		for (int32_t tx = minX; tx <= maxX; tx++) {
+			if (distanceToTile(t, tx, tz, x, z) > s->radius || findTile(s, tx, tz)) {
+				continue;
+			}
+			struct TerrainTile *slot = NULL;
+			for (uint32_t i = 0; i < s->maxTiles && !slot; i++) {
+				if (s->tiles[i].state == TERRAIN_TILE_FREE) {
+					slot = &s->tiles[i];
+				}
+			}
+			if (!slot) {
+				continue; // tiles still loading past the eviction distance, try again next frame
+			}
+			slot->x = tx;
+			slot->z = tz;
+			slot->state = TERRAIN_TILE_REQUESTED;
+			requested = true;
+		}
+	}
+	if (requested) {
+		pthread_cond_signal(&s->requested);
+	}
+
+	// upload finished tiles, a limited number per frame unless waiting
+	uint32_t uploads = 0;
+	for (;;) {
+		struct TerrainTile *ready = NULL;
+		bool outstanding = false;
+		for (uint32_t i = 0; i < s->maxTiles; i++) {
+			struct TerrainTile *tile = &s->tiles[i];
+			if (tile->state == TERRAIN_TILE_LOADED && !ready) {
+				ready = tile;
+			} else if (tile->state == TERRAIN_TILE_REQUESTED || tile->state == TERRAIN_TILE_LOADING) {
+				outstanding = true;
+			}
+		}
+
+		if (ready && (wait || uploads < TERRAIN_STREAM_UPLOADS_PER_FRAME)) {
+			// the loader thread never touches a loaded tile, so it can be uploaded without the lock
+			pthread_mutex_unlock(&s->mutex);
+			uploadTile(t, ready);
+			uploads++;
+			pthread_mutex_lock(&s->mutex);
+		} else if (wait && outstanding) {
+			pthread_cond_wait(&s->loaded, &s->mutex);
+		} else {
+			break;
+		}
+	}
+	pthread_mutex_unlock(&s->mutex);
+}
+
+struct Terrain *getTerrainStreamTile(struct Terrain *t, float x, float z)
+{
+	struct TerrainStream *s = t->stream;
+	const float size = tileWorldSize(t);
+	const int32_t tx = (int32_t) floorf((x - t->x) / size), tz = (int32_t) floorf((z - t->z) / size);
+
+	for (uint32_t i = 0; i < s->maxTiles; i++) {
+		struct TerrainTile *tile = &s->tiles[i];
+		if (tile->resident && tile->x == tx && tile->z == tz) {
+			return tile->terrain;
+		}
+	}
+	return NULL;
+}
+
+float terrainStreamGetHeightAt(struct Terrain *t, float x, float z)
+{
+	struct Terrain *tile = getTerrainStreamTile(t, x, z);
+	return tile ? terrainGetHeightAt(tile, x, z) : 0.0f;
+}
+
+uint32_t queueTerrainStream(struct Terrain *t, struct RenderQueue *queue, uint32_t program)
+{
+	struct TerrainStream *s = t->stream;
+	const float size = tileWorldSize(t);
+
+	uint32_t numQueued = 0;
+	for (uint32_t i = 0; i < s->maxTiles; i++) {
+		struct TerrainTile *tile = &s->tiles[i];
+		if (!tile->resident) {
+			continue;
+		}
+		tile->terrain->x = t->x + tile->x * size;
+		tile->terrain->y = t->y;
+		tile->terrain->z = t->z + tile->z * size;
+		numQueued += queueTerrain(tile->terrain, queue, program);
+	}
+	return numQueued;
+}
+
+void cleanupTerrainStream(struct TerrainStream *s)
+{
+	pthread_mutex_lock(&s->mutex);
+	s->running = false;
+	pthread_cond_signal(&s->requested);
+	pthread_mutex_unlock(&s->mutex);
+	pthread_join(s->thread, NULL);
+
+	for (uint32_t i = 0; i < s->maxTiles; i++) {
+		releaseTile(&s->tiles[i]);
+	}
+	glDeleteTextures(1, &s->texture);
+	pthread_mutex_destroy(&s->mutex);
+	pthread_cond_destroy(&s->requested);
+	pthread_cond_destroy(&s->loaded);
+	free(s->directory);
+	free(s->tiles);
+	free(s);
+}
@@ -0,0 +1,77 @@
+#ifndef TERRAIN_STREAM_H
+#define TERRAIN_STREAM_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+#include "terrain.h"
+
+/* tiles uploaded per call to updateTerrainStream, loading is spread over frames so it doesn't hitch */
+#define TERRAIN_STREAM_UPLOADS_PER_FRAME 1
+
+enum TerrainTileState {
+	TERRAIN_TILE_FREE, /* slot unused */
+	TERRAIN_TILE_REQUESTED, /* waiting for the loader thread */
+	TERRAIN_TILE_LOADING, /* owned by the loader thread */
+	TERRAIN_TILE_LOADED, /* meshed, waiting to be uploaded on the main thread */
+	TERRAIN_TILE_RESIDENT,
+	TERRAIN_TILE_MISSING /* no usable file, kept so it isn't requested again */
+};
+
+struct TerrainTile {
+	int32_t x, z; /* tile coordinates, tile (0, 0) starts at the stream terrain's position */
+	enum TerrainTileState state; /* guarded by the stream's mutex */
+	bool resident; /* main thread only, so drawing and height queries don't need the lock */
+	struct Terrain *terrain;
+	struct TerrainChunkData *chunkData;
+};
+
+/*
+ * Terrain made of heightmap tiles on disk, named <directory>/<x>_<z>.hmap (or .png). Each
+ * tile image is tileSize + 1 samples square and shares its last row and column
+ * with the first of its neighbours. Tiles within radius of the camera are loaded
+ * and meshed on a loader thread, uploaded on the main thread and dropped again
+ * once they are more than a tile beyond radius, so memory use depends on radius
+ * and not the size of the world. Normals along tile edges are worked out with
+ * a one sample border from the neighbouring tiles, so lighting has no seams.
+ */
+struct TerrainStream {
+	char *directory;
+	uint32_t tileSize; /* quads along each side of a tile */
+	float scale, radius;
+	GLuint texture;
+	GLint positionAttribLocation, vertexUVAttribLocation, normalAttribLocation;
+
+	struct TerrainTile *tiles;
+	uint32_t maxTiles;
+
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t requested, loaded;
+	bool running;
+	float cameraX, cameraZ; /* nearest requests are loaded first */
+};
+
+struct Terrain *streamTerrain(const char *directory, uint32_t tileSize, float scale, float radius,
+	const char *texture, GLint positionAttribLocation, GLint vertexUVAttribLocation, GLint normalAttribLocation);
+
+/*
+ * Requests tiles around (x, z), evicts far ones and uploads any that have
+ * finished loading. Call once a frame, with wait set to block until every tile
+ * in range is resident (e.g. before the first frame).
+ */
+void updateTerrainStream(struct Terrain *t, float x, float z, bool wait);
+
+/* the terrain of the resident tile under world (x, z), NULL if there isn't one. Main thread only */
+struct Terrain *getTerrainStreamTile(struct Terrain *t, float x, float z);
+
+float terrainStreamGetHeightAt(struct Terrain *t, float x, float z);
+
+uint32_t queueTerrainStream(struct Terrain *t, struct RenderQueue *queue, uint32_t program);
+
+void cleanupTerrainStream(struct TerrainStream *stream);
+
+#endif
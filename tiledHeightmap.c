@@ -0,0 +1,36 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "tiledHeightmap.h"
+
+uint32_t getTiledHeightmapLength(uint32_t size)
+{
+	const uint32_t tilesPerSide = getTiledHeightmapTilesPerSide(size);
+	return tilesPerSide * tilesPerSide << (2 * TILED_HEIGHTMAP_SHIFT);
+}
+
+float *tileHeightmap(const float *heightmap, uint32_t size)
+{
+	float *tiled = calloc(getTiledHeightmapLength(size), sizeof(float));
+	if (!tiled) {
+		return NULL;
+	}
+	// a tile row is contiguous in both layouts
+	for (uint32_t z = 0; z < size; z++) {
+		for (uint32_t x = 0; x < size; x += TILED_HEIGHTMAP_TILE_SIZE) {
+			const uint32_t n = size - x < TILED_HEIGHTMAP_TILE_SIZE ? size - x : TILED_HEIGHTMAP_TILE_SIZE;
+			memcpy(&tiled[getTiledHeightmapIndex(size, x, z)], &heightmap[x + z * size], n * sizeof(float));
+		}
+	}
+	return tiled;
+}
+
+void untileHeightmap(const float *tiled, uint32_t size, float *heightmap)
+{
+	for (uint32_t z = 0; z < size; z++) {
+		for (uint32_t x = 0; x < size; x += TILED_HEIGHTMAP_TILE_SIZE) {
+			const uint32_t n = size - x < TILED_HEIGHTMAP_TILE_SIZE ? size - x : TILED_HEIGHTMAP_TILE_SIZE;
+			memcpy(&heightmap[x + z * size], &tiled[getTiledHeightmapIndex(size, x, z)], n * sizeof(float));
+		}
+	}
+}
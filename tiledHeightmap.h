@@ -0,0 +1,42 @@
+#ifndef TILED_HEIGHTMAP_H
+#define TILED_HEIGHTMAP_H
+
+#include <stdint.h>
+
+/* tiles are 8 x 8 samples, 256 bytes or four cache lines */
+#define TILED_HEIGHTMAP_SHIFT 3
+#define TILED_HEIGHTMAP_TILE_SIZE (1 << TILED_HEIGHTMAP_SHIFT)
+#define TILED_HEIGHTMAP_MASK (TILED_HEIGHTMAP_TILE_SIZE - 1)
+
+/*
+ * Tiled heightmap layout. Samples are grouped into square tiles stored one
+ * after another in row-major order, with the samples inside a tile row-major
+ * too. A step to the next row stays within the same few cache lines instead of
+ * jumping a whole map row ahead, which is what neighbourhood and random
+ * queries do most. Maps that aren't a whole number of tiles are padded.
+ */
+
+static inline uint32_t getTiledHeightmapTilesPerSide(uint32_t size)
+{
+	return (size + TILED_HEIGHTMAP_MASK) >> TILED_HEIGHTMAP_SHIFT;
+}
+
+/* index of sample (x, z) of a size * size map */
+static inline uint32_t getTiledHeightmapIndex(uint32_t size, uint32_t x, uint32_t z)
+{
+	const uint32_t tile = (z >> TILED_HEIGHTMAP_SHIFT) * getTiledHeightmapTilesPerSide(size) +
+		(x >> TILED_HEIGHTMAP_SHIFT);
+	return (tile << (2 * TILED_HEIGHTMAP_SHIFT)) + ((z & TILED_HEIGHTMAP_MASK) << TILED_HEIGHTMAP_SHIFT) +
+		(x & TILED_HEIGHTMAP_MASK);
+}
+
+/* floats needed for a size * size map, padding included */
+uint32_t getTiledHeightmapLength(uint32_t size);
+
+/* copy of a row-major map in tiled order, padding zeroed */
+float *tileHeightmap(const float *heightmap, uint32_t size);
+
+/* writes a tiled map back out in row-major order */
+void untileHeightmap(const float *tiled, uint32_t size, float *heightmap);
+
+#endif
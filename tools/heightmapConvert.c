@@ -0,0 +1,51 @@
+/*
+ * Converts a grayscale heightmap image to the engine's native heightmap format.
+ *
+ * usage: heightmapConvert input.png output.hmap [scale] [heightScale]
+ *
+ * Heights are pixel value * heightScale, which defaults to 1/15 to match what
+ * the engine does when it loads images directly.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "heightmap.h"
+
+int main(int argc, char **argv)
+{
+	if (argc < 3 || argc > 5) {
+		fprintf(stderr, "usage: %s input.png output.hmap [scale] [heightScale]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	float scale = argc > 3 ? strtof(argv[3], NULL) : 1.0f;
+	float heightScale = argc > 4 ? strtof(argv[4], NULL) : 0.0f;
+
+	int width, height, n;
+	unsigned char *image = stbi_load(argv[1], &width, &height, &n, 1);
+	if (!image) {
+		fprintf(stderr, "Could not load %s.\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	float *samples = malloc((size_t) width * height * sizeof(float));
+	if (!samples) {
+		free(image);
+		return EXIT_FAILURE;
+	}
+	for (size_t i = 0; i < (size_t) width * height; i++) {
+		// by default the same expression as the engine's image loader, so both give identical heights
+		samples[i] = heightScale ? image[i] * heightScale : image[i] / 15.0f;
+	}
+	free(image);
+
+	if (!writeHeightmapFile(argv[2], samples, width, height, scale)) {
+		fprintf(stderr, "Could not write %s.\n", argv[2]);
+		free(samples);
+		return EXIT_FAILURE;
+	}
+	free(samples);
+	return EXIT_SUCCESS;
+}
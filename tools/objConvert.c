@@ -0,0 +1,41 @@
+/*
+ * Converts a Wavefront OBJ model to the engine's native mesh format, welded
+ * and put in vertex cache order once here rather than at every load.
+ *
+ * usage: objConvert input.obj output.mesh
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "meshFile.h"
+#include "objImport.h"
+
+int main(int argc, char **argv)
+{
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s input.obj output.mesh\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	struct ObjModel model;
+	if (!importObj(argv[1], &model)) {
+		return EXIT_FAILURE;
+	}
+	if (!model.numIndices) {
+		fprintf(stderr, "%s has no triangles.\n", argv[1]);
+		freeObjModel(&model);
+		return EXIT_FAILURE;
+	}
+
+	// 16 bit indices if they'll do, as loadObjMesh uses
+	const void *indices;
+	const GLenum indexType = narrowObjIndices(&model, &indices);
+	if (!writeMeshFile(argv[2], model.vertices, model.numVertices, indices, model.numIndices, indexType)) {
+		fprintf(stderr, "Could not write %s.\n", argv[2]);
+		freeObjModel(&model);
+		return EXIT_FAILURE;
+	}
+	printf("%u vertices, %u triangles\n", model.numVertices, model.numIndices / 3);
+	freeObjModel(&model);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "uniformRing.h"
+
+static GLsizeiptr alignSize(GLsizeiptr size, GLsizeiptr alignment)
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+static bool allocateRingBuffer(struct UniformRing *ring)
+{
+	const GLsizeiptr size = ring->frameSize * UNIFORM_RING_FRAMES;
+	glGenBuffers(1, &ring->buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, ring->buffer);
+	if (ring->persistent) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_UNIFORM_BUFFER, size, NULL, flags);
+		ring->mapping = glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+		if (!ring->mapping) {
+			fprintf(stderr, "Error mapping uniform ring.\n");
+			glDeleteBuffers(1, &ring->buffer);
+			return false;
+		}
+	} else {
+		glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_STREAM_DRAW);
+	}
+	return true;
+}
+
+static void freeRingBuffer(struct UniformRing *ring)
+{
+	if (ring->persistent) {
+		glBindBuffer(GL_UNIFORM_BUFFER, ring->buffer);
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+		ring->mapping = NULL;
+	}
+	glDeleteBuffers(1, &ring->buffer);
+	for (int i = 0; i < UNIFORM_RING_FRAMES; i++) {
+		if (ring->fences[i]) {
+			glDeleteSync(ring->fences[i]);
+			ring->fences[i] = NULL;
+		}
+	}
+}
+
+struct UniformRing *createUniformRing(GLsizeiptr frameSize)
+{
+	struct UniformRing *ring = calloc(1, sizeof(struct UniformRing));
+	if (!ring) {
+		return NULL;
+	}
+	GLint alignment;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	ring->frameStride = alignSize(sizeof(struct FrameUniforms), alignment);
+	ring->objectStride = alignSize(sizeof(struct ObjectUniforms), alignment);
+	// regions start aligned too
+	ring->frameSize = alignSize(frameSize < ring->frameStride ? ring->frameStride : frameSize, alignment);
+	ring->persistent = GLEW_ARB_buffer_storage;
+	if (!allocateRingBuffer(ring)) {
+		free(ring);
+		return NULL;
+	}
+	return ring;
+}
+
+void bindUniformBlocks(GLuint program)
+{
+	const GLuint frameIndex = glGetUniformBlockIndex(program, "Frame");
+	if (frameIndex != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, frameIndex, FRAME_UNIFORMS_BINDING);
+	}
+	const GLuint objectIndex = glGetUniformBlockIndex(program, "Object");
+	if (objectIndex != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, objectIndex, OBJECT_UNIFORMS_BINDING);
+	}
+}
+
+static uint8_t *mapRange(struct UniformRing *ring, GLintptr offset, GLsizeiptr size)
+{
+	if (ring->persistent) {
+		return ring->mapping ? ring->mapping + offset : NULL;
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, ring->buffer);
+	return glMapBufferRange(GL_UNIFORM_BUFFER, offset, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+static void unmapRange(struct UniformRing *ring)
+{
+	if (!ring->persistent) {
+		glBindBuffer(GL_UNIFORM_BUFFER, ring->buffer);
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+	}
+}
+
+static void writeFrameUniforms(struct UniformRing *ring)
+{
+	const GLintptr offset = ring->frame * ring->frameSize;
+	uint8_t *data = mapRange(ring, offset, sizeof(struct FrameUniforms));
+	if (data) {
+		memcpy(data, &ring->frameUniforms, sizeof(struct FrameUniforms));
+		unmapRange(ring);
+	}
+	ring->used = ring->frameStride;
+	glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, ring->buffer, offset, sizeof(struct FrameUniforms));
+}
+
+void beginUniformFrame(struct UniformRing *ring, const struct FrameUniforms *frameUniforms)
+{
+	GLsync fence = ring->fences[ring->frame];
+	if (fence) {
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+			continue;
+		}
+		glDeleteSync(fence);
+		ring->fences[ring->frame] = NULL;
+	}
+	ring->frameUniforms = *frameUniforms;
+	writeFrameUniforms(ring);
+}
+
+/* a new buffer with room for size bytes a frame. The GPU keeps the old one for as long as it still reads it */
+static bool growUniformRing(struct UniformRing *ring, GLsizeiptr size)
+{
+	const GLsizeiptr frameSize = ring->frameSize;
+	freeRingBuffer(ring);
+	while (ring->frameSize < size) {
+		ring->frameSize *= 2;
+	}
+	const bool grown = allocateRingBuffer(ring);
+	if (!grown) {
+		// the old size, so later frames still have somewhere to go
+		ring->frameSize = frameSize;
+		if (!allocateRingBuffer(ring)) {
+			return false;
+		}
+	}
+	writeFrameUniforms(ring);
+	return grown;
+}
+
+uint8_t *mapObjectUniforms(struct UniformRing *ring, uint32_t count, GLintptr *offset)
+{
+	const GLsizeiptr size = count * ring->objectStride;
+	if (ring->used + size > ring->frameSize && !growUniformRing(ring, ring->frameStride + size)) {
+		fprintf(stderr, "Error growing uniform ring for %u objects.\n", count);
+		return NULL;
+	}
+	*offset = ring->frame * ring->frameSize + ring->used;
+	ring->used += size;
+	return mapRange(ring, *offset, size);
+}
+
+void unmapObjectUniforms(struct UniformRing *ring)
+{
+	unmapRange(ring);
+}
+
+void bindObjectUniforms(struct UniformRing *ring, GLintptr offset)
+{
+	glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_UNIFORMS_BINDING, ring->buffer, offset, sizeof(struct ObjectUniforms));
+}
+
+void endUniformFrame(struct UniformRing *ring)
+{
+	ring->fences[ring->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	ring->frame = (ring->frame + 1) % UNIFORM_RING_FRAMES;
+}
+
+void cleanupUniformRing(struct UniformRing *ring)
+{
+	freeRingBuffer(ring);
+	free(ring);
+}
@@ -0,0 +1,80 @@
+#ifndef UNIFORM_RING_H
+#define UNIFORM_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+#define UNIFORM_RING_FRAMES 3 /* frames the CPU may write ahead of the GPU */
+
+/* uniform buffer binding points of the Frame and Object blocks */
+#define FRAME_UNIFORMS_BINDING 0
+#define OBJECT_UNIFORMS_BINDING 1
+
+/* the std140 Frame block, matrices row-major as the blocks are declared row_major */
+struct FrameUniforms {
+	float projection[16];
+	float viewMatrix[16];
+	float lightPosition[4];
+	float lightColour[4];
+	float lightIntensity;
+	float padding[3]; /* std140 rounds the block up to a whole vec4 */
+};
+
+/* the std140 Object block, the matrices drawMesh used to upload one by one */
+struct ObjectUniforms {
+	float modelMatrix[16];
+	float modelXRotationMatrix[16];
+	float modelYRotationMatrix[16];
+};
+
+/*
+ * One uniform buffer split into UNIFORM_RING_FRAMES regions. Each frame writes
+ * its Frame block and every object's Object block into the next region, after
+ * waiting on the fence set when that region was last drawn from, and draws
+ * bind ranges of it rather than setting uniforms. With GL_ARB_buffer_storage
+ * the buffer is mapped once, persistently, otherwise each write maps its range
+ * unsynchronised (the fence having been waited on already).
+ */
+struct UniformRing {
+	GLuint buffer;
+	bool persistent;
+	uint8_t *mapping; /* the whole buffer, if persistent */
+	GLsizeiptr frameSize; /* bytes in each region */
+	GLsizeiptr frameStride, objectStride; /* block sizes rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT */
+	uint32_t frame; /* region being written */
+	GLsizeiptr used; /* bytes of it written */
+	GLsync fences[UNIFORM_RING_FRAMES];
+	struct FrameUniforms frameUniforms; /* written again if the ring grows */
+};
+
+/* frameSize bytes per frame to start with, it grows when a frame needs more */
+struct UniformRing *createUniformRing(GLsizeiptr frameSize);
+
+/* points the program's Frame and Object blocks, if it has them, at their binding points */
+void bindUniformBlocks(GLuint program);
+
+/* waits for the GPU to finish with the next region, then writes and binds the Frame block */
+void beginUniformFrame(struct UniformRing *ring, const struct FrameUniforms *frameUniforms);
+
+/*
+ * Space for count Object blocks, ring->objectStride bytes apart, to be written
+ * before unmapObjectUniforms. offset is where the first is in the buffer. If
+ * the ring has to grow anything mapped earlier in the frame is lost, so map a
+ * frame's objects all at once. NULL, with nothing to unmap, if the ring can't
+ * grow or be mapped.
+ */
+uint8_t *mapObjectUniforms(struct UniformRing *ring, uint32_t count, GLintptr *offset);
+
+void unmapObjectUniforms(struct UniformRing *ring);
+
+/* the Object block at offset for the next draw */
+void bindObjectUniforms(struct UniformRing *ring, GLintptr offset);
+
+/* fences the frame's region once everything using it has been drawn */
+void endUniformFrame(struct UniformRing *ring);
+
+void cleanupUniformRing(struct UniformRing *ring);
+
+#endif
@@ -0,0 +1,110 @@
+#include <math.h>
+#include <string.h>
+
+#include "maths.h"
+#include "vertexFormat.h"
+
+/* IEEE 754 binary16, rounded to nearest even, overflowing to infinity */
+uint16_t packHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	const uint16_t sign = (bits >> 16) & 0x8000;
+	const uint32_t exponent = (bits >> 23) & 0xff, mantissa = bits & 0x7fffff;
+
+	if (exponent == 0xff) {
+		// keep NaNs NaN
+		return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+	}
+	const int32_t halfExponent = (int32_t) exponent - 127 + 15;
+	if (halfExponent >= 31) {
+		return sign | 0x7c00;
+	}
+	if (halfExponent <= 0) {
+		// subnormal or zero, the implicit one becomes explicit and is shifted down
+		if (halfExponent < -11) {
+			return sign;
+		}
+		const uint32_t full = mantissa | 0x800000, shift = (uint32_t) (14 - halfExponent);
+		uint32_t half = full >> shift;
+		const uint32_t rest = full & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1))) {
+			half++;
+		}
+		return sign | (uint16_t) half;
+	}
+
+	uint32_t half = (uint32_t) halfExponent << 10 | mantissa >> 13;
+	const uint32_t rest = mantissa & 0x1fff;
+	// a carry out of the mantissa rolls into the exponent, which is what rounding up should do
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+		half++;
+	}
+	return sign | (uint16_t) half;
+}
+
+float unpackHalf(uint16_t half)
+{
+	const uint32_t sign = (uint32_t) (half & 0x8000) << 16;
+	const uint32_t exponent = (half >> 10) & 0x1f, mantissa = half & 0x3ff;
+	uint32_t bits;
+	if (exponent == 0x1f) {
+		bits = sign | 0x7f800000 | mantissa << 13;
+	} else if (exponent) {
+		bits = sign | (exponent - 15 + 127) << 23 | mantissa << 13;
+	} else {
+		float value = (float) mantissa * (1.0f / 16777216.0f);
+		return sign ? -value : value;
+	}
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static uint32_t packSnorm10(float value)
+{
+	value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+	return (uint32_t) (int32_t) lrintf(value * 511.0f) & 0x3ff;
+}
+
+static float unpackSnorm10(uint32_t bits)
+{
+	// sign extend the 10 bits
+	const int32_t value = (int32_t) (bits << 22) >> 22;
+	return value < -511 ? -1.0f : (float) value / 511.0f;
+}
+
+uint32_t packNormal(const float *normal)
+{
+	return packSnorm10(normal[0]) | packSnorm10(normal[1]) << 10 | packSnorm10(normal[2]) << 20;
+}
+
+void unpackNormal(uint32_t packed, float *normal)
+{
+	normal[0] = unpackSnorm10(packed & 0x3ff);
+	normal[1] = unpackSnorm10((packed >> 10) & 0x3ff);
+	normal[2] = unpackSnorm10((packed >> 20) & 0x3ff);
+}
+
+void getPackedVertexBounds(const struct PackedVertex *vertices, uint32_t numVertices, float *min, float *max,
+	float *radius)
+{
+	memcpy(min, vertices[0].position, 3 * sizeof(float));
+	memcpy(max, vertices[0].position, 3 * sizeof(float));
+	for (uint32_t i = 1; i < numVertices; i++) {
+		for (int j = 0; j < 3; j++) {
+			min[j] = fminf(min[j], vertices[i].position[j]);
+			max[j] = fmaxf(max[j], vertices[i].position[j]);
+		}
+	}
+	// the sphere is centred on the box, as culling expects
+	float centre[3];
+	for (int j = 0; j < 3; j++) {
+		centre[j] = (min[j] + max[j]) / 2.0f;
+	}
+	*radius = 0.0f;
+	for (uint32_t i = 0; i < numVertices; i++) {
+		const float *p = vertices[i].position;
+		*radius = fmaxf(*radius, magnitude(p[0] - centre[0], p[1] - centre[1], p[2] - centre[2]));
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+/*
+ * Interleaved vertex used by meshes and terrain chunks, 20 bytes rather than
+ * 32 in three separate buffers, so a vertex is fetched from a single cache
+ * line. Positions stay full floats, chunk heights need them to match
+ * terrainGetHeightAt. Normals use GL_INT_2_10_10_10_REV, which needs OpenGL
+ * 3.3 or ARB_vertex_type_2_10_10_10_rev. Texture coordinates are half floats,
+ * which hold whole numbers up to 2048 exactly, enough for terrain that repeats
+ * its texture every quad.
+ */
+struct PackedVertex {
+	float position[3];
+	uint32_t normal; /* signed normalized x, y, z in 10 bits each, w unused */
+	uint16_t textureCoordinates[2]; /* half floats */
+};
+
+uint16_t packHalf(float value);
+float unpackHalf(uint16_t half);
+
+/* normal should be unit length */
+uint32_t packNormal(const float *normal);
+void unpackNormal(uint32_t packed, float *normal);
+
+static inline void packVertex(struct PackedVertex *vertex, const float *position, const float *normal, float u,
+	float v)
+{
+	vertex->position[0] = position[0];
+	vertex->position[1] = position[1];
+	vertex->position[2] = position[2];
+	vertex->normal = packNormal(normal);
+	vertex->textureCoordinates[0] = packHalf(u);
+	vertex->textureCoordinates[1] = packHalf(v);
+}
+
+/* min and max of the vertices, and the radius of the smallest sphere centred between them that holds them all */
+void getPackedVertexBounds(const struct PackedVertex *vertices, uint32_t numVertices, float *min, float *max,
+	float *radius);
+
+/*
+ * Points the attributes at struct PackedVertex in the bound GL_ARRAY_BUFFER and
+ * enables them on the bound VAO. Inline so tools using the format don't link GL.
+ */
+static inline void setPackedVertexAttribs(GLint positionAttribLocation, GLint vertexUVAttribLocation,
+	GLint normalAttribLocation)
+{
+	const GLsizei stride = sizeof(struct PackedVertex);
+	glVertexAttribPointer(positionAttribLocation, 3, GL_FLOAT, GL_FALSE, stride,
+		(void *) offsetof(struct PackedVertex, position));
+	glEnableVertexAttribArray(positionAttribLocation);
+	glVertexAttribPointer(normalAttribLocation, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride,
+		(void *) offsetof(struct PackedVertex, normal));
+	glEnableVertexAttribArray(normalAttribLocation);
+	glVertexAttribPointer(vertexUVAttribLocation, 2, GL_HALF_FLOAT, GL_FALSE, stride,
+		(void *) offsetof(struct PackedVertex, textureCoordinates));
+	glEnableVertexAttribArray(vertexUVAttribLocation);
+}
+
+#endif
@@ -1,14 +1,20 @@
-#version 130
-
-uniform mat4 modelMatrix;
-uniform mat4 projection;
-uniform mat4 viewMatrix;
-uniform mat4 modelXRotationMatrix;
-uniform mat4 modelYRotationMatrix;
-
-uniform vec4 lightPosition;
-uniform vec4 lightColour;
-uniform float lightIntensity;
+#version 140
+
+// per frame, struct FrameUniforms
+layout(std140, row_major) uniform Frame {
+	mat4 projection;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	vec4 lightColour;
+	float lightIntensity;
+};
+
+// per mesh, struct ObjectUniforms
+layout(std140, row_major) uniform Object {
+	mat4 modelMatrix;
+	mat4 modelXRotationMatrix;
+	mat4 modelYRotationMatrix;
+};
 
 in vec3 position;
 in vec3 normal;